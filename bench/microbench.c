@@ -0,0 +1,435 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/3dmath.h"
+#include "../src/raycaster.h"
+#include "../src/json_parsers.h"
+
+#define DEFAULT_OPS 1000000
+#define DEFAULT_WARMUP 3
+#define DEFAULT_TRIALS 15
+#define DEFAULT_TOLERANCE 0.10
+#define MAX_KERNELS 32
+#define BENCH_RAY_ROW_LENGTH 1000
+#define BENCH_NUMBER_MAX_LENGTH 32
+
+/**
+ * Randomised inputs shared by all kernels, generated once up front
+ */
+typedef struct BenchInputs {
+	int length;
+	V3 *origins;
+	V3 *directions;
+	V3 *normals;
+	V3 *colors;
+	Sphere *spheres;
+	Plane *planes;
+	V3 *rays;
+	char *numbers;
+	size_t numbersSize;
+} BenchInputs;
+
+/**
+ * A single kernel to benchmark, run returns a value that is folded into a sink so the
+ * compiler cannot drop the work
+ */
+typedef struct BenchKernel {
+	const char *name;
+	double (*run)(BenchInputs *inputsRef);
+} BenchKernel;
+
+/**
+ * The result of running a kernel for all trials
+ */
+typedef struct BenchResult {
+	const char *name;
+	double mean;
+	double stddev;
+} BenchResult;
+
+static volatile double sink;
+
+/**
+ * Uniform random number in [lo, hi)
+ */
+static double random_range(double lo, double hi) {
+	return lo + (hi - lo) * ((double) rand() / ((double) RAND_MAX + 1));
+}
+
+static void random_v3(V3 *a, double lo, double hi) {
+	a->data.X = random_range(lo, hi);
+	a->data.Y = random_range(lo, hi);
+	a->data.Z = random_range(lo, hi);
+}
+
+static void random_unit_v3(V3 *a) {
+	do {
+		random_v3(a, -1, 1);
+	} while (a->data.X == 0 && a->data.Y == 0 && a->data.Z == 0);
+	v3_normalize(a, a);
+}
+
+/**
+ * Allocate and fill the input arrays, a fixed seed keeps runs comparable to the baseline
+ */
+static void create_inputs(BenchInputs *inputsRef, int length) {
+	srand(430);
+	inputsRef->length = length;
+	inputsRef->origins = malloc(sizeof(V3) * length);
+	inputsRef->directions = malloc(sizeof(V3) * length);
+	inputsRef->normals = malloc(sizeof(V3) * length);
+	inputsRef->colors = malloc(sizeof(V3) * length);
+	inputsRef->spheres = malloc(sizeof(Sphere) * length);
+	inputsRef->planes = malloc(sizeof(Plane) * length);
+	inputsRef->rays = malloc(sizeof(V3) * length);
+	inputsRef->numbers = malloc((size_t) BENCH_NUMBER_MAX_LENGTH * length);
+	inputsRef->numbersSize = 0;
+
+	for (int i = 0; i < length; i++) {
+		random_v3(&inputsRef->origins[i], -1, 1);
+		random_unit_v3(&inputsRef->directions[i]);
+		random_unit_v3(&inputsRef->normals[i]);
+		random_v3(&inputsRef->colors[i], 0, 1);
+
+		random_v3(&inputsRef->spheres[i].position, -10, 10);
+		inputsRef->spheres[i].radius = random_range(0.5, 5);
+		random_v3(&inputsRef->planes[i].position, -10, 10);
+		random_unit_v3(&inputsRef->planes[i].normal);
+
+		// Numbers written the ways scene files hold them, full precision, fixed, integer and short
+		char *numberRef = &inputsRef->numbers[inputsRef->numbersSize];
+		double number = random_range(-100, 100);
+		if (i % 4 == 0)
+			inputsRef->numbersSize += (size_t) sprintf(numberRef, "%.17g,", number);
+		else if (i % 4 == 1)
+			inputsRef->numbersSize += (size_t) sprintf(numberRef, "%.6f,", number);
+		else if (i % 4 == 2)
+			inputsRef->numbersSize += (size_t) sprintf(numberRef, "%d,", (int) number);
+		else
+			inputsRef->numbersSize += (size_t) sprintf(numberRef, "%.3g,", number);
+	}
+}
+
+static void free_inputs(BenchInputs *inputsRef) {
+	free(inputsRef->origins);
+	free(inputsRef->directions);
+	free(inputsRef->normals);
+	free(inputsRef->colors);
+	free(inputsRef->spheres);
+	free(inputsRef->planes);
+	free(inputsRef->rays);
+	free(inputsRef->numbers);
+}
+
+static double bench_v3_normalize(BenchInputs *inputsRef) {
+	double acc = 0;
+	V3 result;
+	for (int i = 0; i < inputsRef->length; i++) {
+		v3_normalize(&inputsRef->origins[i], &result);
+		acc += result.data.X;
+	}
+	return acc;
+}
+
+/**
+ * Primary rays for an image with BENCH_RAY_ROW_LENGTH pixels per row, one ray per input,
+ * normalizing the view plane point of each pixel like raycast used to
+ */
+static double bench_primary_rays_normalize(BenchInputs *inputsRef) {
+	Camera camera = {1, 1};
+	int rows = inputsRef->length / BENCH_RAY_ROW_LENGTH;
+	V3 point;
+	point.data.Z = 1;
+	for (int y = 0; y < rows; y++) {
+		point.data.Y = -(0 - camera.height/2.0 + camera.height/rows * (y + 0.5));
+		for (int x = 0; x < BENCH_RAY_ROW_LENGTH; x++) {
+			point.data.X = 0 - camera.width/2.0 + camera.width/BENCH_RAY_ROW_LENGTH * (x + 0.5);
+			v3_normalize(&point, &inputsRef->rays[y * BENCH_RAY_ROW_LENGTH + x]);
+		}
+	}
+	return inputsRef->rays[0].data.X;
+}
+
+/**
+ * The same primary rays generated a row at a time
+ */
+static double bench_primary_rays_generate(BenchInputs *inputsRef) {
+	Camera camera = {1, 1};
+	int rows = inputsRef->length / BENCH_RAY_ROW_LENGTH;
+	for (int y = 0; y < rows; y++)
+		primary_rays_generate(&camera, BENCH_RAY_ROW_LENGTH, rows, y, 0, BENCH_RAY_ROW_LENGTH, &inputsRef->rays[y * BENCH_RAY_ROW_LENGTH]);
+	return inputsRef->rays[0].data.X;
+}
+
+static double bench_intersect_sphere(BenchInputs *inputsRef) {
+	double acc = 0;
+	for (int i = 0; i < inputsRef->length; i++) {
+		double t = intersect_sphere(&inputsRef->spheres[i], &inputsRef->origins[i], &inputsRef->directions[i]);
+		if (t != INFINITY)
+			acc += t;
+	}
+	return acc;
+}
+
+static double bench_intersect_plane(BenchInputs *inputsRef) {
+	double acc = 0;
+	for (int i = 0; i < inputsRef->length; i++) {
+		double t = intersect_plane(&inputsRef->planes[i], &inputsRef->origins[i], &inputsRef->directions[i]);
+		if (t != INFINITY)
+			acc += t;
+	}
+	return acc;
+}
+
+static double bench_intersect_triangle(BenchInputs *inputsRef) {
+	double acc = 0;
+	int length = inputsRef->length;
+	for (int i = 0; i < length; i++) {
+		// Build the triangle from the sphere and plane positions so it is spread around the origin
+		double t = intersect_triangle(&inputsRef->spheres[i].position, &inputsRef->planes[i].position,
+									  &inputsRef->spheres[length - 1 - i].position,
+									  &inputsRef->origins[i], &inputsRef->directions[i]);
+		if (t != INFINITY)
+			acc += t;
+	}
+	return acc;
+}
+
+static double bench_calculate_diffuse(BenchInputs *inputsRef) {
+	double acc = 0;
+	V3 result;
+	int length = inputsRef->length;
+	for (int i = 0; i < length; i++) {
+		calculate_diffuse(&inputsRef->normals[i], &inputsRef->directions[i], &inputsRef->colors[i],
+						  &inputsRef->colors[length - 1 - i], &result);
+		acc += result.data.X;
+	}
+	return acc;
+}
+
+static double bench_calculate_specular(BenchInputs *inputsRef) {
+	double acc = 0;
+	V3 R;
+	V3 result;
+	int length = inputsRef->length;
+	for (int i = 0; i < length; i++) {
+		v3_reflect(&inputsRef->directions[i], &inputsRef->normals[i], &R);
+		calculate_specular(&inputsRef->directions[length - 1 - i], &R, &inputsRef->colors[i],
+						   &inputsRef->colors[length - 1 - i], &inputsRef->normals[i], &inputsRef->directions[i], &result);
+		acc += result.data.X;
+	}
+	return acc;
+}
+
+/**
+ * Reads one JSON number per input the way read_JSONValue used to, a float from fscanf
+ */
+static double bench_json_number_fscanf(BenchInputs *inputsRef) {
+	FILE *fp = fmemopen(inputsRef->numbers, inputsRef->numbersSize, "r");
+	double acc = 0;
+	float number;
+	for (int i = 0; i < inputsRef->length && fscanf(fp, "%f", &number) == 1; i++) {
+		acc += number;
+		getc_unlocked(fp);
+	}
+	fclose(fp);
+	return acc;
+}
+
+/**
+ * Reads the same numbers with parse_number
+ */
+static double bench_json_number_parse(BenchInputs *inputsRef) {
+	FILE *fp = fmemopen(inputsRef->numbers, inputsRef->numbersSize, "r");
+	double acc = 0;
+	double number;
+	for (int i = 0; i < inputsRef->length && parse_number(fp, &number) == 0; i++) {
+		acc += number;
+		getc_unlocked(fp);
+	}
+	fclose(fp);
+	return acc;
+}
+
+static BenchKernel kernels[] = {
+	{"v3_normalize", bench_v3_normalize},
+	{"primary_rays_normalize", bench_primary_rays_normalize},
+	{"primary_rays_generate", bench_primary_rays_generate},
+	{"intersect_sphere", bench_intersect_sphere},
+	{"intersect_plane", bench_intersect_plane},
+	{"intersect_triangle", bench_intersect_triangle},
+	{"calculate_diffuse", bench_calculate_diffuse},
+	{"calculate_specular", bench_calculate_specular},
+	{"json_number_fscanf", bench_json_number_fscanf},
+	{"json_number_parse", bench_json_number_parse},
+};
+
+static double now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Run one kernel for the warm-up and trial rounds and compute the ns/op statistics
+ */
+static void run_kernel(BenchKernel *kernelRef, BenchInputs *inputsRef, int warmup, int trials, BenchResult *resultRef) {
+	double *samples = malloc(sizeof(double) * trials);
+
+	for (int i = 0; i < warmup; i++)
+		sink += kernelRef->run(inputsRef);
+
+	for (int i = 0; i < trials; i++) {
+		double start = now_ns();
+		sink += kernelRef->run(inputsRef);
+		samples[i] = (now_ns() - start) / inputsRef->length;
+	}
+
+	double mean = 0;
+	for (int i = 0; i < trials; i++)
+		mean += samples[i];
+	mean /= trials;
+
+	double variance = 0;
+	for (int i = 0; i < trials; i++)
+		variance += (samples[i] - mean) * (samples[i] - mean);
+	variance /= trials > 1 ? trials - 1 : 1;
+
+	resultRef->name = kernelRef->name;
+	resultRef->mean = mean;
+	resultRef->stddev = sqrt(variance);
+
+	free(samples);
+}
+
+/**
+ * Write the results as a baseline file, one "name mean stddev" line per kernel
+ */
+static int save_baseline(BenchResult *results, int length, char *fname) {
+	FILE *fp = fopen(fname, "w");
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+	for (int i = 0; i < length; i++)
+		fprintf(fp, "%s %.6f %.6f\n", results[i].name, results[i].mean, results[i].stddev);
+	fclose(fp);
+	return 0;
+}
+
+/**
+ * Compare the results against a baseline file
+ * @return 0 if no kernel regressed, 1 if a kernel regressed, otherwise a failure occurred
+ */
+static int compare_baseline(BenchResult *results, int length, char *fname, double tolerance) {
+	FILE *fp = fopen(fname, "r");
+	char name[128];
+	double mean, stddev;
+	int regressed = 0;
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 2;
+	}
+
+	printf("\n%-22s %12s %12s %9s\n", "kernel", "baseline", "current", "change");
+	while (fscanf(fp, "%127s %lf %lf", name, &mean, &stddev) == 3) {
+		for (int i = 0; i < length; i++) {
+			if (strcmp(results[i].name, name) != 0)
+				continue;
+
+			double change = (results[i].mean - mean) / mean;
+			// Only fail when the slowdown is beyond both the tolerance and the measured noise
+			int isRegression = change > tolerance && results[i].mean - mean > 2 * (stddev + results[i].stddev);
+			printf("%-22s %12.3f %12.3f %+8.1f%% %s\n", name, mean, results[i].mean, change * 100,
+				   isRegression ? "REGRESSION" : "");
+			regressed |= isRegression;
+		}
+	}
+	fclose(fp);
+
+	if (regressed)
+		fprintf(stderr, "Error: Kernel performance regressed against baseline '%s'\n", fname);
+
+	return regressed;
+}
+
+static void show_help() {
+	printf("Usage: raycast-microbench [options]\n");
+	printf("\t --ops <n>: Number of randomised inputs each kernel runs over per trial (default %d)\n", DEFAULT_OPS);
+	printf("\t --warmup <n>: Number of untimed warm-up runs (default %d)\n", DEFAULT_WARMUP);
+	printf("\t --trials <n>: Number of timed trials (default %d)\n", DEFAULT_TRIALS);
+	printf("\t --filter <name>: Only run kernels whose name contains name\n");
+	printf("\t --save-baseline <file>: Write the results to a baseline file\n");
+	printf("\t --baseline <file>: Compare against a baseline file and fail on regressions\n");
+	printf("\t --tolerance <fraction>: Allowed slowdown before failing (default %.2f)\n", DEFAULT_TOLERANCE);
+}
+
+int main(int argc, char *argv[]) {
+	int ops = DEFAULT_OPS;
+	int warmup = DEFAULT_WARMUP;
+	int trials = DEFAULT_TRIALS;
+	double tolerance = DEFAULT_TOLERANCE;
+	char *filter = NULL;
+	char *saveFname = NULL;
+	char *baselineFname = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmup = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc)
+			trials = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc)
+			saveFname = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baselineFname = argv[++i];
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			tolerance = atof(argv[++i]);
+		else {
+			fprintf(stderr, "Error: Unknown option '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+	}
+
+	if (ops <= 0 || trials <= 0 || warmup < 0) {
+		fprintf(stderr, "Error: ops and trials must be positive integers\n");
+		return 1;
+	}
+
+	BenchInputs inputs;
+	create_inputs(&inputs, ops);
+
+	BenchResult results[MAX_KERNELS];
+	int resultsLength = 0;
+
+	printf("%-22s %12s %12s\n", "kernel", "ns/op", "stddev");
+	for (int i = 0; i < (int) (sizeof(kernels) / sizeof(kernels[0])); i++) {
+		if (filter != NULL && strstr(kernels[i].name, filter) == NULL)
+			continue;
+
+		run_kernel(&kernels[i], &inputs, warmup, trials, &results[resultsLength]);
+		printf("%-22s %12.3f %12.3f\n", results[resultsLength].name, results[resultsLength].mean,
+			   results[resultsLength].stddev);
+		resultsLength++;
+	}
+
+	free_inputs(&inputs);
+
+	if (saveFname != NULL && save_baseline(results, resultsLength, saveFname) != 0)
+		return 1;
+
+	if (baselineFname != NULL && compare_baseline(results, resultsLength, baselineFname, tolerance) != 0)
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "../src/json.h"
+#include "../src/raycaster.h"
+#include "../src/raycaster_helpers.h"
+
+#define DEFAULT_MIN_SPHERES 1000
+#define DEFAULT_MAX_SPHERES 1000000
+#define DEFAULT_DIRECTORY "/tmp"
+
+static double now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long peak_rss_kb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/**
+ * Write a scene of spheresLength spheres on a grid in front of the camera, plus a camera and a light
+ */
+static int write_scene(char *fname, long spheresLength) {
+	FILE *fp = fopen(fname, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+
+	long side = 1;
+	while (side * side < spheresLength)
+		side++;
+
+	fprintf(fp, "[\n{\"type\": \"camera\", \"width\": 1.0, \"height\": 1.0},\n");
+	fprintf(fp, "{\"type\": \"light\", \"color\": [1, 1, 1], \"position\": [0, 5, 0], \"radial-a2\": 0.1}");
+	for (long i = 0; i < spheresLength; i++) {
+		double x = (double) (i % side) / side - 0.5;
+		double y = (double) (i / side) / side - 0.5;
+		fprintf(fp, ",\n{\"type\": \"sphere\", \"diffuse_color\": [0.8, 0.4, 0.2], \"specular_color\": [1, 1, 1], "
+				"\"position\": [%.6f, %.6f, 10], \"radius\": %.6f}", x * 10, y * 10, 4.0 / side);
+	}
+	fprintf(fp, "\n]\n");
+
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "Error: Could not write scene to file '%s'\n", fname);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Load a scene in a fresh child process so the peak resident size only covers this load,
+ * the child prints one result row
+ */
+static int measure_load(char *fname, long spheresLength, int useDOM, int threadsLength) {
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "Error: Could not fork a child to load the scene\n");
+		return 1;
+	}
+
+	if (pid == 0) {
+		Scene scene;
+		long rssBefore = peak_rss_kb();
+		double start = now_ns();
+
+		if (useDOM) {
+			JSONValue JSONRoot;
+			if (read_json(fname, &JSONRoot) != 0 || create_scene_from_JSON(&JSONRoot, &scene) != 0)
+				_exit(1);
+		}
+		else if (create_scene_from_file(fname, &scene, threadsLength) != 0) {
+			_exit(1);
+		}
+
+		double seconds = (now_ns() - start) / 1e9;
+		long rssGrowth = peak_rss_kb() - rssBefore;
+		double sceneKb = (sizeof(Sphere) * scene.spheresLength + sizeof(Light) * scene.lightsLength) / 1024.0;
+
+		printf("%12li %12.3f %14.0f %14.0f %14li %10.2f\n", spheresLength, seconds, spheresLength / seconds,
+			   sceneKb, rssGrowth, rssGrowth / sceneKb);
+		fflush(stdout);
+		scene_free(&scene);
+		_exit(0);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "Error: Loading a scene of %li spheres failed\n", spheresLength);
+		return 1;
+	}
+	return 0;
+}
+
+static void show_help() {
+	printf("Usage: raycast-scenebench [options]\n");
+	printf("\t --min <n>: Number of spheres in the smallest scene (default %d)\n", DEFAULT_MIN_SPHERES);
+	printf("\t --max <n>: Number of spheres in the largest scene, scenes grow tenfold (default %d)\n", DEFAULT_MAX_SPHERES);
+	printf("\t --dir <path>: Directory to write the generated scenes to (default %s)\n", DEFAULT_DIRECTORY);
+	printf("\t --threads <n>: Number of threads to load with (default: every core)\n");
+	printf("\t --dom: Parse each file fully with read_json before building the scene\n");
+}
+
+int main(int argc, char *argv[]) {
+	long minSpheres = DEFAULT_MIN_SPHERES;
+	long maxSpheres = DEFAULT_MAX_SPHERES;
+	char *directory = DEFAULT_DIRECTORY;
+	int useDOM = 0;
+	int threadsLength = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--min") == 0 && i + 1 < argc)
+			minSpheres = atol(argv[++i]);
+		else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc)
+			maxSpheres = atol(argv[++i]);
+		else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+			directory = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threadsLength = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--dom") == 0)
+			useDOM = 1;
+		else {
+			fprintf(stderr, "Error: Unknown option '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+	}
+
+	if (minSpheres <= 0 || maxSpheres < minSpheres) {
+		fprintf(stderr, "Error: min and max must be positive with min <= max\n");
+		return 1;
+	}
+
+	char fname[4096];
+	snprintf(fname, sizeof(fname), "%s/raycast-scenebench-%i.json", directory, (int) getpid());
+
+	printf("%12s %12s %14s %14s %14s %10s\n", "spheres", "load s", "spheres/s", "scene KiB", "peak KiB", "peak/scene");
+	for (long spheresLength = minSpheres; spheresLength <= maxSpheres; spheresLength *= 10) {
+		if (write_scene(fname, spheresLength) != 0)
+			return 1;
+
+		int result = measure_load(fname, spheresLength, useDOM, threadsLength);
+		unlink(fname);
+		if (result != 0)
+			return 1;
+	}
+
+	return 0;
+}
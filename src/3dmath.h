@@ -119,4 +119,105 @@ static inline void v3_distance(V3 *a, V3 *b, double *result) {
 			  pow(b->data.Z - a->data.Z, 2));
 }
 
+/**
+ * A three dimensional affine transform, a 3x3 linear part followed by a translation column
+ */
+typedef struct A3 {
+	double m[3][4];
+} A3;
+
+/**
+ * Set a transform to the identity
+ * @param result - The transform to set
+ */
+static inline void a3_identity(A3 *result) {
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 4; j++)
+			result->m[i][j] = i == j ? 1 : 0;
+}
+
+/**
+ * Compose two transforms so that applying the result is the same as applying b then a
+ * @param a - The transform applied second
+ * @param b - The transform applied first
+ * @param result - The composed transform, may not alias a or b
+ */
+static inline void a3_multiply(A3 *a, A3 *b, A3 *result) {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 4; j++) {
+			result->m[i][j] = a->m[i][0] * b->m[0][j] + a->m[i][1] * b->m[1][j] + a->m[i][2] * b->m[2][j];
+		}
+		result->m[i][3] += a->m[i][3];
+	}
+}
+
+/**
+ * Invert an affine transform
+ * @param a - The transform to invert
+ * @param result - The inverse transform, may not alias a
+ * @return 0 if success, otherwise the transform is singular
+ */
+static inline int a3_invert(A3 *a, A3 *result) {
+	double (*m)[4] = a->m;
+	double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	double det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+
+	if (det == 0)
+		return 1;
+
+	double s = 1 / det;
+	result->m[0][0] = c00 * s;
+	result->m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * s;
+	result->m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * s;
+	result->m[1][0] = c01 * s;
+	result->m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * s;
+	result->m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * s;
+	result->m[2][0] = c02 * s;
+	result->m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * s;
+	result->m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * s;
+
+	// The inverse translation is -(inverse linear part * translation)
+	for (int i = 0; i < 3; i++) {
+		result->m[i][3] = -(result->m[i][0] * m[0][3] + result->m[i][1] * m[1][3] + result->m[i][2] * m[2][3]);
+	}
+
+	return 0;
+}
+
+/**
+ * Transform a point, translation applies
+ * @param t - The transform
+ * @param a - The point to transform
+ * @param result - The transformed point, may not alias a
+ */
+static inline void a3_transform_point(A3 *t, V3 *a, V3 *result) {
+	for (int i = 0; i < 3; i++)
+		result->array[i] = t->m[i][0] * a->data.X + t->m[i][1] * a->data.Y + t->m[i][2] * a->data.Z + t->m[i][3];
+}
+
+/**
+ * Transform a direction, translation does not apply
+ * @param t - The transform
+ * @param a - The direction to transform
+ * @param result - The transformed direction, may not alias a
+ */
+static inline void a3_transform_vector(A3 *t, V3 *a, V3 *result) {
+	for (int i = 0; i < 3; i++)
+		result->array[i] = t->m[i][0] * a->data.X + t->m[i][1] * a->data.Y + t->m[i][2] * a->data.Z;
+}
+
+/**
+ * Transform a normal back out of a space using the inverse of the transform into that space,
+ * normals use the transpose of the inverse so they stay perpendicular under non-uniform scale
+ * @param inverse - The transform into the space the normal is in
+ * @param a - The normal to transform
+ * @param result - The transformed (unnormalized) normal, may not alias a
+ */
+static inline void a3_transform_normal(A3 *inverse, V3 *a, V3 *result) {
+	for (int i = 0; i < 3; i++)
+		result->array[i] = inverse->m[0][i] * a->data.X + inverse->m[1][i] * a->data.Y + inverse->m[2][i] * a->data.Z;
+}
+
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_3DMATH_H
@@ -0,0 +1,309 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "band_render.h"
+#include "tile_cache.h"
+
+/**
+ * Writes all of a buffer at an offset in a file
+ * @param fd - The file to write to
+ * @param data - The bytes to write
+ * @param length - The number of bytes
+ * @param offset - The offset in the file to write them at
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int band_pwrite(int fd, uint8_t *data, size_t length, off_t offset) {
+	size_t written = 0;
+
+	while (written < length) {
+		ssize_t result = pwrite(fd, data + written, length - written, offset + (off_t) written);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			return 1;
+		written += (size_t) result;
+	}
+	return 0;
+}
+
+/**
+ * Creates the output file at its full size, with its header written and every pixel black, along
+ * with an empty checkpoint. The space is reserved up front where the file system allows it, so a
+ * full disk is found before hours of rendering rather than after.
+ * @param outputRef - The output being opened
+ * @param header - The PPM header of the image
+ * @param checkpointHeader - The BAND_CHECKPOINT_FIELDS fields the checkpoint starts with, see band_output_open
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int band_output_create(BandOutput *outputRef, char *header, uint32_t *checkpointHeader) {
+	off_t fileSize = (off_t) outputRef->headerSize + (off_t) outputRef->width * outputRef->height * 3;
+
+	outputRef->fd = open(outputRef->fname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (outputRef->fd < 0) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", outputRef->fname);
+		return 1;
+	}
+	int result = posix_fallocate(outputRef->fd, 0, fileSize);
+	if ((result == EOPNOTSUPP || result == EINVAL) && ftruncate(outputRef->fd, fileSize) == 0)
+		result = 0;
+	if (result != 0) {
+		fprintf(stderr, "Error: Could not preallocate %lld bytes for '%s'\n", (long long) fileSize, outputRef->fname);
+		return 1;
+	}
+	if (band_pwrite(outputRef->fd, (uint8_t *) header, outputRef->headerSize, 0) != 0) {
+		fprintf(stderr, "Error: Could not write the header of '%s'\n", outputRef->fname);
+		return 1;
+	}
+
+	// The checkpoint is written last, it must never name an output that is not ready
+	outputRef->checkpointFd = open(outputRef->checkpointFname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (outputRef->checkpointFd < 0 ||
+		band_pwrite(outputRef->checkpointFd, (uint8_t *) BAND_CHECKPOINT_MAGIC, 4, 0) != 0 ||
+		band_pwrite(outputRef->checkpointFd, (uint8_t *) checkpointHeader, sizeof(uint32_t) * BAND_CHECKPOINT_FIELDS, 4) != 0 ||
+		band_pwrite(outputRef->checkpointFd, outputRef->bandsDoneRef, (size_t) outputRef->bandsLength,
+					4 + sizeof(uint32_t) * BAND_CHECKPOINT_FIELDS) != 0 ||
+		fsync(outputRef->fd) != 0 || fsync(outputRef->checkpointFd) != 0) {
+		fprintf(stderr, "Error: Could not write the checkpoint '%s'\n", outputRef->checkpointFname);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Reopens the output file and checkpoint of a render that stopped part way, checking they belong
+ * to a render of this size and scene with the same options
+ * @param outputRef - The output being opened
+ * @param header - The PPM header of the image
+ * @param expectedHeader - The BAND_CHECKPOINT_FIELDS fields the checkpoint must start with, its
+ * band rows are 0 to take them from the checkpoint
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int band_output_reopen(BandOutput *outputRef, char *header, uint32_t *expectedHeader) {
+	char magic[4];
+	uint32_t checkpointHeader[BAND_CHECKPOINT_FIELDS];
+	char fileHeader[64];
+	struct stat fileStat;
+
+	outputRef->checkpointFd = open(outputRef->checkpointFname, O_RDWR);
+	if (outputRef->checkpointFd < 0) {
+		fprintf(stderr, "Error: No checkpoint '%s' to resume from\n", outputRef->checkpointFname);
+		return 1;
+	}
+	if (read(outputRef->checkpointFd, magic, 4) != 4 || memcmp(magic, BAND_CHECKPOINT_MAGIC, 4) != 0 ||
+		read(outputRef->checkpointFd, checkpointHeader, sizeof(checkpointHeader)) != sizeof(checkpointHeader) ||
+		checkpointHeader[0] != BAND_CHECKPOINT_VERSION || checkpointHeader[3] == 0) {
+		fprintf(stderr, "Error: File '%s' is not a supported checkpoint\n", outputRef->checkpointFname);
+		return 1;
+	}
+	if (checkpointHeader[1] != outputRef->width || checkpointHeader[2] != outputRef->height ||
+		(expectedHeader[3] > 0 && checkpointHeader[3] != expectedHeader[3])) {
+		fprintf(stderr, "Error: Checkpoint '%s' is of a %ux%u render in bands of %u rows\n", outputRef->checkpointFname,
+				checkpointHeader[1], checkpointHeader[2], checkpointHeader[3]);
+		return 1;
+	}
+	if (checkpointHeader[4] != expectedHeader[4] || checkpointHeader[5] != expectedHeader[5]) {
+		fprintf(stderr, "Error: Checkpoint '%s' was started with a different scene\n", outputRef->checkpointFname);
+		return 1;
+	}
+	if (memcmp(&checkpointHeader[6], &expectedHeader[6], sizeof(uint32_t) * (BAND_CHECKPOINT_FIELDS - 6)) != 0) {
+		fprintf(stderr, "Error: Checkpoint '%s' was started with --max-depth %u --ray-budget %u --light-samples %u "
+						"--area-samples %u\n", outputRef->checkpointFname, checkpointHeader[6], checkpointHeader[7],
+				checkpointHeader[8], checkpointHeader[9]);
+		return 1;
+	}
+
+	outputRef->bandRows = (int) checkpointHeader[3];
+	outputRef->bandsLength = (int) ((outputRef->height + checkpointHeader[3] - 1) / checkpointHeader[3]);
+	outputRef->bandsDoneRef = malloc((size_t) outputRef->bandsLength);
+	if (outputRef->bandsDoneRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate the checkpoint\n");
+		return 1;
+	}
+	if (read(outputRef->checkpointFd, outputRef->bandsDoneRef, (size_t) outputRef->bandsLength) != outputRef->bandsLength) {
+		fprintf(stderr, "Error: Checkpoint '%s' is truncated\n", outputRef->checkpointFname);
+		return 1;
+	}
+
+	outputRef->fd = open(outputRef->fname, O_RDWR);
+	if (outputRef->fd < 0) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", outputRef->fname);
+		return 1;
+	}
+	if (fstat(outputRef->fd, &fileStat) != 0 ||
+		fileStat.st_size != (off_t) outputRef->headerSize + (off_t) outputRef->width * outputRef->height * 3 ||
+		pread(outputRef->fd, fileHeader, outputRef->headerSize, 0) != (ssize_t) outputRef->headerSize ||
+		memcmp(fileHeader, header, outputRef->headerSize) != 0) {
+		fprintf(stderr, "Error: File '%s' is not the render checkpoint '%s' belongs to\n", outputRef->fname,
+				outputRef->checkpointFname);
+		return 1;
+	}
+
+	for (int i = 0; i < outputRef->bandsLength; i++)
+		outputRef->bandsDone += outputRef->bandsDoneRef[i] != 0;
+	return 0;
+}
+
+/**
+ * Opens an image to be rendered a band of rows at a time. A new render preallocates the output file
+ * and writes an empty checkpoint to the output filename with BAND_CHECKPOINT_SUFFIX appended, a
+ * resumed one reopens both and keeps every band the checkpoint records as done. The checkpoint
+ * records the options that change the pixels, a render is only resumed with the same ones.
+ * @param outputRef - The output to open
+ * @param fname - The output filename, it must be a regular file
+ * @param sceneRef - The scene the image is rendered from
+ * @param optionsRef - The options the image is rendered with
+ * @param width - The width of the image
+ * @param height - The height of the image
+ * @param bandRows - The rows in a band, 0 for bands of about BAND_DEFAULT_BYTES or, when resuming,
+ * the rows the checkpoint was started with
+ * @param isResume - Whether to resume the render recorded in the checkpoint instead of starting over
+ * @return 0 if success, otherwise a failure occurred
+ */
+int band_output_open(BandOutput *outputRef, char *fname, Scene *sceneRef, RenderOptions *optionsRef, int width, int height,
+					 int bandRows, int isResume) {
+	char header[64];
+	uint64_t sceneHash = tile_cache_scene_hash(sceneRef);
+
+	memset(outputRef, 0, sizeof(BandOutput));
+	outputRef->fd = -1;
+	outputRef->checkpointFd = -1;
+	outputRef->fname = fname;
+	outputRef->width = (uint32_t) width;
+	outputRef->height = (uint32_t) height;
+	outputRef->headerSize = (size_t) snprintf(header, sizeof(header), "P6\n%i %i\n255\n", width, height);
+	outputRef->checkpointFname = malloc(strlen(fname) + sizeof(BAND_CHECKPOINT_SUFFIX));
+	if (outputRef->checkpointFname == NULL) {
+		fprintf(stderr, "Error: Could not allocate the checkpoint\n");
+		return 1;
+	}
+	sprintf(outputRef->checkpointFname, "%s%s", fname, BAND_CHECKPOINT_SUFFIX);
+
+	uint32_t checkpointHeader[BAND_CHECKPOINT_FIELDS] = {BAND_CHECKPOINT_VERSION, outputRef->width, outputRef->height,
+														 (uint32_t) (bandRows > 0 ? bandRows : 0), (uint32_t) sceneHash,
+														 (uint32_t) (sceneHash >> 32),
+														 (uint32_t) optionsRef->maxDepth, (uint32_t) optionsRef->rayBudget,
+														 (uint32_t) optionsRef->lightSamples, (uint32_t) optionsRef->areaLightSamples};
+	if (isResume) {
+		if (band_output_reopen(outputRef, header, checkpointHeader) != 0) {
+			band_output_close(outputRef);
+			return 1;
+		}
+	}
+	else {
+		// By default a band and its RGB copy take about BAND_DEFAULT_BYTES, in whole rows of tiles
+		if (bandRows <= 0) {
+			size_t rowSize = (size_t) width * (sizeof(RGBApixel) + 3);
+			bandRows = (int) (BAND_DEFAULT_BYTES / rowSize) / RENDER_TILE_SIZE * RENDER_TILE_SIZE;
+			if (bandRows < RENDER_TILE_SIZE)
+				bandRows = RENDER_TILE_SIZE;
+		}
+		outputRef->bandRows = bandRows < height ? bandRows : height;
+		outputRef->bandsLength = (height + outputRef->bandRows - 1) / outputRef->bandRows;
+		outputRef->bandsDoneRef = calloc((size_t) outputRef->bandsLength, 1);
+		if (outputRef->bandsDoneRef == NULL) {
+			fprintf(stderr, "Error: Could not allocate the checkpoint\n");
+			band_output_close(outputRef);
+			return 1;
+		}
+		checkpointHeader[3] = (uint32_t) outputRef->bandRows;
+		if (band_output_create(outputRef, header, checkpointHeader) != 0) {
+			band_output_close(outputRef);
+			return 1;
+		}
+	}
+
+	outputRef->buffer = malloc((size_t) 3 * width * outputRef->bandRows);
+	if (outputRef->buffer == NULL) {
+		fprintf(stderr, "Error: Could not allocate a band of size %ix%i\n", width, outputRef->bandRows);
+		band_output_close(outputRef);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Renders every band the output still lacks. Each band is rendered into the renderer's framebuffer,
+ * written in place and flushed to disk before the checkpoint records it, so a band the checkpoint
+ * names as done is always whole in the output.
+ * @param outputRef - The open output
+ * @param rendererRef - The renderer to render each band with
+ * @param sceneRef - The input scene to render
+ * @param optionsRef - The options to render with
+ * @return 0 if success, otherwise a failure occurred
+ */
+int band_output_render(BandOutput *outputRef, Renderer *rendererRef, Scene *sceneRef, RenderOptions *optionsRef) {
+	RenderOptions options = *optionsRef;
+	uint8_t done = 1;
+
+	options.fullHeight = (int) outputRef->height;
+	for (int band = 0; band < outputRef->bandsLength; band++) {
+		if (outputRef->bandsDoneRef[band])
+			continue;
+		uint32_t y0 = (uint32_t) band * outputRef->bandRows;
+		uint32_t y1 = y0 + outputRef->bandRows < outputRef->height ? y0 + outputRef->bandRows : outputRef->height;
+		size_t pixelsLength = (size_t) (y1 - y0) * outputRef->width;
+		off_t offset = (off_t) outputRef->headerSize + (off_t) y0 * outputRef->width * 3;
+
+		options.firstRow = (int) y0;
+		if (renderer_render(rendererRef, sceneRef, &options, (int) outputRef->width, (int) (y1 - y0)) != 0)
+			return 1;
+		for (size_t i = 0; i < pixelsLength; i++) {
+			outputRef->buffer[3 * i] = rendererRef->image.pixmapRef[i].r;
+			outputRef->buffer[3 * i + 1] = rendererRef->image.pixmapRef[i].g;
+			outputRef->buffer[3 * i + 2] = rendererRef->image.pixmapRef[i].b;
+		}
+		if (band_pwrite(outputRef->fd, outputRef->buffer, 3 * pixelsLength, offset) != 0 || fdatasync(outputRef->fd) != 0) {
+			fprintf(stderr, "Error: Could not write rows %u to %u of '%s'\n", y0, y1, outputRef->fname);
+			return 1;
+		}
+		if (band_pwrite(outputRef->checkpointFd, &done, 1, 4 + BAND_CHECKPOINT_FIELDS * sizeof(uint32_t) + (off_t) band) != 0 ||
+			fdatasync(outputRef->checkpointFd) != 0) {
+			fprintf(stderr, "Error: Could not write the checkpoint '%s'\n", outputRef->checkpointFname);
+			return 1;
+		}
+		outputRef->bandsDoneRef[band] = 1;
+		outputRef->bandsDone++;
+	}
+	return 0;
+}
+
+/**
+ * Closes the output file and checkpoint and releases the output. The checkpoint is removed once
+ * every band is done, otherwise it is kept for the render to be resumed.
+ * @param outputRef - The output to close
+ * @return 0 if success, otherwise a failure occurred
+ */
+int band_output_close(BandOutput *outputRef) {
+	int result = 0;
+
+	if (outputRef->fd >= 0 && close(outputRef->fd) != 0) {
+		fprintf(stderr, "Error: Could not finish writing '%s'\n", outputRef->fname);
+		result = 1;
+	}
+	if (outputRef->checkpointFd >= 0) {
+		close(outputRef->checkpointFd);
+		if (result == 0 && outputRef->bandsLength > 0 && outputRef->bandsDone == outputRef->bandsLength &&
+			unlink(outputRef->checkpointFname) != 0) {
+			fprintf(stderr, "Error: Could not remove the checkpoint '%s'\n", outputRef->checkpointFname);
+			result = 1;
+		}
+	}
+
+	free(outputRef->checkpointFname);
+	free(outputRef->bandsDoneRef);
+	free(outputRef->buffer);
+	outputRef->checkpointFname = NULL;
+	outputRef->bandsDoneRef = NULL;
+	outputRef->buffer = NULL;
+	outputRef->fd = -1;
+	outputRef->checkpointFd = -1;
+	return result;
+}
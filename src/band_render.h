@@ -0,0 +1,45 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_BAND_RENDER_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_BAND_RENDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "raycaster.h"
+#include "renderer.h"
+
+#define BAND_CHECKPOINT_MAGIC "RCKP"
+#define BAND_CHECKPOINT_VERSION 3
+#define BAND_CHECKPOINT_FIELDS 10
+#define BAND_CHECKPOINT_SUFFIX ".ckpt"
+#define BAND_DEFAULT_BYTES (64 * 1024 * 1024)
+
+/**
+ * BandOutput - A PPM P6 image rendered out of core a band of rows at a time. The output file is
+ * preallocated at its full size and each band is written in place once rendered, so memory only
+ * grows with the size of a band. A sidecar checkpoint next to the output records the size, band
+ * height, a 64 bit hash of the loaded scene and the options that change the pixels, followed by
+ * one byte per band set once the band is safely on disk. A render that stops part way is resumed
+ * by rendering only the bands the checkpoint lacks.
+ */
+typedef struct BandOutput {
+	int fd;
+	int checkpointFd;
+	char *fname;
+	char *checkpointFname;
+	uint32_t width, height;
+	int bandRows, bandsLength;
+	int bandsDone;
+	uint8_t *bandsDoneRef;
+	size_t headerSize;
+	uint8_t *buffer;
+} BandOutput;
+
+int band_output_open(BandOutput *outputRef, char *fname, Scene *sceneRef, RenderOptions *optionsRef, int width, int height,
+					 int bandRows, int isResume);
+int band_output_render(BandOutput *outputRef, Renderer *rendererRef, Scene *sceneRef, RenderOptions *optionsRef);
+int band_output_close(BandOutput *outputRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_BAND_RENDER_H
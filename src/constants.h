@@ -9,5 +9,8 @@
 #define FALSE 0
 #define LOG_LEVEL 2
 #define INITIAL_BUFFER_SIZE 64
+#define JSON_MAX_NUMBER_LENGTH 512
+#define JSON_MIN_CHUNK_SIZE (256 << 10)
+#define JSON_MAX_CHUNK_SIZE (2 << 20)
 
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_CONSTANTS_H
\ No newline at end of file
@@ -0,0 +1,132 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "cost.h"
+
+/**
+ * Allocates the counters of a cost buffer, every counter starts at zero
+ * @param costRef - The cost buffer to allocate
+ * @param width - The width of the image the cost buffer belongs to
+ * @param height - The height of the image the cost buffer belongs to
+ * @return 0 if success, otherwise a failure occurred
+ */
+int cost_buffer_create(CostBuffer *costRef, int width, int height) {
+	costRef->width = (uint32_t) width;
+	costRef->height = (uint32_t) height;
+	costRef->countersRef = calloc((size_t) width * height * COST_CHANNELS, sizeof(uint32_t));
+
+	if (costRef->countersRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate a cost buffer of size %ix%i\n", width, height);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Releases the counters held by a cost buffer
+ * @param costRef - The cost buffer to free
+ */
+void cost_buffer_free(CostBuffer *costRef) {
+	free(costRef->countersRef);
+	costRef->countersRef = NULL;
+}
+
+/**
+ * Write the specified cost buffer to a file as raw 32-bit counters in host byte order
+ * @param costRef - The cost buffer to write
+ * @param fname - The output filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int save_cost_buffer(CostBuffer *costRef, char *fname) {
+	FILE* fp = fopen(fname, "wb");
+	uint32_t header[4];
+
+	if (fp) {
+		header[0] = COST_BUFFER_VERSION;
+		header[1] = costRef->width;
+		header[2] = costRef->height;
+		header[3] = COST_CHANNELS;
+
+		size_t count = (size_t) costRef->width * costRef->height * COST_CHANNELS;
+		if (fwrite(COST_BUFFER_MAGIC, 1, 4, fp) != 4 ||
+			fwrite(header, sizeof(uint32_t), 4, fp) != 4 ||
+			fwrite(costRef->countersRef, sizeof(uint32_t), count, fp) != count) {
+			fprintf(stderr, "Error: Could not write cost buffer to file '%s'\n", fname);
+			fclose(fp);
+			return 1;
+		}
+
+		fclose(fp);
+		return 0;
+	}
+	else {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+}
+
+/**
+ * Allocates space in the imageRef specified and false colours the total work of every pixel
+ * into it, from blue for the cheapest through cyan, green and yellow to red for the most
+ * expensive pixel. The scale is logarithmic so a few very expensive pixels do not flatten the
+ * rest, and pixels that took no work at all are black.
+ * @param costRef - The cost buffer to map
+ * @param imageRef - The output image to write to
+ * @return 0 if success, otherwise a failure occurred
+ */
+int cost_buffer_to_heatmap(CostBuffer *costRef, Image *imageRef) {
+	static const double ramp[COST_RAMP_STOPS][3] = {
+		{0, 0, 1},
+		{0, 1, 1},
+		{0, 1, 0},
+		{1, 1, 0},
+		{1, 0, 0}
+	};
+	size_t pixelsLength = (size_t) costRef->width * costRef->height;
+	uint64_t maxTotal = 0;
+
+	imageRef->width = costRef->width;
+	imageRef->height = costRef->height;
+	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * pixelsLength);
+	if (imageRef->pixmapRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate a heatmap of size %ux%u\n", costRef->width, costRef->height);
+		return 1;
+	}
+
+	for (size_t i = 0; i < pixelsLength; i++) {
+		uint32_t *countersRef = &costRef->countersRef[i * COST_CHANNELS];
+		uint64_t total = (uint64_t) countersRef[0] + countersRef[1] + countersRef[2];
+		if (total > maxTotal)
+			maxTotal = total;
+	}
+
+	for (size_t i = 0; i < pixelsLength; i++) {
+		uint32_t *countersRef = &costRef->countersRef[i * COST_CHANNELS];
+		uint64_t total = (uint64_t) countersRef[0] + countersRef[1] + countersRef[2];
+		RGBApixel *pixelRef = &imageRef->pixmapRef[i];
+
+		pixelRef->a = 255;
+		if (total == 0) {
+			pixelRef->r = pixelRef->g = pixelRef->b = 0;
+			continue;
+		}
+
+		// Position along the ramp, the cheapest possible pixel (one test) sits at its start
+		double position = maxTotal > 1 ? log((double) total) / log((double) maxTotal) : 0;
+		position *= COST_RAMP_STOPS - 1;
+		int stop = (int) position;
+		if (stop >= COST_RAMP_STOPS - 1)
+			stop = COST_RAMP_STOPS - 2;
+		double blend = position - stop;
+
+		pixelRef->r = (uint8_t) (255 * (ramp[stop][0] + (ramp[stop + 1][0] - ramp[stop][0]) * blend) + 0.5);
+		pixelRef->g = (uint8_t) (255 * (ramp[stop][1] + (ramp[stop + 1][1] - ramp[stop][1]) * blend) + 0.5);
+		pixelRef->b = (uint8_t) (255 * (ramp[stop][2] + (ramp[stop + 1][2] - ramp[stop][2]) * blend) + 0.5);
+	}
+
+	return 0;
+}
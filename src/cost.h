@@ -0,0 +1,38 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_COST_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_COST_H
+
+#include <stdint.h>
+#include "imaging.h"
+
+#define COST_BUFFER_MAGIC "RCCB"
+#define COST_BUFFER_VERSION 1
+#define COST_CHANNELS 3
+#define COST_RAMP_STOPS 5
+
+/**
+ * Counters kept for every pixel, in the order they are stored
+ */
+typedef enum CostChannel_t {
+	COST_INTERSECTION_TESTS,
+	COST_SHADOW_RAYS,
+	COST_LIGHTS_SHADED
+} CostChannel_t;
+
+/**
+ * CostBuffer - The work spent on each pixel of a render, COST_CHANNELS counters per pixel
+ */
+typedef struct CostBuffer {
+	uint32_t width, height;
+	uint32_t *countersRef;
+} CostBuffer;
+
+int cost_buffer_create(CostBuffer *costRef, int width, int height);
+void cost_buffer_free(CostBuffer *costRef);
+int save_cost_buffer(CostBuffer *costRef, char *fname);
+int cost_buffer_to_heatmap(CostBuffer *costRef, Image *imageRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_COST_H
@@ -0,0 +1,344 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "dirty.h"
+#include "json.h"
+#include "raycaster_helpers.h"
+
+/**
+ * Allocates an empty dirty region the size of a render
+ * @param regionRef - The region to allocate
+ * @param width - The width of the render
+ * @param height - The height of the render
+ * @return 0 if success, otherwise a failure occurred
+ */
+int dirty_region_create(DirtyRegion *regionRef, int width, int height) {
+	regionRef->width = (uint32_t) width;
+	regionRef->height = (uint32_t) height;
+	regionRef->pixelsLength = 0;
+	regionRef->maskRef = calloc((size_t) width * height, sizeof(uint8_t));
+
+	if (regionRef->maskRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate a dirty region of size %ix%i\n", width, height);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Releases the mask held by a dirty region
+ * @param regionRef - The region to free
+ */
+void dirty_region_free(DirtyRegion *regionRef) {
+	free(regionRef->maskRef);
+	regionRef->maskRef = NULL;
+}
+
+/**
+ * Marks every pixel of a region dirty
+ * @param regionRef - The region to mark
+ */
+void dirty_region_add_all(DirtyRegion *regionRef) {
+	regionRef->pixelsLength = (size_t) regionRef->width * regionRef->height;
+	memset(regionRef->maskRef, 1, regionRef->pixelsLength);
+}
+
+/**
+ * Marks the pixels whose primary ray passes through a rectangle of the view plane dirty
+ * @param regionRef - The region to mark
+ * @param cameraRef - The camera the render was taken with
+ * @param minX - The left edge of the rectangle on the view plane
+ * @param maxX - The right edge of the rectangle on the view plane
+ * @param minY - The bottom edge of the rectangle on the view plane
+ * @param maxY - The top edge of the rectangle on the view plane
+ */
+static void dirty_region_add_rect(DirtyRegion *regionRef, Camera *cameraRef, double minX, double maxX,
+								  double minY, double maxY) {
+	double pixelWidth = cameraRef->width / regionRef->width;
+	double pixelHeight = cameraRef->height / regionRef->height;
+
+	// Invert the pixel center placement of raycast, rows grow downwards
+	double left = floor((minX + cameraRef->width / 2.0) / pixelWidth - 0.5) - DIRTY_REGION_MARGIN;
+	double right = ceil((maxX + cameraRef->width / 2.0) / pixelWidth - 0.5) + DIRTY_REGION_MARGIN;
+	double top = floor((cameraRef->height / 2.0 - maxY) / pixelHeight - 0.5) - DIRTY_REGION_MARGIN;
+	double bottom = ceil((cameraRef->height / 2.0 - minY) / pixelHeight - 0.5) + DIRTY_REGION_MARGIN;
+
+	// Clamp while still a double, the rectangle may be far outside the image
+	left = fmax(left, 0);
+	top = fmax(top, 0);
+	right = fmin(right, regionRef->width - 1.0);
+	bottom = fmin(bottom, regionRef->height - 1.0);
+
+	for (int y = (int) top; y <= (int) bottom; y++) {
+		uint8_t *rowRef = &regionRef->maskRef[(size_t) y * regionRef->width];
+		for (int x = (int) left; x <= (int) right; x++) {
+			regionRef->pixelsLength += !rowRef[x];
+			rowRef[x] = 1;
+		}
+	}
+}
+
+/**
+ * Marks the pixels a world space box may be seen through dirty
+ * @param regionRef - The region to mark
+ * @param cameraRef - The camera the render was taken with
+ * @param minRef - The minimum corner of the box
+ * @param maxRef - The maximum corner of the box
+ */
+void dirty_region_add_bounds(DirtyRegion *regionRef, Camera *cameraRef, V3 *minRef, V3 *maxRef) {
+	// A box reaching the plane of the camera projects to an unbounded area
+	if (!(minRef->data.Z > 0) || !isfinite(maxRef->data.X + maxRef->data.Y + maxRef->data.Z) ||
+		!isfinite(minRef->data.X + minRef->data.Y)) {
+		dirty_region_add_all(regionRef);
+		return;
+	}
+
+	double minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+	for (int i = 0; i < 8; i++) {
+		double x = (i & 1) ? maxRef->data.X : minRef->data.X;
+		double y = (i & 2) ? maxRef->data.Y : minRef->data.Y;
+		double z = (i & 4) ? maxRef->data.Z : minRef->data.Z;
+		minX = fmin(minX, x / z);
+		maxX = fmax(maxX, x / z);
+		minY = fmin(minY, y / z);
+		maxY = fmax(maxY, y / z);
+	}
+
+	dirty_region_add_rect(regionRef, cameraRef, minX, maxX, minY, maxY);
+}
+
+/**
+ * Marks the pixels that may see a shadow a world space box casts from a light dirty. A shadowed
+ * point lies on a ray from the light through the box, past the box, so it projects between the
+ * box and the vanishing point of that ray. An area light casts its shadow from every point of its
+ * box, the vanishing points of the rays between any corner of the light and any corner of the box
+ * bound all of them.
+ * @param regionRef - The region to mark
+ * @param cameraRef - The camera the render was taken with
+ * @param minRef - The minimum corner of the box
+ * @param maxRef - The maximum corner of the box
+ * @param lightMinRef - The minimum corner of the light, its position for a point light
+ * @param lightMaxRef - The maximum corner of the light, its position for a point light
+ */
+void dirty_region_add_shadow(DirtyRegion *regionRef, Camera *cameraRef, V3 *minRef, V3 *maxRef, V3 *lightMinRef, V3 *lightMaxRef) {
+	// Shadows cast back towards the camera can reach any pixel
+	if (!(minRef->data.Z > 0) || !(minRef->data.Z - lightMaxRef->data.Z > 0) ||
+		!isfinite(maxRef->data.X + maxRef->data.Y + maxRef->data.Z) || !isfinite(minRef->data.X + minRef->data.Y)) {
+		dirty_region_add_all(regionRef);
+		return;
+	}
+
+	double minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+	for (int i = 0; i < 8; i++) {
+		double x = (i & 1) ? maxRef->data.X : minRef->data.X;
+		double y = (i & 2) ? maxRef->data.Y : minRef->data.Y;
+		double z = (i & 4) ? maxRef->data.Z : minRef->data.Z;
+		minX = fmin(minX, x / z);
+		maxX = fmax(maxX, x / z);
+		minY = fmin(minY, y / z);
+		maxY = fmax(maxY, y / z);
+		for (int j = 0; j < 8; j++) {
+			double dx = x - ((j & 1) ? lightMaxRef->data.X : lightMinRef->data.X);
+			double dy = y - ((j & 2) ? lightMaxRef->data.Y : lightMinRef->data.Y);
+			double dz = z - ((j & 4) ? lightMaxRef->data.Z : lightMinRef->data.Z);
+			minX = fmin(minX, dx / dz);
+			maxX = fmax(maxX, dx / dz);
+			minY = fmin(minY, dy / dz);
+			maxY = fmax(maxY, dy / dz);
+		}
+	}
+
+	dirty_region_add_rect(regionRef, cameraRef, minX, maxX, minY, maxY);
+}
+
+/**
+ * Determine if two group definitions place the same primitives
+ */
+static int groups_equal(Group *aRef, Group *bRef) {
+	if (aRef->primitivesLength != bRef->primitivesLength)
+		return 0;
+
+	for (int i = 0; i < aRef->primitivesLength; i++) {
+		Primitive *aPrimitiveRef = &aRef->primitives[i];
+		Primitive *bPrimitiveRef = &bRef->primitives[i];
+		if (aPrimitiveRef->type != bPrimitiveRef->type)
+			return 0;
+		if (aPrimitiveRef->type == SPHERE_T &&
+			memcmp(&aPrimitiveRef->data.sphere, &bPrimitiveRef->data.sphere, sizeof(Sphere)) != 0)
+			return 0;
+		if (aPrimitiveRef->type == PLANE_T &&
+			memcmp(&aPrimitiveRef->data.plane, &bPrimitiveRef->data.plane, sizeof(Plane)) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Determine if two instances, each from its own scene, place the same group definition the same way
+ */
+static int instances_equal(Scene *aSceneRef, Instance *aRef, Scene *bSceneRef, Instance *bRef) {
+	Group *aGroupRef = &aSceneRef->groups[aRef->groupId];
+	Group *bGroupRef = &bSceneRef->groups[bRef->groupId];
+
+	return strcmp(aGroupRef->name, bGroupRef->name) == 0 && groups_equal(aGroupRef, bGroupRef) &&
+		   memcmp(&aRef->worldToObject, &bRef->worldToObject, sizeof(A3)) == 0;
+}
+
+/**
+ * Determine if two meshes have the same material and triangles
+ */
+static int meshes_equal(TriangleMesh *aRef, TriangleMesh *bRef) {
+	Mesh *aMeshRef = &aRef->mesh;
+	Mesh *bMeshRef = &bRef->mesh;
+
+	return memcmp(&aRef->diffuseColor, &bRef->diffuseColor, sizeof(V3)) == 0 &&
+		   memcmp(&aRef->specularColor, &bRef->specularColor, sizeof(V3)) == 0 &&
+		   aRef->reflectivity == bRef->reflectivity &&
+		   aMeshRef->verticesLength == bMeshRef->verticesLength &&
+		   aMeshRef->trianglesLength == bMeshRef->trianglesLength &&
+		   memcmp(aMeshRef->vertices, bMeshRef->vertices, sizeof(float) * 3 * aMeshRef->verticesLength) == 0 &&
+		   memcmp(aMeshRef->indices, bMeshRef->indices, sizeof(uint32_t) * 3 * aMeshRef->trianglesLength) == 0;
+}
+
+/**
+ * Determine if a group places any reflective primitive
+ */
+static int group_is_reflective(Group *groupRef) {
+	for (int i = 0; i < groupRef->primitivesLength; i++) {
+		Primitive *primitiveRef = &groupRef->primitives[i];
+		if (primitiveRef->type == SPHERE_T && primitiveRef->data.sphere.reflectivity > 0)
+			return 1;
+		if (primitiveRef->type == PLANE_T && primitiveRef->data.plane.reflectivity > 0)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Marks the pixels an object whose box changed may affect dirty, both where it is seen and where it
+ * may shadow other objects from each light
+ */
+static void dirty_region_add_change(DirtyRegion *regionRef, Scene *sceneRef, V3 *minRef, V3 *maxRef) {
+	V3 lightMin, lightMax;
+
+	dirty_region_add_bounds(regionRef, &sceneRef->camera, minRef, maxRef);
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		light_bounds(&sceneRef->lights[i], &lightMin, &lightMax);
+		dirty_region_add_shadow(regionRef, &sceneRef->camera, minRef, maxRef, &lightMin, &lightMax);
+	}
+}
+
+/**
+ * Marks the pixels of every reflective object in a scene dirty, a reflection may show any change
+ * @return 0 if the scene has no reflective plane, otherwise the whole region was marked
+ */
+static int dirty_region_add_reflections(DirtyRegion *regionRef, Scene *sceneRef) {
+	V3 min, max;
+
+	for (int i = 0; i < sceneRef->planesLength; i++) {
+		if (sceneRef->planes[i].reflectivity > 0) {
+			dirty_region_add_all(regionRef);
+			return 1;
+		}
+	}
+	for (int i = 0; i < sceneRef->spheresLength; i++) {
+		if (sceneRef->spheres[i].reflectivity > 0) {
+			sphere_bounds(&sceneRef->spheres[i], &min, &max);
+			dirty_region_add_bounds(regionRef, &sceneRef->camera, &min, &max);
+		}
+	}
+	for (int i = 0; i < sceneRef->instancesLength; i++) {
+		if (group_is_reflective(&sceneRef->groups[sceneRef->instances[i].groupId])) {
+			instance_bounds(sceneRef, &sceneRef->instances[i], &min, &max);
+			dirty_region_add_bounds(regionRef, &sceneRef->camera, &min, &max);
+		}
+	}
+	for (int i = 0; i < sceneRef->meshesLength; i++) {
+		if (sceneRef->meshes[i].reflectivity > 0 && mesh_bounds(&sceneRef->meshes[i], &min, &max) == 0)
+			dirty_region_add_bounds(regionRef, &sceneRef->camera, &min, &max);
+	}
+	return 0;
+}
+
+/**
+ * Works out which objects differ between two scenes and marks every pixel of a render of the old
+ * scene that may look different in a render of the new scene. Objects are matched by their
+ * position in the scene file, groups by name. A changed camera, light or plane marks every pixel.
+ * @param oldSceneRef - The scene the previous render was taken of
+ * @param newSceneRef - The edited scene
+ * @param regionRef - A region created at the size of the render, the changed pixels are marked
+ * @return 0 if success, otherwise a failure occurred
+ */
+int dirty_region_from_scenes(Scene *oldSceneRef, Scene *newSceneRef, DirtyRegion *regionRef) {
+	V3 min, max;
+	size_t changesLength = 0;
+
+	if (memcmp(&oldSceneRef->camera, &newSceneRef->camera, sizeof(Camera)) != 0 ||
+		oldSceneRef->lightsLength != newSceneRef->lightsLength ||
+		memcmp(oldSceneRef->lights, newSceneRef->lights, sizeof(Light) * newSceneRef->lightsLength) != 0 ||
+		oldSceneRef->planesLength != newSceneRef->planesLength ||
+		memcmp(oldSceneRef->planes, newSceneRef->planes, sizeof(Plane) * newSceneRef->planesLength) != 0) {
+		dirty_region_add_all(regionRef);
+		return 0;
+	}
+
+	int spheresLength = oldSceneRef->spheresLength > newSceneRef->spheresLength ?
+						oldSceneRef->spheresLength : newSceneRef->spheresLength;
+	for (int i = 0; i < spheresLength; i++) {
+		if (i < oldSceneRef->spheresLength && i < newSceneRef->spheresLength &&
+			memcmp(&oldSceneRef->spheres[i], &newSceneRef->spheres[i], sizeof(Sphere)) == 0)
+			continue;
+
+		changesLength++;
+		if (i < oldSceneRef->spheresLength) {
+			sphere_bounds(&oldSceneRef->spheres[i], &min, &max);
+			dirty_region_add_change(regionRef, newSceneRef, &min, &max);
+		}
+		if (i < newSceneRef->spheresLength) {
+			sphere_bounds(&newSceneRef->spheres[i], &min, &max);
+			dirty_region_add_change(regionRef, newSceneRef, &min, &max);
+		}
+	}
+
+	int instancesLength = oldSceneRef->instancesLength > newSceneRef->instancesLength ?
+						  oldSceneRef->instancesLength : newSceneRef->instancesLength;
+	for (int i = 0; i < instancesLength; i++) {
+		if (i < oldSceneRef->instancesLength && i < newSceneRef->instancesLength &&
+			instances_equal(oldSceneRef, &oldSceneRef->instances[i], newSceneRef, &newSceneRef->instances[i]))
+			continue;
+
+		changesLength++;
+		if (i < oldSceneRef->instancesLength) {
+			instance_bounds(oldSceneRef, &oldSceneRef->instances[i], &min, &max);
+			dirty_region_add_change(regionRef, newSceneRef, &min, &max);
+		}
+		if (i < newSceneRef->instancesLength) {
+			instance_bounds(newSceneRef, &newSceneRef->instances[i], &min, &max);
+			dirty_region_add_change(regionRef, newSceneRef, &min, &max);
+		}
+	}
+
+	int meshesLength = oldSceneRef->meshesLength > newSceneRef->meshesLength ?
+					   oldSceneRef->meshesLength : newSceneRef->meshesLength;
+	for (int i = 0; i < meshesLength; i++) {
+		if (i < oldSceneRef->meshesLength && i < newSceneRef->meshesLength &&
+			meshes_equal(&oldSceneRef->meshes[i], &newSceneRef->meshes[i]))
+			continue;
+
+		changesLength++;
+		if (i < oldSceneRef->meshesLength && mesh_bounds(&oldSceneRef->meshes[i], &min, &max) == 0)
+			dirty_region_add_change(regionRef, newSceneRef, &min, &max);
+		if (i < newSceneRef->meshesLength && mesh_bounds(&newSceneRef->meshes[i], &min, &max) == 0)
+			dirty_region_add_change(regionRef, newSceneRef, &min, &max);
+	}
+
+	// Reflective objects may show a change from anywhere in the scene
+	if (changesLength > 0 && dirty_region_add_reflections(regionRef, oldSceneRef) == 0)
+		dirty_region_add_reflections(regionRef, newSceneRef);
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_DIRTY_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_DIRTY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "raycaster.h"
+
+// Pixels added around every projected rectangle to absorb rounding in the projection
+#define DIRTY_REGION_MARGIN 1
+
+/**
+ * DirtyRegion - A per-pixel mask of the pixels of a render that a scene edit may have changed
+ */
+typedef struct DirtyRegion {
+	uint32_t width, height;
+	uint8_t *maskRef;
+	size_t pixelsLength;
+} DirtyRegion;
+
+int dirty_region_create(DirtyRegion *regionRef, int width, int height);
+void dirty_region_free(DirtyRegion *regionRef);
+void dirty_region_add_all(DirtyRegion *regionRef);
+void dirty_region_add_bounds(DirtyRegion *regionRef, Camera *cameraRef, V3 *minRef, V3 *maxRef);
+void dirty_region_add_shadow(DirtyRegion *regionRef, Camera *cameraRef, V3 *minRef, V3 *maxRef, V3 *lightMinRef, V3 *lightMaxRef);
+int dirty_region_from_scenes(Scene *oldSceneRef, Scene *newSceneRef, DirtyRegion *regionRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_DIRTY_H
@@ -0,0 +1,174 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "frame_stream.h"
+
+/**
+ * Determine the stream format named on the command line
+ * @param name - The name of the format, one of ppm or y4m
+ * @param formatRef - The format is written here
+ * @return 0 if success, otherwise the name is not a supported format
+ */
+int stream_format_parse(char *name, StreamFormat_t *formatRef) {
+	if (strcmp(name, "ppm") == 0)
+		*formatRef = STREAM_FORMAT_PPM;
+	else if (strcmp(name, "y4m") == 0)
+		*formatRef = STREAM_FORMAT_Y4M;
+	else {
+		fprintf(stderr, "Error: Unknown stream format '%s', expected ppm or y4m\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Opens a stream of frames and writes its header, a FIFO blocks here until a reader opens it
+ * @param streamRef - The stream to open
+ * @param fname - The file or FIFO to write to, "-" for stdout
+ * @param format - The format to write the frames in
+ * @param width - The width of every frame
+ * @param height - The height of every frame
+ * @param fps - The frames per second given in a Y4M header
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_stream_open(FrameStream *streamRef, char *fname, StreamFormat_t format, int width, int height, int fps) {
+	size_t pixelsLength = (size_t) width * height;
+	size_t chromaLength = (size_t) ((width + 1) / 2) * ((height + 1) / 2);
+
+	streamRef->format = format;
+	streamRef->width = (uint32_t) width;
+	streamRef->height = (uint32_t) height;
+	streamRef->fps = fps;
+	streamRef->framesLength = 0;
+	streamRef->bufferSize = format == STREAM_FORMAT_Y4M ? pixelsLength + 2 * chromaLength : 3 * pixelsLength;
+	streamRef->buffer = malloc(streamRef->bufferSize);
+	if (streamRef->buffer == NULL) {
+		fprintf(stderr, "Error: Could not allocate a stream frame of size %ix%i\n", width, height);
+		return 1;
+	}
+
+	if (strcmp(fname, "-") == 0) {
+		streamRef->fp = stdout;
+		streamRef->isOwned = 0;
+	}
+	else {
+		streamRef->fp = fopen(fname, "wb");
+		streamRef->isOwned = 1;
+	}
+	if (streamRef->fp == NULL) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		free(streamRef->buffer);
+		streamRef->buffer = NULL;
+		return 1;
+	}
+
+	if (format == STREAM_FORMAT_Y4M &&
+		fprintf(streamRef->fp, "YUV4MPEG2 W%i H%i F%i:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps) < 0) {
+		fprintf(stderr, "Error: Could not write the stream header to '%s'\n", fname);
+		frame_stream_close(streamRef);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Converts an image into the Y, U and V planes of a 4:2:0 frame with BT.601 limited range integer
+ * weights. Each chroma sample is the mean of the 2x2 pixels it covers, a block cut off by an odd
+ * width or height averages the pixels it has.
+ * @param imageRef - The image to convert
+ * @param buffer - Room for the three planes, written here one after the other
+ */
+static void frame_stream_rgb_to_yuv(Image *imageRef, uint8_t *buffer) {
+	uint32_t width = imageRef->width, height = imageRef->height;
+	uint32_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+	uint8_t *yPlane = buffer;
+	uint8_t *uPlane = yPlane + (size_t) width * height;
+	uint8_t *vPlane = uPlane + (size_t) chromaWidth * chromaHeight;
+
+	for (uint32_t y = 0; y < height; y++) {
+		RGBApixel *rowRef = &imageRef->pixmapRef[(size_t) y * width];
+		for (uint32_t x = 0; x < width; x++)
+			yPlane[(size_t) y * width + x] = (uint8_t) (((66 * rowRef[x].r + 129 * rowRef[x].g + 25 * rowRef[x].b + 128) >> 8) + 16);
+	}
+
+	for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+		for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+			int r = 0, g = 0, b = 0, count = 0;
+			for (uint32_t y = 2 * cy; y < 2 * cy + 2 && y < height; y++) {
+				for (uint32_t x = 2 * cx; x < 2 * cx + 2 && x < width; x++) {
+					RGBApixel *pixelRef = &imageRef->pixmapRef[(size_t) y * width + x];
+					r += pixelRef->r;
+					g += pixelRef->g;
+					b += pixelRef->b;
+					count++;
+				}
+			}
+			r = (r + count / 2) / count;
+			g = (g + count / 2) / count;
+			b = (b + count / 2) / count;
+			// The sums are shifted as a whole so a negative one still rounds down
+			uPlane[(size_t) cy * chromaWidth + cx] = (uint8_t) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			vPlane[(size_t) cy * chromaWidth + cx] = (uint8_t) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+}
+
+/**
+ * Writes the next frame of a stream and flushes it, so a reader can start on it while the next
+ * frame renders
+ * @param streamRef - The stream to write to
+ * @param imageRef - The frame, the same size as the stream
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_stream_write(FrameStream *streamRef, Image *imageRef) {
+	if (imageRef->width != streamRef->width || imageRef->height != streamRef->height) {
+		fprintf(stderr, "Error: A %ux%u frame can not be written to a %ux%u stream\n",
+				imageRef->width, imageRef->height, streamRef->width, streamRef->height);
+		return 1;
+	}
+
+	int written;
+	if (streamRef->format == STREAM_FORMAT_Y4M) {
+		frame_stream_rgb_to_yuv(imageRef, streamRef->buffer);
+		written = fprintf(streamRef->fp, "FRAME\n");
+	}
+	else {
+		size_t pixelsLength = (size_t) imageRef->width * imageRef->height;
+		for (size_t i = 0; i < pixelsLength; i++) {
+			streamRef->buffer[3 * i] = imageRef->pixmapRef[i].r;
+			streamRef->buffer[3 * i + 1] = imageRef->pixmapRef[i].g;
+			streamRef->buffer[3 * i + 2] = imageRef->pixmapRef[i].b;
+		}
+		written = fprintf(streamRef->fp, "P6\n%u %u\n255\n", imageRef->width, imageRef->height);
+	}
+
+	if (written < 0 || fwrite(streamRef->buffer, 1, streamRef->bufferSize, streamRef->fp) != streamRef->bufferSize ||
+		fflush(streamRef->fp) != 0) {
+		fprintf(stderr, "Error: Could not write frame %i to the stream\n", streamRef->framesLength);
+		return 1;
+	}
+	streamRef->framesLength++;
+	return 0;
+}
+
+/**
+ * Closes a stream of frames and releases its buffer, stdout is flushed but left open
+ * @param streamRef - The stream to close
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_stream_close(FrameStream *streamRef) {
+	int result = streamRef->isOwned ? fclose(streamRef->fp) : fflush(streamRef->fp);
+
+	free(streamRef->buffer);
+	streamRef->buffer = NULL;
+	streamRef->fp = NULL;
+	if (result != 0) {
+		fprintf(stderr, "Error: Could not close the stream\n");
+		return 1;
+	}
+	return 0;
+}
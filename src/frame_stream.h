@@ -0,0 +1,44 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_FRAME_STREAM_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_FRAME_STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "imaging.h"
+
+#define FRAME_STREAM_DEFAULT_FPS 24
+
+/**
+ * Supported Stream Formats, concatenated PPM P6 images or a YUV4MPEG2 stream of 4:2:0 frames
+ */
+typedef enum StreamFormat_t {
+	STREAM_FORMAT_PPM,
+	STREAM_FORMAT_Y4M
+} StreamFormat_t;
+
+/**
+ * FrameStream - A sequence of frames of one size written to a file, pipe or FIFO as each one is
+ * finished. Each frame is converted into buffer and written with a single write, then flushed so
+ * the reader gets it straight away.
+ */
+typedef struct FrameStream {
+	FILE *fp;
+	int isOwned;
+	StreamFormat_t format;
+	uint32_t width, height;
+	int fps;
+	uint8_t *buffer;
+	size_t bufferSize;
+	int framesLength;
+} FrameStream;
+
+int stream_format_parse(char *name, StreamFormat_t *formatRef);
+int frame_stream_open(FrameStream *streamRef, char *fname, StreamFormat_t format, int width, int height, int fps);
+int frame_stream_write(FrameStream *streamRef, Image *imageRef);
+int frame_stream_close(FrameStream *streamRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_FRAME_STREAM_H
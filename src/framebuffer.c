@@ -0,0 +1,237 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "framebuffer.h"
+
+/**
+ * Determine the pixel format named on the command line
+ * @param name - The name of the format, one of rgb, rgba or bgra
+ * @param formatRef - The format is written here
+ * @return 0 if success, otherwise the name is not a supported format
+ */
+int pixel_format_parse(char *name, PixelFormat_t *formatRef) {
+	if (strcmp(name, "rgb") == 0)
+		*formatRef = PIXEL_FORMAT_RGB8;
+	else if (strcmp(name, "rgba") == 0)
+		*formatRef = PIXEL_FORMAT_RGBA8;
+	else if (strcmp(name, "bgra") == 0)
+		*formatRef = PIXEL_FORMAT_BGRA8;
+	else {
+		fprintf(stderr, "Error: Unknown pixel format '%s', expected rgb, rgba or bgra\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Describes pixels owned by the caller as a frame buffer, nothing is allocated or copied
+ * @param frameBufferRef - The frame buffer to populate
+ * @param pixels - The first pixel of the first row
+ * @param width - The width of the buffer in pixels
+ * @param height - The height of the buffer in pixels
+ * @param stride - The number of bytes between the starts of two rows, 0 for rows without padding
+ * @param format - The format of the pixels
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_buffer_wrap(FrameBuffer *frameBufferRef, void *pixels, int width, int height, size_t stride, PixelFormat_t format) {
+	size_t rowSize = pixel_format_size(format) * width;
+
+	if (stride == 0)
+		stride = rowSize;
+	if (pixels == NULL || width <= 0 || height <= 0 || stride < rowSize) {
+		fprintf(stderr, "Error: A frame buffer of %ix%i needs rows of at least %zu bytes, %zu were given\n",
+				width, height, rowSize, stride);
+		return 1;
+	}
+
+	frameBufferRef->pixelsRef = pixels;
+	frameBufferRef->width = (uint32_t) width;
+	frameBufferRef->height = (uint32_t) height;
+	frameBufferRef->stride = stride;
+	frameBufferRef->format = format;
+	frameBufferRef->headerRef = NULL;
+	frameBufferRef->mappedSize = 0;
+	return 0;
+}
+
+/**
+ * Creates (or replaces the contents of) a POSIX shared memory segment holding a frame buffer
+ * header followed by the pixels, for another process to map with frame_buffer_open_shm
+ * @param frameBufferRef - The frame buffer to populate
+ * @param name - The name of the segment, like "/raycast"
+ * @param width - The width of the buffer in pixels
+ * @param height - The height of the buffer in pixels
+ * @param stride - The number of bytes between the starts of two rows, 0 for rows without padding
+ * @param format - The format of the pixels
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_buffer_create_shm(FrameBuffer *frameBufferRef, char *name, int width, int height, size_t stride, PixelFormat_t format) {
+	size_t rowSize = pixel_format_size(format) * width;
+	if (stride == 0)
+		stride = rowSize;
+	if (width <= 0 || height <= 0 || stride < rowSize) {
+		fprintf(stderr, "Error: A frame buffer of %ix%i needs rows of at least %zu bytes, %zu were given\n",
+				width, height, rowSize, stride);
+		return 1;
+	}
+
+	int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "Error: Shared memory segment '%s' could not be created\n", name);
+		return 1;
+	}
+
+	size_t mappedSize = FRAME_BUFFER_HEADER_SIZE + stride * height;
+	void *memory = MAP_FAILED;
+	if (ftruncate(fd, (off_t) mappedSize) == 0)
+		memory = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		fprintf(stderr, "Error: Shared memory segment '%s' could not be mapped\n", name);
+		return 1;
+	}
+
+	frame_buffer_wrap(frameBufferRef, (uint8_t *) memory + FRAME_BUFFER_HEADER_SIZE, width, height, stride, format);
+	frameBufferRef->headerRef = memory;
+	frameBufferRef->mappedSize = mappedSize;
+
+	FrameBufferHeader *headerRef = frameBufferRef->headerRef;
+	memcpy(headerRef->magic, FRAME_BUFFER_MAGIC, 4);
+	headerRef->version = FRAME_BUFFER_VERSION;
+	headerRef->width = (uint32_t) width;
+	headerRef->height = (uint32_t) height;
+	headerRef->stride = stride;
+	headerRef->format = (uint32_t) format;
+	atomic_store(&headerRef->frameNumber, 0);
+	return 0;
+}
+
+/**
+ * Maps a shared memory frame buffer made by another process for reading, check the header's
+ * frameNumber to see when a new frame has been published
+ * @param frameBufferRef - The frame buffer to populate
+ * @param name - The name of the segment
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_buffer_open_shm(FrameBuffer *frameBufferRef, char *name) {
+	struct stat info;
+
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) {
+		fprintf(stderr, "Error: Shared memory segment '%s' could not be opened\n", name);
+		return 1;
+	}
+
+	void *memory = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && (size_t) info.st_size >= FRAME_BUFFER_HEADER_SIZE)
+		memory = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		fprintf(stderr, "Error: Shared memory segment '%s' could not be mapped\n", name);
+		return 1;
+	}
+
+	FrameBufferHeader *headerRef = memory;
+	if (memcmp(headerRef->magic, FRAME_BUFFER_MAGIC, 4) != 0 || headerRef->version != FRAME_BUFFER_VERSION ||
+		headerRef->format > PIXEL_FORMAT_BGRA8 ||
+		FRAME_BUFFER_HEADER_SIZE + headerRef->stride * headerRef->height > (uint64_t) info.st_size ||
+		frame_buffer_wrap(frameBufferRef, (uint8_t *) memory + FRAME_BUFFER_HEADER_SIZE, (int) headerRef->width,
+						  (int) headerRef->height, headerRef->stride, (PixelFormat_t) headerRef->format) != 0) {
+		munmap(memory, (size_t) info.st_size);
+		fprintf(stderr, "Error: Shared memory segment '%s' does not hold a frame buffer\n", name);
+		return 1;
+	}
+
+	frameBufferRef->headerRef = headerRef;
+	frameBufferRef->mappedSize = (size_t) info.st_size;
+	return 0;
+}
+
+/**
+ * Marks the pixels of a shared memory frame buffer as a finished frame, the pixel writes are
+ * visible to a reader that sees the new frameNumber
+ * @param frameBufferRef - The frame buffer that was rendered into
+ */
+void frame_buffer_publish(FrameBuffer *frameBufferRef) {
+	if (frameBufferRef->headerRef != NULL)
+		atomic_fetch_add_explicit(&frameBufferRef->headerRef->frameNumber, 1, memory_order_release);
+}
+
+/**
+ * Unmaps a shared memory frame buffer, the segment itself stays until it is unlinked. A wrapped
+ * buffer is left to its owner.
+ * @param frameBufferRef - The frame buffer to close
+ */
+void frame_buffer_close(FrameBuffer *frameBufferRef) {
+	if (frameBufferRef->headerRef != NULL)
+		munmap(frameBufferRef->headerRef, frameBufferRef->mappedSize);
+	frameBufferRef->headerRef = NULL;
+	frameBufferRef->pixelsRef = NULL;
+	frameBufferRef->mappedSize = 0;
+}
+
+/**
+ * Removes a shared memory segment, processes that have it mapped keep their mapping
+ * @param name - The name of the segment
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_buffer_unlink_shm(char *name) {
+	if (shm_unlink(name) != 0) {
+		fprintf(stderr, "Error: Shared memory segment '%s' could not be removed\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Zeroes a band of rows of a frame buffer
+ * @param frameBufferRef - The frame buffer to clear
+ * @param y0 - The first row to clear
+ * @param y1 - The row past the last row to clear
+ */
+void frame_buffer_clear_rows(FrameBuffer *frameBufferRef, int y0, int y1) {
+	size_t rowSize = pixel_format_size(frameBufferRef->format) * frameBufferRef->width;
+
+	if (y1 > (int) frameBufferRef->height)
+		y1 = (int) frameBufferRef->height;
+	for (int y = y0; y < y1; y++)
+		memset(frameBufferRef->pixelsRef + (size_t) y * frameBufferRef->stride, 0, rowSize);
+}
+
+/**
+ * Allocates an image and copies the pixels of a frame buffer into it
+ * @param frameBufferRef - The frame buffer to copy
+ * @param imageRef - The image to populate
+ * @return 0 if success, otherwise a failure occurred
+ */
+int frame_buffer_to_image(FrameBuffer *frameBufferRef, Image *imageRef) {
+	size_t pixelSize = pixel_format_size(frameBufferRef->format);
+
+	imageRef->width = frameBufferRef->width;
+	imageRef->height = frameBufferRef->height;
+	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * frameBufferRef->width * frameBufferRef->height);
+	if (imageRef->pixmapRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate an image of size %ux%u\n", frameBufferRef->width, frameBufferRef->height);
+		return 1;
+	}
+
+	for (uint32_t y = 0; y < frameBufferRef->height; y++) {
+		uint8_t *source = frameBufferRef->pixelsRef + (size_t) y * frameBufferRef->stride;
+		for (uint32_t x = 0; x < frameBufferRef->width; x++, source += pixelSize) {
+			RGBApixel *pixelRef = &imageRef->pixmapRef[(size_t) y * frameBufferRef->width + x];
+			pixelRef->r = frameBufferRef->format == PIXEL_FORMAT_BGRA8 ? source[2] : source[0];
+			pixelRef->g = source[1];
+			pixelRef->b = frameBufferRef->format == PIXEL_FORMAT_BGRA8 ? source[0] : source[2];
+			pixelRef->a = frameBufferRef->format == PIXEL_FORMAT_RGB8 ? 255 : source[3];
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,104 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_FRAMEBUFFER_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_FRAMEBUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "imaging.h"
+
+#define FRAME_BUFFER_MAGIC "RCFB"
+#define FRAME_BUFFER_VERSION 1
+// Pixels of a shared memory segment start on the page after its header
+#define FRAME_BUFFER_HEADER_SIZE 4096
+
+/**
+ * Supported Pixel Formats, 8 bits per channel in the order named
+ */
+typedef enum PixelFormat_t {
+	PIXEL_FORMAT_RGB8,
+	PIXEL_FORMAT_RGBA8,
+	PIXEL_FORMAT_BGRA8
+} PixelFormat_t;
+
+/**
+ * FrameBufferHeader - The start of a shared memory frame buffer, describing its pixels to the
+ * processes that map it. frameNumber is incremented each time a finished frame is published.
+ */
+typedef struct FrameBufferHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t width, height;
+	uint64_t stride;
+	uint32_t format;
+	atomic_ullong frameNumber;
+} FrameBufferHeader;
+
+/**
+ * FrameBuffer - Pixels owned by the caller that raycast writes straight into, rows are stride
+ * bytes apart. The header is only set for a shared memory segment.
+ */
+typedef struct FrameBuffer {
+	uint8_t *pixelsRef;
+	uint32_t width, height;
+	size_t stride;
+	PixelFormat_t format;
+	FrameBufferHeader *headerRef;
+	size_t mappedSize;
+} FrameBuffer;
+
+/**
+ * Determine the size of one pixel of a format
+ * @param format - The pixel format
+ * @return The size of a pixel in bytes
+ */
+static inline size_t pixel_format_size(PixelFormat_t format) {
+	return format == PIXEL_FORMAT_RGB8 ? 3 : 4;
+}
+
+/**
+ * Writes one pixel into a frame buffer in its format
+ * @param frameBufferRef - The frame buffer to write to
+ * @param x - The column of the pixel
+ * @param y - The row of the pixel
+ * @param pixelRef - The pixel to write
+ */
+static inline void frame_buffer_store(FrameBuffer *frameBufferRef, int x, int y, RGBApixel *pixelRef) {
+	uint8_t *destination = frameBufferRef->pixelsRef + (size_t) y * frameBufferRef->stride +
+						   (size_t) x * pixel_format_size(frameBufferRef->format);
+
+	switch (frameBufferRef->format) {
+		case PIXEL_FORMAT_RGB8:
+			destination[0] = pixelRef->r;
+			destination[1] = pixelRef->g;
+			destination[2] = pixelRef->b;
+			break;
+		case PIXEL_FORMAT_RGBA8:
+			destination[0] = pixelRef->r;
+			destination[1] = pixelRef->g;
+			destination[2] = pixelRef->b;
+			destination[3] = pixelRef->a;
+			break;
+		case PIXEL_FORMAT_BGRA8:
+			destination[0] = pixelRef->b;
+			destination[1] = pixelRef->g;
+			destination[2] = pixelRef->r;
+			destination[3] = pixelRef->a;
+			break;
+	}
+}
+
+int pixel_format_parse(char *name, PixelFormat_t *formatRef);
+int frame_buffer_wrap(FrameBuffer *frameBufferRef, void *pixels, int width, int height, size_t stride, PixelFormat_t format);
+int frame_buffer_create_shm(FrameBuffer *frameBufferRef, char *name, int width, int height, size_t stride, PixelFormat_t format);
+int frame_buffer_open_shm(FrameBuffer *frameBufferRef, char *name);
+void frame_buffer_publish(FrameBuffer *frameBufferRef);
+void frame_buffer_close(FrameBuffer *frameBufferRef);
+int frame_buffer_unlink_shm(char *name);
+void frame_buffer_clear_rows(FrameBuffer *frameBufferRef, int y0, int y1);
+int frame_buffer_to_image(FrameBuffer *frameBufferRef, Image *imageRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_FRAMEBUFFER_H
@@ -0,0 +1,119 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "gbuffer.h"
+
+/**
+ * Allocates the samples of a G-buffer, every sample starts out as a miss
+ * @param gbufferRef - The G-buffer to allocate
+ * @param width - The width of the image the G-buffer belongs to
+ * @param height - The height of the image the G-buffer belongs to
+ * @param primitivesLength - The number of primitives in the scene the G-buffer was captured from
+ * @return 0 if success, otherwise a failure occurred
+ */
+int gbuffer_create(GBuffer *gbufferRef, int width, int height, int primitivesLength) {
+	gbufferRef->width = (uint32_t) width;
+	gbufferRef->height = (uint32_t) height;
+	gbufferRef->primitivesLength = (uint32_t) primitivesLength;
+	gbufferRef->samplesRef = calloc((size_t) width * height, sizeof(GBufferSample));
+
+	if (gbufferRef->samplesRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate a G-buffer of size %ix%i\n", width, height);
+		return 1;
+	}
+
+	for (size_t i = 0; i < (size_t) width * height; i++) {
+		gbufferRef->samplesRef[i].primitiveId = GBUFFER_NO_HIT;
+		gbufferRef->samplesRef[i].childId = GBUFFER_NO_HIT;
+	}
+
+	return 0;
+}
+
+/**
+ * Releases the samples held by a G-buffer
+ * @param gbufferRef - The G-buffer to free
+ */
+void gbuffer_free(GBuffer *gbufferRef) {
+	free(gbufferRef->samplesRef);
+	gbufferRef->samplesRef = NULL;
+}
+
+/**
+ * Write the specified G-buffer to a file in a raw binary format
+ * @param gbufferRef - The G-buffer to write
+ * @param fname - The output filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int save_gbuffer(GBuffer *gbufferRef, char *fname) {
+	FILE* fp = fopen(fname, "wb");
+	uint32_t header[4];
+
+	if (fp) {
+		header[0] = GBUFFER_VERSION;
+		header[1] = gbufferRef->width;
+		header[2] = gbufferRef->height;
+		header[3] = gbufferRef->primitivesLength;
+
+		size_t count = (size_t) gbufferRef->width * gbufferRef->height;
+		if (fwrite(GBUFFER_MAGIC, 1, 4, fp) != 4 ||
+			fwrite(header, sizeof(uint32_t), 4, fp) != 4 ||
+			fwrite(gbufferRef->samplesRef, sizeof(GBufferSample), count, fp) != count) {
+			fprintf(stderr, "Error: Could not write G-buffer to file '%s'\n", fname);
+			fclose(fp);
+			return 1;
+		}
+
+		fclose(fp);
+		return 0;
+	}
+	else {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+}
+
+/**
+ * Read a G-buffer previously written by save_gbuffer
+ * @param gbufferRef - The G-buffer to read into, its samples are allocated here
+ * @param fname - The input filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int load_gbuffer(GBuffer *gbufferRef, char *fname) {
+	FILE* fp = fopen(fname, "rb");
+	char magic[4];
+	uint32_t header[4];
+
+	if (fp) {
+		if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, GBUFFER_MAGIC, 4) != 0 ||
+			fread(header, sizeof(uint32_t), 4, fp) != 4 || header[0] != GBUFFER_VERSION) {
+			fprintf(stderr, "Error: File '%s' is not a supported G-buffer\n", fname);
+			fclose(fp);
+			return 1;
+		}
+
+		if (gbuffer_create(gbufferRef, header[1], header[2], header[3]) != 0) {
+			fclose(fp);
+			return 1;
+		}
+
+		size_t count = (size_t) gbufferRef->width * gbufferRef->height;
+		if (fread(gbufferRef->samplesRef, sizeof(GBufferSample), count, fp) != count) {
+			fprintf(stderr, "Error: G-buffer file '%s' is truncated\n", fname);
+			gbuffer_free(gbufferRef);
+			fclose(fp);
+			return 1;
+		}
+
+		fclose(fp);
+		return 0;
+	}
+	else {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+}
@@ -0,0 +1,43 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_GBUFFER_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_GBUFFER_H
+
+#include <stdint.h>
+#include "3dmath.h"
+
+#define GBUFFER_MAGIC "RCGB"
+#define GBUFFER_VERSION 3
+#define GBUFFER_NO_HIT -1
+
+/**
+ * GBufferSample - Everything shoot() needs to shade a primary hit without re-tracing it
+ */
+typedef struct GBufferSample {
+	V3 point;
+	V3 normal;
+	V3 view;
+	V3 diffuseColor;
+	V3 specularColor;
+	double reflectivity;
+	int32_t primitiveId;
+	int32_t childId;
+} GBufferSample;
+
+/**
+ * GBuffer - A per-pixel buffer of primary hit samples
+ */
+typedef struct GBuffer {
+	uint32_t width, height;
+	uint32_t primitivesLength;
+	GBufferSample *samplesRef;
+} GBuffer;
+
+int gbuffer_create(GBuffer *gbufferRef, int width, int height, int primitivesLength);
+void gbuffer_free(GBuffer *gbufferRef);
+int save_gbuffer(GBuffer *gbufferRef, char *fname);
+int load_gbuffer(GBuffer *gbufferRef, char *fname);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_GBUFFER_H
@@ -13,8 +13,8 @@
 void skip_whitespace(FILE *fh) {
 	int c;
 	do {
-		c = fgetc(fh);
+		c = fgetc_unlocked(fh);
 	}
 	while(isspace(c));
-	fseek(fh, -1, SEEK_CUR);
+	ungetc(c, fh);
 }
\ No newline at end of file
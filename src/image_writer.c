@@ -0,0 +1,197 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "image_writer.h"
+#include "raycaster.h"
+
+/**
+ * Writes one band of rows of the image at its offset in the file, converted to RGB
+ * @param writerRef - The writer
+ * @param band - The band to write
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int image_writer_write_band(ImageWriter *writerRef, int band) {
+	uint32_t y0 = (uint32_t) band * RENDER_TILE_SIZE;
+	uint32_t y1 = y0 + RENDER_TILE_SIZE < writerRef->height ? y0 + RENDER_TILE_SIZE : writerRef->height;
+	size_t pixelsLength = (size_t) (y1 - y0) * writerRef->width;
+	RGBApixel *pixels = &writerRef->imageRef->pixmapRef[(size_t) y0 * writerRef->width];
+	off_t offset = (off_t) writerRef->headerSize + (off_t) y0 * writerRef->width * 3;
+	size_t written = 0;
+
+	for (size_t i = 0; i < pixelsLength; i++) {
+		writerRef->buffer[3 * i] = pixels[i].r;
+		writerRef->buffer[3 * i + 1] = pixels[i].g;
+		writerRef->buffer[3 * i + 2] = pixels[i].b;
+	}
+
+	while (written < 3 * pixelsLength) {
+		ssize_t result = pwrite(writerRef->fd, writerRef->buffer + written, 3 * pixelsLength - written, offset + (off_t) written);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0) {
+			fprintf(stderr, "Error: Could not write rows %u to %u of '%s'\n", y0, y1, writerRef->fname);
+			return 1;
+		}
+		written += (size_t) result;
+	}
+	writerRef->bandsWritten[band] = 1;
+	return 0;
+}
+
+/**
+ * Thread body of a writer, writes bands as they are queued until the writer is closed
+ * @param writerRef - The ImageWriter to run
+ * @return NULL
+ */
+static void *image_writer_thread(void *writerRef) {
+	ImageWriter *imageWriterRef = writerRef;
+
+	pthread_mutex_lock(&imageWriterRef->mutex);
+	while (1) {
+		while (imageWriterRef->queueHead == imageWriterRef->queueTail && !imageWriterRef->isClosing)
+			pthread_cond_wait(&imageWriterRef->cond, &imageWriterRef->mutex);
+		if (imageWriterRef->queueHead == imageWriterRef->queueTail)
+			break;
+		int band = imageWriterRef->queue[imageWriterRef->queueHead++];
+
+		// The renderer keeps queueing while a band is written
+		pthread_mutex_unlock(&imageWriterRef->mutex);
+		int result = imageWriterRef->result == 0 ? image_writer_write_band(imageWriterRef, band) : 0;
+		pthread_mutex_lock(&imageWriterRef->mutex);
+		if (result != 0)
+			imageWriterRef->result = result;
+	}
+	pthread_mutex_unlock(&imageWriterRef->mutex);
+	return NULL;
+}
+
+/**
+ * Creates a PPM P6 file the size of an image, writes its header and starts the writer's thread.
+ * The file must be seekable, its bands are written out of order.
+ * @param writerRef - The writer to open
+ * @param fname - The output filename
+ * @param imageRef - The image that will be rendered, its pixels are read as bands are reported done
+ * @param width - The width of the image
+ * @param height - The height of the image
+ * @return 0 if success, otherwise a failure occurred
+ */
+int image_writer_open(ImageWriter *writerRef, char *fname, Image *imageRef, int width, int height) {
+	char header[64];
+
+	memset(writerRef, 0, sizeof(ImageWriter));
+	writerRef->fd = -1;
+	writerRef->thread = pthread_self();
+	pthread_mutex_init(&writerRef->mutex, NULL);
+	pthread_cond_init(&writerRef->cond, NULL);
+	writerRef->fname = fname;
+	writerRef->imageRef = imageRef;
+	writerRef->width = (uint32_t) width;
+	writerRef->height = (uint32_t) height;
+	writerRef->tilesX = (width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+	writerRef->bandsLength = (height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+	writerRef->headerSize = (size_t) snprintf(header, sizeof(header), "P6\n%i %i\n255\n", width, height);
+
+	writerRef->tilesLeft = malloc(sizeof(atomic_int) * writerRef->bandsLength);
+	writerRef->bandsWritten = calloc((size_t) writerRef->bandsLength, sizeof(uint8_t));
+	writerRef->queue = malloc(sizeof(int) * writerRef->bandsLength);
+	writerRef->buffer = malloc((size_t) 3 * width * RENDER_TILE_SIZE);
+	if (writerRef->tilesLeft == NULL || writerRef->bandsWritten == NULL || writerRef->queue == NULL || writerRef->buffer == NULL) {
+		fprintf(stderr, "Error: Could not allocate the image writer\n");
+		image_writer_close(writerRef);
+		return 1;
+	}
+	for (int i = 0; i < writerRef->bandsLength; i++)
+		atomic_init(&writerRef->tilesLeft[i], writerRef->tilesX);
+
+	writerRef->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (writerRef->fd < 0) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		image_writer_close(writerRef);
+		return 1;
+	}
+	if (lseek(writerRef->fd, 0, SEEK_CUR) < 0) {
+		fprintf(stderr, "Error: File '%s' is not seekable, its rows can not be written out of order\n", fname);
+		close(writerRef->fd);
+		writerRef->fd = -1;
+		image_writer_close(writerRef);
+		return 1;
+	}
+	if (write(writerRef->fd, header, writerRef->headerSize) != (ssize_t) writerRef->headerSize) {
+		fprintf(stderr, "Error: Could not write the header of '%s'\n", fname);
+		close(writerRef->fd);
+		writerRef->fd = -1;
+		image_writer_close(writerRef);
+		return 1;
+	}
+
+	// Without a thread every band is written when the writer is closed instead
+	if (pthread_create(&writerRef->thread, NULL, image_writer_thread, writerRef) != 0)
+		writerRef->thread = pthread_self();
+	return 0;
+}
+
+/**
+ * Reports a tile of the image finished, the last tile of a band queues the band to be written.
+ * Safe to call from any rendering thread.
+ * @param writerRef - The writer
+ * @param tileY - The row of tiles the finished tile is in
+ */
+void image_writer_tile_done(ImageWriter *writerRef, int tileY) {
+	if (atomic_fetch_sub(&writerRef->tilesLeft[tileY], 1) != 1)
+		return;
+
+	pthread_mutex_lock(&writerRef->mutex);
+	writerRef->queue[writerRef->queueTail++] = tileY;
+	pthread_cond_signal(&writerRef->cond);
+	pthread_mutex_unlock(&writerRef->mutex);
+}
+
+/**
+ * Waits for the queued bands to be written, writes every band that was never reported done from
+ * the image as it is now, then closes the file and releases the writer
+ * @param writerRef - The writer to close
+ * @return 0 if success, otherwise a failure occurred
+ */
+int image_writer_close(ImageWriter *writerRef) {
+	int result = 1;
+
+	if (!pthread_equal(writerRef->thread, pthread_self())) {
+		pthread_mutex_lock(&writerRef->mutex);
+		writerRef->isClosing = 1;
+		pthread_cond_signal(&writerRef->cond);
+		pthread_mutex_unlock(&writerRef->mutex);
+		pthread_join(writerRef->thread, NULL);
+	}
+	pthread_mutex_destroy(&writerRef->mutex);
+	pthread_cond_destroy(&writerRef->cond);
+
+	if (writerRef->fd >= 0) {
+		result = writerRef->result;
+		for (int i = 0; result == 0 && i < writerRef->bandsLength; i++) {
+			if (!writerRef->bandsWritten[i])
+				result = image_writer_write_band(writerRef, i);
+		}
+		if (close(writerRef->fd) != 0 && result == 0) {
+			fprintf(stderr, "Error: Could not finish writing '%s'\n", writerRef->fname);
+			result = 1;
+		}
+	}
+
+	free(writerRef->tilesLeft);
+	free(writerRef->bandsWritten);
+	free(writerRef->queue);
+	free(writerRef->buffer);
+	writerRef->tilesLeft = NULL;
+	writerRef->bandsWritten = NULL;
+	writerRef->queue = NULL;
+	writerRef->buffer = NULL;
+	writerRef->fd = -1;
+	return result;
+}
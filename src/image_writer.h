@@ -0,0 +1,42 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_IMAGE_WRITER_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_IMAGE_WRITER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "imaging.h"
+
+/**
+ * ImageWriter - Writes a PPM P6 image to a file from a thread of its own while the image renders.
+ * The image is split into bands of RENDER_TILE_SIZE rows, and once every tile of a band has been
+ * reported done the band is queued and the thread writes it at its final offset in the file. Bands
+ * never reported, for example after a cancelled render, are written when the writer is closed.
+ */
+typedef struct ImageWriter {
+	int fd;
+	char *fname;
+	Image *imageRef;
+	uint32_t width, height;
+	size_t headerSize;
+	int tilesX, bandsLength;
+	atomic_int *tilesLeft;
+	uint8_t *bandsWritten;
+	int *queue;
+	int queueHead, queueTail;
+	int isClosing;
+	int result;
+	uint8_t *buffer;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+} ImageWriter;
+
+int image_writer_open(ImageWriter *writerRef, char *fname, Image *imageRef, int width, int height);
+void image_writer_tile_done(ImageWriter *writerRef, int tileY);
+int image_writer_close(ImageWriter *writerRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_IMAGE_WRITER_H
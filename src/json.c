@@ -3,7 +3,14 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "constants.h"
 #include "json_parsers.h"
 #include "json_helpers.h"
 #include "json.h"
@@ -34,6 +41,234 @@ int read_json(char* fname, JSONValue *JSONRootRef) {
 	return 0;
 }
 
+/**
+ * Read a JSON file whose root is an array one value at a time, see read_JSONArray_values
+ * @param fname - The name of the json file to load
+ * @param callback - Called with each value of the root array in order, a non-zero return stops reading
+ * @param contextRef - Passed through to the callback
+ * @return 0 if success, otherwise a failure occurred
+ */
+int read_json_array_values(char* fname, JSONValueCallback callback, void *contextRef) {
+	FILE *fp = fopen(fname, "r");
+
+	// Attempt to open the input file for reading
+	if (fp) {
+		if (read_JSONArray_values(fp, callback, contextRef) != 0) {
+			// Something went wrong, close the file and return an error
+			fclose(fp);
+			return 1;
+		}
+		fclose(fp);
+	} else {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Map a JSON file whose root is an array into memory and split the array into about chunksTarget
+ * runs of whole values. Only the array's commas at the top level are cut at, strings and nested
+ * objects and arrays are skipped over, the values themselves are parsed later by
+ * read_json_array_chunk so chunks can be parsed on different threads.
+ * @param fname - The name of the json file to load
+ * @param chunksTarget - The number of chunks to aim for, fewer are made for small files
+ * @param chunksRef - The chunks to populate
+ * @return 0 if success, otherwise a failure occurred
+ */
+int map_json_array_chunks(char* fname, int chunksTarget, JSONArrayChunks *chunksRef) {
+	struct stat info;
+	int fd = open(fname, O_RDONLY);
+
+	if (fd == -1) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		fprintf(stderr, "Error: Unexpected EOF when parsing for a value in a JSON file\n");
+		close(fd);
+		return 1;
+	}
+
+	chunksRef->dataLength = (size_t) info.st_size;
+	chunksRef->data = mmap(NULL, chunksRef->dataLength, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (chunksRef->data == MAP_FAILED) {
+		fprintf(stderr, "Error: File '%s' could not be mapped for reading\n", fname);
+		return 1;
+	}
+	madvise(chunksRef->data, chunksRef->dataLength, MADV_SEQUENTIAL);
+
+	// Small files are not worth splitting, large files are split further so only a few chunks
+	// of the file are resident at once
+	if (chunksTarget > (int) (chunksRef->dataLength / JSON_MIN_CHUNK_SIZE) + 1)
+		chunksTarget = (int) (chunksRef->dataLength / JSON_MIN_CHUNK_SIZE) + 1;
+	if (chunksTarget < (int) (chunksRef->dataLength / JSON_MAX_CHUNK_SIZE) + 1)
+		chunksTarget = (int) (chunksRef->dataLength / JSON_MAX_CHUNK_SIZE) + 1;
+
+	size_t chunkSize = chunksRef->dataLength / chunksTarget;
+	chunksRef->starts = malloc(sizeof(size_t) * chunksTarget);
+	chunksRef->ends = malloc(sizeof(size_t) * chunksTarget);
+	chunksRef->chunksLength = 0;
+	if (chunksRef->starts == NULL || chunksRef->ends == NULL) {
+		fprintf(stderr, "Error: Could not allocate space for %i chunks of file '%s'\n", chunksTarget, fname);
+		unmap_json_array_chunks(chunksRef);
+		return 1;
+	}
+
+	char *data = chunksRef->data;
+	size_t length = chunksRef->dataLength;
+	size_t i = 0;
+	while (i < length && isspace((unsigned char) data[i]))
+		i++;
+	if (i == length || data[i] != '[') {
+		fprintf(stderr, "Error: Found unexpected symbol '%c' when parsing for a object in a JSON file\n", i == length ? ' ' : data[i]);
+		unmap_json_array_chunks(chunksRef);
+		return 1;
+	}
+
+	size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+	size_t dropped = 0;
+	size_t start = ++i;
+	int depth = 0;
+	char isString = FALSE;
+	for (; i < length; i++) {
+		char c = data[i];
+
+		// Scanned pages are dropped as we go, the chunks fault them back in when parsed
+		if (i - dropped >= JSON_MAX_CHUNK_SIZE) {
+			size_t pageEnd = i / pageSize * pageSize;
+			madvise(data + dropped, pageEnd - dropped, MADV_DONTNEED);
+			dropped = pageEnd;
+		}
+
+		if (isString) {
+			// Strings have no escapes, see parse_string
+			if (c == '"')
+				isString = FALSE;
+			continue;
+		}
+
+		if (c == '"') {
+			isString = TRUE;
+		}
+		else if (c == '{' || c == '[') {
+			depth++;
+		}
+		else if (c == '}' || c == ']') {
+			if (depth == 0)
+				break;
+			depth--;
+		}
+		else if (c == ',' && depth == 0 && i - start >= chunkSize && chunksRef->chunksLength < chunksTarget - 1) {
+			chunksRef->starts[chunksRef->chunksLength] = start;
+			chunksRef->ends[chunksRef->chunksLength] = i;
+			chunksRef->chunksLength++;
+			start = i + 1;
+		}
+	}
+
+	if (i == length || data[i] != ']') {
+		fprintf(stderr, "Error: Unexpected EOF when parsing for a value in a JSON file\n");
+		unmap_json_array_chunks(chunksRef);
+		return 1;
+	}
+
+	chunksRef->starts[chunksRef->chunksLength] = start;
+	chunksRef->ends[chunksRef->chunksLength] = i;
+	chunksRef->chunksLength++;
+
+	return 0;
+}
+
+/**
+ * Parse the values of one chunk of a mapped JSON array one value at a time, each value is passed
+ * to the callback and freed again before the next one is read. The chunk's pages of the file are
+ * released afterwards.
+ * @param chunksRef - The mapped array
+ * @param chunk - The index of the chunk to parse
+ * @param callback - Called with each value of the chunk in order, a non-zero return stops reading
+ * @param contextRef - Passed through to the callback
+ * @return 0 if success, otherwise a failure occurred
+ */
+int read_json_array_chunk(JSONArrayChunks *chunksRef, int chunk, JSONValueCallback callback, void *contextRef) {
+	size_t start = chunksRef->starts[chunk];
+	size_t end = chunksRef->ends[chunk];
+
+	if (start == end)
+		return 0;
+
+	FILE *fp = fmemopen(chunksRef->data + start, end - start, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: Could not open a chunk of the JSON file for reading\n");
+		return 1;
+	}
+
+	int result = read_JSONValue_sequence(fp, EOF, callback, contextRef);
+	fclose(fp);
+
+	// Only whole pages inside the chunk can be dropped, the neighbouring chunks share the rest
+	size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+	size_t pageStart = (start + pageSize - 1) / pageSize * pageSize;
+	size_t pageEnd = end / pageSize * pageSize;
+	if (pageEnd > pageStart)
+		madvise(chunksRef->data + pageStart, pageEnd - pageStart, MADV_DONTNEED);
+
+	return result;
+}
+
+/**
+ * Unmap a JSON file mapped by map_json_array_chunks
+ * @param chunksRef - The chunks to release
+ */
+void unmap_json_array_chunks(JSONArrayChunks *chunksRef) {
+	munmap(chunksRef->data, chunksRef->dataLength);
+	free(chunksRef->starts);
+	free(chunksRef->ends);
+	chunksRef->data = NULL;
+	chunksRef->starts = NULL;
+	chunksRef->ends = NULL;
+	chunksRef->chunksLength = 0;
+}
+
+/**
+ * Frees everything a JSONValue holds, the JSONValue struct itself is left to the caller
+ * @param JSONValueRef - The JSONValue to free the contents of
+ */
+void free_JSONValue(JSONValue *JSONValueRef) {
+	switch (JSONValueRef->type) {
+		case STRING_T:
+			free(JSONValueRef->data.dataString);
+			break;
+
+		case OBJECT_T:
+			for (int i = 0; i < JSONValueRef->data.dataObject->length; i++) {
+				free(JSONValueRef->data.dataObject->keys[i]);
+				free(JSONValueRef->data.dataObject->values[i]->key);
+				free_JSONValue(JSONValueRef->data.dataObject->values[i]->value);
+				free(JSONValueRef->data.dataObject->values[i]->value);
+				free(JSONValueRef->data.dataObject->values[i]);
+			}
+			free(JSONValueRef->data.dataObject->keys);
+			free(JSONValueRef->data.dataObject->values);
+			free(JSONValueRef->data.dataObject);
+			break;
+
+		case ARRAY_T:
+			for (int i = 0; i < JSONValueRef->data.dataArray->length; i++) {
+				free_JSONValue(JSONValueRef->data.dataArray->values[i]);
+				free(JSONValueRef->data.dataArray->values[i]);
+			}
+			free(JSONValueRef->data.dataArray->values);
+			free(JSONValueRef->data.dataArray);
+			break;
+
+		default:
+			break;
+	}
+}
+
 /**
  * Resolves a JSONObject's key to a JSONValue if it exists
  * @param key - The key to look for
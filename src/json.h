@@ -5,6 +5,8 @@
 #ifndef CS430_PROJECT_2_BASIC_RAYCASTER_JSON_H
 #define CS430_PROJECT_2_BASIC_RAYCASTER_JSON_H
 
+#include <stddef.h>
+
 typedef enum JSONValueType_t {
 	STRING_T,
 	NUMBER_T,
@@ -19,12 +21,13 @@ typedef struct JSONObject JSONObject;
 typedef struct JSONValue JSONValue;
 typedef struct JSONElement JSONElement;
 typedef struct JSONArray JSONArray;
+typedef int (*JSONValueCallback)(JSONValue *JSONValueRef, void *contextRef);
 
 typedef struct JSONValue {
 	JSONValueType_t type;
 	union {
 		char *dataString;
-		float dataNumber;
+		double dataNumber;
 		JSONObject *dataObject;
 		JSONArray *dataArray;
 	} data;
@@ -46,7 +49,24 @@ typedef struct JSONArray {
 	int length;
 } JSONArray;
 
+/**
+ * JSONArrayChunks - A JSON file mapped into memory with its top level array split into runs of
+ * whole values, chunk i holds the values between starts[i] and ends[i]
+ */
+typedef struct JSONArrayChunks {
+	char *data;
+	size_t dataLength;
+	size_t *starts;
+	size_t *ends;
+	int chunksLength;
+} JSONArrayChunks;
+
 int read_json(char* fname, JSONValue *JSONRootRef);
+int read_json_array_values(char* fname, JSONValueCallback callback, void *contextRef);
+void free_JSONValue(JSONValue *JSONValueRef);
+int map_json_array_chunks(char* fname, int chunksTarget, JSONArrayChunks *chunksRef);
+int read_json_array_chunk(JSONArrayChunks *chunksRef, int chunk, JSONValueCallback callback, void *contextRef);
+void unmap_json_array_chunks(JSONArrayChunks *chunksRef);
 int JSONObject_get_value(char* key, JSONObject* JSONObjectRef, JSONValue** JSONValueOutRef);
 int JSONArray_get_value(int index, JSONArray* JSONArrayRef, JSONValue** JSONValueOutRef);
 
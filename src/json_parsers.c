@@ -6,11 +6,14 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <stdint.h>
 #include "json_parsers.h"
 #include "json.h"
 #include "helpers.h"
 #include "json_helpers.h"
 
+// A file handle is only ever read by one thread, so the unlocked stdio calls are used
+
 
 /**
  * Read a JSONValue from a file handle.
@@ -24,9 +27,9 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 	// Skip whitespace
 	skip_whitespace(fp);
 	// Figure out the type that we're reading
-	c = getc(fp);
+	c = getc_unlocked(fp);
 
-	fseek(fp, -1, SEEK_CUR);
+	ungetc(c, fp);
 
 	if (c == '{') {
 		// An object
@@ -56,10 +59,8 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 		// An number
 		JSONValueRef->type = NUMBER_T;
 
-		// Read in the number directly
-		fscanf(fp, "%f", &JSONValueRef->data.dataNumber);
-
-		return 0;
+		// Parse the number
+		return parse_number(fp, &JSONValueRef->data.dataNumber);
 	}
 	else if (c == '"') {
 		// An string
@@ -78,14 +79,16 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 	}
 	else if (c == 't' || c == 'f' || c =='n') {
 		// Could be 'true', 'false', 'null', or nonsense
-		char string[6];
+		char string[6] = "";
 		fgets(string, 6, fp);
 
 		if (strncmp(string, "true", 4) == 0) {
 			// An true
 			JSONValueRef->type = TRUE_T;
 
-			fseek(fp, -1, SEEK_CUR);
+			// Put back the character read after the word
+			if (strlen(string) == 5)
+				ungetc(string[4], fp);
 
 			return 0;
 		}
@@ -99,7 +102,9 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 			// An null
 			JSONValueRef->type = NULL_T;
 
-			fseek(fp, -1, SEEK_CUR);
+			// Put back the character read after the word
+			if (strlen(string) == 5)
+				ungetc(string[4], fp);
 
 			return 0;
 		}
@@ -134,7 +139,7 @@ int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef) {
 
 	skip_whitespace(fp);
 
-	c = getc(fp);
+	c = getc_unlocked(fp);
 	if (c != '{') {
 		fprintf(stderr, "Error: Found unexpected symbol '%c' when parsing for a object in a JSON file\n", c);
 		return 1;
@@ -143,7 +148,7 @@ int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef) {
 	while (TRUE) {
 		// Read a key value pair until we reach a '}' character
 		skip_whitespace(fp);
-		c = getc(fp);
+		c = getc_unlocked(fp);
 
 		if (c == '}')
 			break;
@@ -156,7 +161,7 @@ int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef) {
 			return 1;
 		}
 
-		fseek(fp, -1, SEEK_CUR);
+		ungetc(c, fp);
 
 		// Make sure we have enough space for this element
 		if (length == size) {
@@ -179,14 +184,14 @@ int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef) {
 		skip_whitespace(fp);
 
 		// Expect there to be a comma if there are more elements
-		c = getc(fp);
+		c = getc_unlocked(fp);
 
 		if (c == EOF)
 			isElementExpected = FALSE;
 		else if (c == ',')
 			isElementExpected = TRUE;
 		else {
-			fseek(fp, -1, SEEK_CUR);
+			ungetc(c, fp);
 			isElementExpected = FALSE;
 		}
 	}
@@ -213,7 +218,7 @@ int read_JSONElement(FILE *fp, JSONElement *JSONElementRef) {
 	char *key = parse_string(fp);
 	skip_whitespace(fp);
 
-	c = getc(fp);
+	c = getc_unlocked(fp);
 	if (c == EOF) {
 		fprintf(stderr, "Error: Unexpected EOF when parsing for an element in an object in a JSON file\n");
 		return 1;
@@ -250,7 +255,7 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 
 	skip_whitespace(fp);
 
-	c = getc(fp);
+	c = getc_unlocked(fp);
 	if (c != '[') {
 		fprintf(stderr, "Error: Found unexpected symbol '%c' when parsing for a object in a JSON file\n", c);
 		return 1;
@@ -259,7 +264,7 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 	while (TRUE) {
 		// Read a key value pair until we reach a ']' character
 		skip_whitespace(fp);
-		c = getc(fp);
+		c = getc_unlocked(fp);
 
 		if (c == ']')
 			break;
@@ -272,7 +277,7 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 			return 1;
 		}
 
-		fseek(fp, -1, SEEK_CUR);
+		ungetc(c, fp);
 
 		// Make sure we have enough space for this value
 		if (length == size) {
@@ -292,14 +297,14 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 		skip_whitespace(fp);
 
 		// Expect there to be a comma if there are more elements
-		c = getc(fp);
+		c = getc_unlocked(fp);
 
 		if (c == EOF)
 			isValueExpected = FALSE;
 		else if (c == ',')
 			isValueExpected = TRUE;
 		else {
-			fseek(fp, -1, SEEK_CUR);
+			ungetc(c, fp);
 			isValueExpected = FALSE;
 		}
 	}
@@ -313,6 +318,89 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 	return 0;
 }
 
+/**
+ * Read a JSONArray from a file handle one value at a time, each value is passed to the callback
+ * and freed again before the next one is read so the whole array is never resident.
+ * @param fp - The file handle to read from
+ * @param callback - Called with each value of the array in order, a non-zero return stops reading
+ * @param contextRef - Passed through to the callback
+ * @return 0 if success, otherwise a failure occurred
+ */
+int read_JSONArray_values(FILE *fp, JSONValueCallback callback, void *contextRef) {
+	int c;
+
+	skip_whitespace(fp);
+
+	c = getc_unlocked(fp);
+	if (c != '[') {
+		fprintf(stderr, "Error: Found unexpected symbol '%c' when parsing for a object in a JSON file\n", c);
+		return 1;
+	}
+
+	return read_JSONValue_sequence(fp, ']', callback, contextRef);
+}
+
+/**
+ * Read comma separated values from a file handle one value at a time until a terminator, each
+ * value is passed to the callback and freed again before the next one is read.
+ * @param fp - The file handle to read from
+ * @param terminator - The character ending the sequence, ']' for the inside of an array or EOF
+ * for a run of values cut out of an array
+ * @param callback - Called with each value in order, a non-zero return stops reading
+ * @param contextRef - Passed through to the callback
+ * @return 0 if success, otherwise a failure occurred
+ */
+int read_JSONValue_sequence(FILE *fp, int terminator, JSONValueCallback callback, void *contextRef) {
+	int c;
+	char isValueExpected = TRUE;
+	JSONValue JSONValueTemp;
+
+	while (TRUE) {
+		// Read a value until we reach the terminator
+		skip_whitespace(fp);
+		c = getc_unlocked(fp);
+
+		if (c == terminator)
+			break;
+		if (c == EOF) {
+			fprintf(stderr, "Error: Unexpected EOF when parsing for a value in a JSON file\n");
+			return 1;
+		}
+		if (isValueExpected == FALSE) {
+			fprintf(stderr, "Error: Values in an array must be comma separated\n");
+			return 1;
+		}
+
+		ungetc(c, fp);
+
+		if (read_JSONValue(fp, &JSONValueTemp) != 0) {
+			return 1;
+		}
+
+		int result = callback(&JSONValueTemp, contextRef);
+		free_JSONValue(&JSONValueTemp);
+		if (result != 0) {
+			return 1;
+		}
+
+		skip_whitespace(fp);
+
+		// Expect there to be a comma if there are more elements
+		c = getc_unlocked(fp);
+
+		if (c == EOF)
+			isValueExpected = FALSE;
+		else if (c == ',')
+			isValueExpected = TRUE;
+		else {
+			ungetc(c, fp);
+			isValueExpected = FALSE;
+		}
+	}
+
+	return 0;
+}
+
 /**
  * Parses a simple JSON string from the file's current position,
  * this only supports simple ASCII characters.
@@ -325,7 +413,7 @@ char* parse_string(FILE *fh) {
 	char *buffer = malloc(sizeof(char) * size);
 
 	// Check for a beginning quote "
-	c = fgetc(fh);
+	c = fgetc_unlocked(fh);
 	if (c != '"') {
 		if (LOG_LEVEL > 0)
 			fprintf(stderr, "Error: Expected string\n");
@@ -336,11 +424,16 @@ char* parse_string(FILE *fh) {
 	int i = 0;
 	do {
 		// Reallocate space if we don't have enough for this letter + the null terminator
-		if (i + 2 > c) {
+		if (i + 2 > size) {
 			size *= 2;
 			buffer = realloc(buffer, size * sizeof(char));
 		}
-		c = fgetc(fh);
+		c = fgetc_unlocked(fh);
+		if (c == EOF) {
+			fprintf(stderr, "Error: Unexpected EOF when parsing for a string in a JSON file\n");
+			free(buffer);
+			return NULL;
+		}
 		buffer[i++] = c;
 	}
 	while (c != '"');
@@ -348,11 +441,110 @@ char* parse_string(FILE *fh) {
 	// Add a null termination to the string
 	buffer[--i] = '\0';
 
-	// Make a copy of the string only the size that we need
-	char* string = strdup(buffer);
-	// Free our working buffer
-	free(buffer);
+	// Shrink the working buffer to only the size that we need
+	return realloc(buffer, sizeof(char) * (i + 1));
+}
+
+// Every power of ten up to 1e22 is exact in a double
+static const double exactPowersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Keeps one character of a number being parsed and reads the next
+ * @param fh - The file handle to read from
+ * @param buffer - The characters of the number so far, room for JSON_MAX_NUMBER_LENGTH
+ * @param lengthRef - The number of characters in the buffer
+ * @param cRef - The character to keep, replaced by the next character of the file
+ * @return 0 if success, otherwise the number is too long
+ */
+static inline int number_append(FILE *fh, char *buffer, int *lengthRef, int *cRef) {
+	if (*lengthRef == JSON_MAX_NUMBER_LENGTH) {
+		fprintf(stderr, "Error: Number longer than %d characters in a JSON file\n", JSON_MAX_NUMBER_LENGTH);
+		return 1;
+	}
+	buffer[(*lengthRef)++] = (char) *cRef;
+	*cRef = fgetc_unlocked(fh);
+	return 0;
+}
 
-	// Return the newly built string
-	return string;
-}
\ No newline at end of file
+/**
+ * Parses a JSON number from the file's current position into a double. The common case of at most
+ * 19 significant digits that fit in 53 bits, scaled by at most 22 powers of ten, is converted with
+ * one exact multiply or divide, which rounds correctly. Any other number is handed to strtod, which
+ * also rounds correctly. The character after the number is left in the file.
+ * @param fh - The file handle to read from
+ * @param resultRef - The number is written here
+ * @return 0 if success, otherwise a failure occurred
+ */
+int parse_number(FILE *fh, double *resultRef) {
+	char buffer[JSON_MAX_NUMBER_LENGTH + 1];
+	int length = 0;
+	uint64_t significand = 0;
+	int significandLength = 0;
+	int digitsLength = 0;
+	int isLong = FALSE;
+	int exponent = 0;
+	int c = fgetc_unlocked(fh);
+
+	if (c == '-' && number_append(fh, buffer, &length, &c) != 0)
+		return 1;
+
+	// The significand's digits are accumulated until there are too many to be exact
+	for (int isFraction = FALSE; isdigit(c) || (c == '.' && !isFraction && digitsLength > 0);) {
+		if (c == '.')
+			isFraction = TRUE;
+		else if (significandLength < 19) {
+			significand = significand * 10 + (uint64_t) (c - '0');
+			significandLength += significand != 0;
+			exponent -= isFraction;
+			digitsLength++;
+		}
+		else {
+			isLong = TRUE;
+			digitsLength++;
+		}
+		if (number_append(fh, buffer, &length, &c) != 0)
+			return 1;
+	}
+	if (digitsLength == 0) {
+		fprintf(stderr, "Error: Expected digits when parsing for a number in a JSON file\n");
+		return 1;
+	}
+
+	if (c == 'e' || c == 'E') {
+		int exponentSign = 1;
+		int exponentValue = 0;
+		if (number_append(fh, buffer, &length, &c) != 0)
+			return 1;
+		if (c == '+' || c == '-') {
+			exponentSign = c == '-' ? -1 : 1;
+			if (number_append(fh, buffer, &length, &c) != 0)
+				return 1;
+		}
+		if (!isdigit(c)) {
+			fprintf(stderr, "Error: Expected digits in the exponent of a number in a JSON file\n");
+			return 1;
+		}
+		while (isdigit(c)) {
+			// Past this the number is zero or infinite anyway, strtod still reads every digit
+			if (exponentValue < 100000)
+				exponentValue = exponentValue * 10 + c - '0';
+			if (number_append(fh, buffer, &length, &c) != 0)
+				return 1;
+		}
+		exponent += exponentSign * exponentValue;
+	}
+	ungetc(c, fh);
+	buffer[length] = '\0';
+
+	if (!isLong && significand <= (UINT64_C(1) << 53) && exponent >= -22 && exponent <= 22) {
+		double value = (double) significand;
+		value = exponent < 0 ? value / exactPowersOfTen[-exponent] : value * exactPowersOfTen[exponent];
+		*resultRef = buffer[0] == '-' ? -value : value;
+	}
+	else
+		*resultRef = strtod(buffer, NULL);
+	return 0;
+}
@@ -9,11 +9,15 @@ typedef struct JSONObject JSONObject;
 typedef struct JSONValue JSONValue;
 typedef struct JSONElement JSONElement;
 typedef struct JSONArray JSONArray;
+typedef int (*JSONValueCallback)(JSONValue *JSONValueRef, void *contextRef);
 
 char* parse_string(FILE *fh);
+int parse_number(FILE *fh, double *resultRef);
 int read_JSONValue(FILE *fp, JSONValue *JSONValueRef);
 int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef);
 int read_JSONElement(FILE *fp, JSONElement *JSONElementRef);
 int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef);
+int read_JSONArray_values(FILE *fp, JSONValueCallback callback, void *contextRef);
+int read_JSONValue_sequence(FILE *fp, int terminator, JSONValueCallback callback, void *contextRef);
 
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_PARSERS_H
@@ -0,0 +1,194 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "light_tree.h"
+
+/**
+ * The power of a light, the mean of the magnitudes of its color channels
+ */
+static double light_power(Light *lightRef) {
+	V3 *colorRef = &lightRef->data.pointLight.color;
+	return (fabs(colorRef->data.X) + fabs(colorRef->data.Y) + fabs(colorRef->data.Z)) / 3;
+}
+
+/**
+ * Reorders a range of light indices so the one at mid has the median position along an axis, with
+ * no light before it further along the axis and none after it nearer
+ * @param sceneRef - The scene holding the lights
+ * @param order - The light indices to reorder
+ * @param start - The first index of the range
+ * @param end - The index past the end of the range
+ * @param mid - The position to place the median at
+ * @param axis - The axis to order along
+ */
+static void light_tree_select(Scene *sceneRef, int *order, int start, int end, int mid, int axis) {
+	while (end - start > 1) {
+		double pivot = sceneRef->lights[order[(start + end) / 2]].data.pointLight.position.array[axis];
+		int i = start, j = end - 1;
+		while (i <= j) {
+			while (sceneRef->lights[order[i]].data.pointLight.position.array[axis] < pivot)
+				i++;
+			while (sceneRef->lights[order[j]].data.pointLight.position.array[axis] > pivot)
+				j--;
+			if (i <= j) {
+				int swap = order[i];
+				order[i++] = order[j];
+				order[j--] = swap;
+			}
+		}
+		if (mid <= j)
+			end = j + 1;
+		else if (mid >= i)
+			start = i;
+		else
+			return;
+	}
+}
+
+/**
+ * Builds the subtree over a range of the light order
+ * @param treeRef - The tree being built, with room for every node
+ * @param sceneRef - The scene holding the lights
+ * @param start - The first index of the range
+ * @param end - The index past the end of the range
+ */
+static void light_tree_build_node(LightTree *treeRef, Scene *sceneRef, int start, int end) {
+	LightTreeNode *nodeRef = &treeRef->nodes[treeRef->nodesLength++];
+
+	nodeRef->power = 0;
+	for (int i = 0; i < 3; i++) {
+		nodeRef->min.array[i] = INFINITY;
+		nodeRef->max.array[i] = -INFINITY;
+	}
+	for (int i = start; i < end; i++) {
+		Light *lightRef = &sceneRef->lights[treeRef->order[i]];
+		for (int j = 0; j < 3; j++) {
+			nodeRef->min.array[j] = fmin(nodeRef->min.array[j], lightRef->data.pointLight.position.array[j]);
+			nodeRef->max.array[j] = fmax(nodeRef->max.array[j], lightRef->data.pointLight.position.array[j]);
+		}
+		nodeRef->power += light_power(lightRef);
+	}
+
+	if (end - start == 1) {
+		nodeRef->light = treeRef->order[start];
+		nodeRef->right = -1;
+		return;
+	}
+
+	int axis = 0;
+	for (int i = 1; i < 3; i++) {
+		if (nodeRef->max.array[i] - nodeRef->min.array[i] > nodeRef->max.array[axis] - nodeRef->min.array[axis])
+			axis = i;
+	}
+	int mid = (start + end) / 2;
+	light_tree_select(sceneRef, treeRef->order, start, end, mid, axis);
+
+	nodeRef->light = -1;
+	light_tree_build_node(treeRef, sceneRef, start, mid);
+	nodeRef->right = treeRef->nodesLength;
+	light_tree_build_node(treeRef, sceneRef, mid, end);
+}
+
+/**
+ * Builds a light tree over the lights of a scene, the tree's memory only grows so rebuilding it for
+ * later renders does not allocate
+ * @param treeRef - The tree to build, zeroed before its first use
+ * @param sceneRef - The scene holding the lights
+ * @return 0 if success, otherwise a failure occurred
+ */
+int light_tree_build(LightTree *treeRef, Scene *sceneRef) {
+	int nodesLength = sceneRef->lightsLength > 0 ? 2 * sceneRef->lightsLength - 1 : 0;
+
+	if (nodesLength > treeRef->nodesCapacity) {
+		free(treeRef->nodes);
+		treeRef->nodes = malloc(sizeof(LightTreeNode) * nodesLength);
+		treeRef->nodesCapacity = treeRef->nodes != NULL ? nodesLength : 0;
+	}
+	if (sceneRef->lightsLength > treeRef->orderCapacity) {
+		free(treeRef->order);
+		treeRef->order = malloc(sizeof(int) * sceneRef->lightsLength);
+		treeRef->orderCapacity = treeRef->order != NULL ? sceneRef->lightsLength : 0;
+	}
+	if (nodesLength > treeRef->nodesCapacity || sceneRef->lightsLength > treeRef->orderCapacity) {
+		fprintf(stderr, "Error: Could not allocate the light tree\n");
+		return 1;
+	}
+
+	treeRef->nodesLength = 0;
+	for (int i = 0; i < sceneRef->lightsLength; i++)
+		treeRef->order[i] = i;
+	if (sceneRef->lightsLength > 0)
+		light_tree_build_node(treeRef, sceneRef, 0, sceneRef->lightsLength);
+	return 0;
+}
+
+/**
+ * Releases the memory held by a light tree
+ * @param treeRef - The tree to free
+ */
+void light_tree_free(LightTree *treeRef) {
+	free(treeRef->nodes);
+	free(treeRef->order);
+	treeRef->nodes = NULL;
+	treeRef->order = NULL;
+	treeRef->nodesLength = 0;
+	treeRef->nodesCapacity = 0;
+	treeRef->orderCapacity = 0;
+}
+
+/**
+ * Estimate how much the lights of a node can add at a point, their power over the squared distance
+ * to the box, which is never taken as less than the box's own size
+ */
+static double light_tree_importance(LightTreeNode *nodeRef, V3 *pointRef) {
+	double distance = 0, size = 0;
+
+	for (int i = 0; i < 3; i++) {
+		double center = (nodeRef->min.array[i] + nodeRef->max.array[i]) / 2;
+		double half = (nodeRef->max.array[i] - nodeRef->min.array[i]) / 2;
+		distance += (pointRef->array[i] - center) * (pointRef->array[i] - center);
+		size += half * half;
+	}
+	return nodeRef->power / fmax(fmax(distance, size), LIGHT_TREE_MIN_DISTANCE * LIGHT_TREE_MIN_DISTANCE);
+}
+
+/**
+ * Picks one light for a point by walking down the tree, taking each child with a probability in
+ * proportion to its importance. Every light with any power can be picked, so dividing what the
+ * light adds by the probability of picking it gives an unbiased estimate of what all lights add.
+ * @param treeRef - The tree to pick from
+ * @param pointRef - The point being shaded
+ * @param stackRef - The ray stack of the calling thread, its random number generator is used
+ * @param probabilityRef - The probability of picking the returned light is written here
+ * @return The index of the picked light, or -1 if the scene has no light with any power
+ */
+int light_tree_sample(LightTree *treeRef, V3 *pointRef, RayStack *stackRef, double *probabilityRef) {
+	double probability = 1;
+	int node = 0;
+
+	if (treeRef->nodesLength == 0 || !(treeRef->nodes[0].power > 0))
+		return -1;
+
+	while (treeRef->nodes[node].light < 0) {
+		int left = node + 1, right = treeRef->nodes[node].right;
+		double leftImportance = light_tree_importance(&treeRef->nodes[left], pointRef);
+		double rightImportance = light_tree_importance(&treeRef->nodes[right], pointRef);
+		double total = leftImportance + rightImportance;
+		double leftProbability = total > 0 && isfinite(total) ? leftImportance / total : 0.5;
+
+		if (ray_stack_random(stackRef) < leftProbability) {
+			probability *= leftProbability;
+			node = left;
+		}
+		else {
+			probability *= 1 - leftProbability;
+			node = right;
+		}
+	}
+
+	*probabilityRef = probability;
+	return treeRef->nodes[node].light;
+}
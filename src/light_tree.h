@@ -0,0 +1,40 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_LIGHT_TREE_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_LIGHT_TREE_H
+
+#include "raycaster.h"
+
+// Distances below this are treated as this when weighing a light, so a light on a surface stays finite
+#define LIGHT_TREE_MIN_DISTANCE 1e-3
+
+/**
+ * LightTreeNode - A box around some of the lights of a scene and their total power. The left child
+ * of an inner node follows it, right is the index of the other child. A leaf holds one light.
+ */
+typedef struct LightTreeNode {
+	V3 min, max;
+	double power;
+	int right;
+	int light;
+} LightTreeNode;
+
+/**
+ * LightTree - A bounding hierarchy over the lights of a scene used to pick lights by their importance
+ * to a point, the lights are split at the median of the longest axis of each box
+ */
+typedef struct LightTree {
+	LightTreeNode *nodes;
+	int nodesLength;
+	int nodesCapacity;
+	int *order;
+	int orderCapacity;
+} LightTree;
+
+int light_tree_build(LightTree *treeRef, Scene *sceneRef);
+void light_tree_free(LightTree *treeRef);
+int light_tree_sample(LightTree *treeRef, V3 *pointRef, RayStack *stackRef, double *probabilityRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_LIGHT_TREE_H
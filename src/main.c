@@ -5,7 +5,24 @@
 #include "raycaster.h"
 #include "ppm.h"
 #include "raycaster_helpers.h"
+#include "gbuffer.h"
+#include "dirty.h"
+#include "cost.h"
+#include "render_job.h"
+#include "framebuffer.h"
+#include "frame_stream.h"
+#include "image_writer.h"
+#include "band_render.h"
+#include "mip.h"
+#include "tile_cache.h"
+#include "renderer.h"
 #include "constants.h"
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+// Progress messages go to stdout, or to stderr when stdout carries the output stream
+static FILE *logFile;
 
 /**
  * Determine if the input string is a number, this does not currently support
@@ -24,24 +41,173 @@ int isinteger(char *string) {
 	return TRUE;
 }
 
+/**
+ * Determine if an output file can be written while the image renders, its rows are written out of
+ * order so it must be a regular file, or not exist yet
+ * @param fname - The output filename
+ * @return 1 if it can, 0 if it can not
+ */
+int is_regular_output(char *fname) {
+	struct stat fileStat;
+	if (stat(fname, &fileStat) != 0)
+		return errno == ENOENT;
+	return S_ISREG(fileStat.st_mode);
+}
+
 /**
  * Show a simple help message about the usage of this program
  */
 void show_help() {
-	printf("Usage: raycast <render_width> <render_height> <input_scene> <output_file>\n");
+	printf("Usage: raycast <render_width> <render_height> <input_scene> <output_file> [options]\n");
 	printf("\t render_width: The width of the image to render\n");
 	printf("\t render_height: The height of the image to render\n");
 	printf("\t input_scene: The input scene file in a supported JSON format\n");
 	printf("\t output_file: The location to write the output PPM P6 image\n");
 	printf("\n");
+	printf("\t Options:\n");
+	printf("\t --gbuffer <file>: Also save the primary hits (G-buffer) of the render to file\n");
+	printf("\t --relight <file>: Skip primary rays and re-shade a saved G-buffer with the scene's lights\n");
+	printf("\t --max-depth <n>: Maximum number of reflections followed per pixel (default %d)\n", DEFAULT_MAX_DEPTH);
+	printf("\t --ray-budget <n>: Rays per pixel, reflections are only followed while shadow rays have not used it up (default %d)\n",
+		   DEFAULT_RAY_BUDGET);
+	printf("\t --light-samples <n>: Shade each hit with n lights picked by importance instead of every light (default: every light)\n");
+	printf("\t --area-samples <n>: Shadow rays traced to an area light from a point in its penumbra (default %d)\n", AREA_LIGHT_DEFAULT_SAMPLES);
+	printf("\t --wavefront: Shade each tile a stage at a time, queueing its hits and tracing shadow rays one light at a time\n");
+	printf("\t --heatmap <file>: Also save a false colour PPM P6 image of the work spent on each pixel\n");
+	printf("\t --cost <file>: Also save the raw per-pixel counters of intersection tests, shadow rays and lights shaded\n");
+	printf("\t --update <scene> <image>: Re-trace only the pixels of a previous render of scene that the input scene changes\n");
+	printf("\t --threads <n>: Number of threads to load and render the scene with (default: every core)\n");
+	printf("\t --deadline <ms>: Finish the render within ms milliseconds, rendering the last tiles at a lower resolution if needed\n");
+	printf("\t --shm <name>: Also render straight into the POSIX shared memory segment name for another process to read\n");
+	printf("\t --pixel-format <format>: Pixel format of the shared memory frame, rgb, rgba or bgra (default rgba)\n");
+	printf("\t --stream <format>: Write output_file as a stream of ppm or y4m frames, \"-\" writes to stdout\n");
+	printf("\t --frames <n>: Stream n frames, rendering frame i from input_scene with i in place of a %%d (e.g. frame_%%04d.json)\n");
+	printf("\t --fps <n>: Frame rate given in a y4m stream header (default %d)\n", FRAME_STREAM_DEFAULT_FPS);
+	printf("\t --mips <prefix>: Also save the image at 1/2, 1/4, ... of its size as prefix_1.ppm, prefix_2.ppm, ... and a\n"
+		   "\t\t thumbnail as prefix_thumb.ppm, all reduced from the tiles as they render\n");
+	printf("\t --mip-levels <n>: Number of halved levels saved by --mips (default %d, at most %d)\n", MIP_DEFAULT_LEVELS, MIP_MAX_LEVELS);
+	printf("\t --thumbnail <n>: Longest side of the --mips thumbnail, 0 for none (default %d)\n", MIP_DEFAULT_THUMBNAIL_SIZE);
+	printf("\t --band-rows <n>: Render out of core into a preallocated output_file n rows at a time, 0 picks n from the width,\n"
+		   "\t\t recording finished bands in output_file%s\n", BAND_CHECKPOINT_SUFFIX);
+	printf("\t --resume: Continue an out of core render that stopped, rendering only the bands its checkpoint lacks\n");
+	printf("\t --tile-cache <dir>: Copy tiles already rendered with the same scene and options from dir instead of tracing\n"
+		   "\t\t them, adding the tiles that are traced\n");
+	printf("\t --tile-cache-size <MiB>: Size the tile cache is trimmed to by removing the least recently used tiles (default %d)\n",
+		   TILE_CACHE_DEFAULT_MEGABYTES);
+	printf("\t --numa-report: Report the memory nodes rendered on and how many pixel writes stayed on the writer's node\n");
+	printf("\n");
 	printf("\t Example: raycast 1920 1080 scene.json out.ppm\n");
+	printf("\t Example: raycast 100000 100000 poster.json poster.ppm --band-rows 64 (then add --resume if it stops)\n");
+	printf("\t Example: raycast 1920 1080 frame_%%04d.json - --stream y4m --frames 240 | ffmpeg -i - out.mp4\n");
+}
+
+/**
+ * Raycast a scene, with a deadline the render runs as a job so the tiles left when time runs
+ * short are rendered at a lower resolution
+ * @param sceneRef - The input scene to render
+ * @param imageRef - The output image to write to
+ * @param optionsRef - The options to render with
+ * @param imageWidth - The width of the output image
+ * @param imageHeight - The height of the output image
+ * @param deadline - The milliseconds the render may take, 0 for no deadline
+ * @return 0 if success, otherwise a failure occurred
+ */
+int render(Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef, int imageWidth, int imageHeight, int deadline) {
+	if (deadline <= 0)
+		return raycast(sceneRef, imageRef, optionsRef, imageWidth, imageHeight);
+
+	RenderJob job;
+	if (render_job_start(&job, sceneRef, imageRef, optionsRef, imageWidth, imageHeight, deadline / 1000.0) != 0 ||
+		render_job_wait(&job) != 0)
+		return 1;
+	fprintf(logFile, "[INFO] Rendered %i of %i tiles at a reduced resolution to meet the %i ms deadline\n",
+		   atomic_load(&job.tilesReduced), atomic_load(&job.tilesLength), deadline);
+	return 0;
+}
+
+/**
+ * Determine if a scene file name is a pattern for the frames of a sequence, it may hold at most
+ * one integer conversion (%d or %i with an optional zero flag and width) and any number of %%
+ * @param pattern - The scene file name pattern
+ * @return 0 if success, otherwise the pattern is not supported
+ */
+int check_frame_pattern(char *pattern) {
+	int conversionsLength = 0;
+	for (char *c = pattern; *c != '\0'; c++) {
+		if (*c != '%')
+			continue;
+		if (*++c == '%')
+			continue;
+		while (isdigit(*c))
+			c++;
+		if ((*c != 'd' && *c != 'i') || ++conversionsLength > 1) {
+			fprintf(stderr, "Error: Scene pattern '%s' may only hold one %%d conversion\n", pattern);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Render a sequence of scenes into a stream, each frame is written as soon as it is finished so
+ * the reader encodes one frame while the next renders. Frame i is read from the scene pattern with
+ * i in place of its conversion, the threads and framebuffer of one renderer serve every frame.
+ * @param pattern - The scene file name pattern
+ * @param streamRef - The open stream to write the frames to
+ * @param optionsRef - The options to render with
+ * @param framesLength - The number of frames to render
+ * @param threadsLength - The number of threads to render with, 0 for every core
+ * @return 0 if success, otherwise a failure occurred
+ */
+int render_sequence(char *pattern, FrameStream *streamRef, RenderOptions *optionsRef, int framesLength,
+					int threadsLength) {
+	Renderer renderer;
+	char fname[4096];
+	int result = 0;
+
+	if (renderer_create(&renderer, threadsLength) != 0)
+		return 1;
+	for (int i = 0; i < framesLength && result == 0; i++) {
+		Scene *sceneRef;
+		if (snprintf(fname, sizeof(fname), pattern, i) >= (int) sizeof(fname)) {
+			fprintf(stderr, "Error: Scene file name for frame %i is too long\n", i);
+			result = 1;
+			break;
+		}
+		fprintf(logFile, "[INFO] Rendering frame %i from scene file '%s'\n", i, fname);
+		if (renderer_scene_create(&renderer, fname, &sceneRef) != 0) {
+			result = 1;
+			break;
+		}
+		result = renderer_render(&renderer, sceneRef, optionsRef, (int) streamRef->width, (int) streamRef->height);
+		if (result == 0)
+			result = frame_stream_write(streamRef, &renderer.image);
+		renderer_scene_destroy(sceneRef);
+	}
+	renderer_destroy(&renderer);
+	return result;
+}
+
+/**
+ * Close a tile cache, trimming it to its size, and report how many tiles it saved tracing
+ * @param cacheRef - The open tile cache
+ * @return 0 if success, otherwise a failure occurred
+ */
+int finish_tile_cache(TileCache *cacheRef) {
+	if (tile_cache_close(cacheRef) != 0)
+		return 1;
+	fprintf(logFile, "[INFO] Tile cache '%s': %i tiles reused, %i traced and %i stored, %i least recently used removed\n",
+			cacheRef->directory, atomic_load(&cacheRef->hits), atomic_load(&cacheRef->misses),
+			atomic_load(&cacheRef->stores), cacheRef->evictions);
+	return 0;
 }
 
 /**
  * The main enchilada, do all the things!
  */
 int main (int argc, char *argv[]) {
-	if (argc != 5) {
+	logFile = stdout;
+	if (argc < 5) {
         fprintf(stderr, "Error: Not enough arguments provided\n");
 		show_help();
 		return 1;
@@ -51,6 +217,127 @@ int main (int argc, char *argv[]) {
 	int imageHeight = atoi(argv[2]);
 	char *inputFname = argv[3];
 	char *outputFname = argv[4];
+	char *gbufferFname = NULL;
+	char *relightFname = NULL;
+	char *heatmapFname = NULL;
+	char *costFname = NULL;
+	CostBuffer cost;
+	char *updateSceneFname = NULL;
+	char *updateImageFname = NULL;
+	int threadsLength = 0;
+	int showNumaReport = FALSE;
+	int deadline = 0;
+	char *shmName = NULL;
+	PixelFormat_t pixelFormat = PIXEL_FORMAT_RGBA8;
+	FrameBuffer frameBuffer;
+	int isStream = FALSE;
+	StreamFormat_t streamFormat = STREAM_FORMAT_PPM;
+	FrameStream stream;
+	ImageWriter writer;
+	int framesLength = 0;
+	int fps = FRAME_STREAM_DEFAULT_FPS;
+	int isBanded = FALSE;
+	int bandRows = 0;
+	int isResume = FALSE;
+	char *mipPrefix = NULL;
+	int mipLevels = MIP_DEFAULT_LEVELS;
+	int thumbnailSize = MIP_DEFAULT_THUMBNAIL_SIZE;
+	MipPyramid mip;
+	char *tileCacheDir = NULL;
+	int tileCacheMegabytes = TILE_CACHE_DEFAULT_MEGABYTES;
+	TileCache tileCache;
+	RenderStats stats;
+	RenderOptions options;
+	render_options_init(&options);
+
+	for (int i = 5; i < argc; i++) {
+		if (strcmp(argv[i], "--gbuffer") == 0 && i + 1 < argc) {
+			gbufferFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--relight") == 0 && i + 1 < argc) {
+			relightFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+			heatmapFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--cost") == 0 && i + 1 < argc) {
+			costFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--update") == 0 && i + 2 < argc) {
+			updateSceneFname = argv[++i];
+			updateImageFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			options.maxDepth = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--ray-budget") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			options.rayBudget = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--light-samples") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			options.lightSamples = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--area-samples") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			options.areaLightSamples = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--wavefront") == 0) {
+			options.wavefront = TRUE;
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			threadsLength = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--deadline") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			deadline = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+			shmName = argv[++i];
+		}
+		else if (strcmp(argv[i], "--pixel-format") == 0 && i + 1 < argc) {
+			if (pixel_format_parse(argv[++i], &pixelFormat) != 0)
+				return 1;
+		}
+		else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+			if (stream_format_parse(argv[++i], &streamFormat) != 0)
+				return 1;
+			isStream = TRUE;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			framesLength = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			fps = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--mips") == 0 && i + 1 < argc) {
+			mipPrefix = argv[++i];
+		}
+		else if (strcmp(argv[i], "--mip-levels") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			mipLevels = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--thumbnail") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			thumbnailSize = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--band-rows") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			bandRows = atoi(argv[++i]);
+			isBanded = TRUE;
+		}
+		else if (strcmp(argv[i], "--resume") == 0) {
+			isResume = TRUE;
+			isBanded = TRUE;
+		}
+		else if (strcmp(argv[i], "--tile-cache") == 0 && i + 1 < argc) {
+			tileCacheDir = argv[++i];
+		}
+		else if (strcmp(argv[i], "--tile-cache-size") == 0 && i + 1 < argc && isinteger(argv[i + 1])) {
+			tileCacheMegabytes = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--numa-report") == 0) {
+			showNumaReport = TRUE;
+		}
+		else {
+			fprintf(stderr, "Error: Unknown option '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+	}
 
 	if (!isinteger(argv[1]) || imageHeight <= 0) {
         fprintf(stderr, "Error: Argument render_height must be an positive integer\n");
@@ -64,29 +351,271 @@ int main (int argc, char *argv[]) {
 		return 1;
 	}
 
-	// Read the input JSON file
-	JSONValue JSONRoot;
-	printf("[INFO] Reading input scene file '%s'\n", inputFname);
-	if (read_json(inputFname, &JSONRoot) != 0)
+	if (updateSceneFname != NULL && (relightFname != NULL || gbufferFname != NULL)) {
+		fprintf(stderr, "Error: --update can not be combined with --relight or --gbuffer\n");
 		return 1;
+	}
 
-	// Convert the JSON file to a scene
+	if (shmName != NULL && (relightFname != NULL || updateSceneFname != NULL)) {
+		fprintf(stderr, "Error: --shm can not be combined with --relight or --update\n");
+		return 1;
+	}
+
+	if (framesLength > 0 && (!isStream || gbufferFname != NULL || relightFname != NULL || updateSceneFname != NULL ||
+							 shmName != NULL || heatmapFname != NULL || costFname != NULL || deadline > 0 || showNumaReport)) {
+		fprintf(stderr, "Error: --frames needs --stream and can not be combined with --gbuffer, --relight, --update, "
+						"--shm, --heatmap, --cost, --deadline or --numa-report\n");
+		return 1;
+	}
+
+	if (isBanded && (gbufferFname != NULL || relightFname != NULL || updateSceneFname != NULL || shmName != NULL ||
+					 isStream || framesLength > 0 || heatmapFname != NULL || costFname != NULL || deadline > 0 || showNumaReport)) {
+		fprintf(stderr, "Error: --band-rows and --resume can not be combined with --gbuffer, --relight, --update, --shm, "
+						"--stream, --frames, --heatmap, --cost, --deadline or --numa-report\n");
+		return 1;
+	}
+
+	if (mipPrefix != NULL && (shmName != NULL || isStream || framesLength > 0 || isBanded)) {
+		fprintf(stderr, "Error: --mips can not be combined with --shm, --stream, --frames, --band-rows or --resume\n");
+		return 1;
+	}
+
+	if (mipPrefix != NULL && (mipLevels < 0 || mipLevels > MIP_MAX_LEVELS || thumbnailSize < 0)) {
+		fprintf(stderr, "Error: Option --mip-levels must be 0 to %d and --thumbnail 0 or more\n", MIP_MAX_LEVELS);
+		return 1;
+	}
+
+	if (isBanded && (bandRows < 0 || !is_regular_output(outputFname))) {
+		fprintf(stderr, "Error: An out of core render needs --band-rows of 0 or more and a regular output file\n");
+		return 1;
+	}
+
+	if (tileCacheDir != NULL && (gbufferFname != NULL || relightFname != NULL || updateSceneFname != NULL ||
+								 shmName != NULL || heatmapFname != NULL || costFname != NULL)) {
+		fprintf(stderr, "Error: --tile-cache can not be combined with --gbuffer, --relight, --update, --shm, --heatmap or --cost\n");
+		return 1;
+	}
+
+	if (tileCacheMegabytes <= 0) {
+		fprintf(stderr, "Error: Option --tile-cache-size must be a positive integer\n");
+		return 1;
+	}
+
+	if (fps <= 0) {
+		fprintf(stderr, "Error: Option --fps must be a positive integer\n");
+		return 1;
+	}
+
+	// Keep stdout clean for the frames when the stream is written to it
+	if (isStream && strcmp(outputFname, "-") == 0)
+		logFile = stderr;
+
+	options.threadsLength = threadsLength;
+	if (tileCacheDir != NULL) {
+		if (tile_cache_open(&tileCache, tileCacheDir, (size_t) tileCacheMegabytes * 1024 * 1024) != 0)
+			return 1;
+		options.tileCacheRef = &tileCache;
+	}
+
+	if (framesLength > 0) {
+		if (check_frame_pattern(inputFname) != 0 ||
+			frame_stream_open(&stream, outputFname, streamFormat, imageWidth, imageHeight, fps) != 0)
+			return 1;
+		fprintf(logFile, "[INFO] Streaming %i frames (%s) to '%s'\n", framesLength,
+				streamFormat == STREAM_FORMAT_Y4M ? "Y4M" : "PPM", outputFname);
+		int result = render_sequence(inputFname, &stream, &options, framesLength, threadsLength);
+		if (frame_stream_close(&stream) != 0 || result != 0)
+			return 1;
+		if (tileCacheDir != NULL && finish_tile_cache(&tileCache) != 0)
+			return 1;
+		fprintf(logFile, "[INFO] Finished!\n");
+		return 0;
+	}
+
+	if (heatmapFname != NULL || costFname != NULL)
+		options.costRef = &cost;
+	if (showNumaReport)
+		options.statsRef = &stats;
+
+	// Read the input JSON file into a scene
 	Scene scene;
-	printf("[INFO] Creating scene from input scene file\n");
-	if (create_scene_from_JSON(&JSONRoot, &scene) != 0)
+	fprintf(logFile, "[INFO] Creating scene from input scene file '%s'\n", inputFname);
+	if (create_scene_from_file(inputFname, &scene, threadsLength) != 0)
 		return 1;
 
-	// Raycast the scene into an image
+	if (isBanded) {
+		// Only one band is held in memory, finished bands survive the process in the output file
+		BandOutput bandOutput;
+		Renderer renderer;
+		if (band_output_open(&bandOutput, outputFname, &scene, &options, imageWidth, imageHeight, bandRows, isResume) != 0)
+			return 1;
+		fprintf(logFile, "[INFO] Rendering %i of %i bands of %i rows into output file '%s'\n",
+				bandOutput.bandsLength - bandOutput.bandsDone, bandOutput.bandsLength, bandOutput.bandRows, outputFname);
+		if (renderer_create(&renderer, threadsLength) != 0) {
+			band_output_close(&bandOutput);
+			return 1;
+		}
+		int result = band_output_render(&bandOutput, &renderer, &scene, &options);
+		renderer_destroy(&renderer);
+		if (band_output_close(&bandOutput) != 0 || result != 0)
+			return 1;
+		scene_free(&scene);
+		if (tileCacheDir != NULL && finish_tile_cache(&tileCache) != 0)
+			return 1;
+		fprintf(logFile, "[INFO] Finished!\n");
+		return 0;
+	}
+
+	// The pyramid is reduced from each tile as it finishes
+	if (mipPrefix != NULL) {
+		if (mip_pyramid_create(&mip, imageWidth, imageHeight, mipLevels, thumbnailSize) != 0)
+			return 1;
+		options.mipRef = &mip;
+	}
+
 	Image image;
-	printf("[INFO] Raycasting scene into image\n");
-	if (raycast(&scene, &image, imageWidth, imageHeight) != 0)
-		return 1;
+	GBuffer gbuffer;
+	if (relightFname != NULL) {
+		// Re-shade a previously captured G-buffer, no primary rays are traced
+		fprintf(logFile, "[INFO] Reading G-buffer file '%s'\n", relightFname);
+		if (load_gbuffer(&gbuffer, relightFname) != 0)
+			return 1;
+
+		if (gbuffer.width != (uint32_t) imageWidth || gbuffer.height != (uint32_t) imageHeight) {
+			fprintf(stderr, "Error: G-buffer is %ux%u but a %ix%i render was requested\n",
+					gbuffer.width, gbuffer.height, imageWidth, imageHeight);
+			return 1;
+		}
+
+		fprintf(logFile, "[INFO] Relighting G-buffer into image\n");
+		if (relight(&scene, &gbuffer, &options, &image) != 0)
+			return 1;
+	}
+	else if (updateSceneFname != NULL) {
+		// Re-trace only the pixels the edit between the two scenes may have changed
+		Scene previousScene;
+		DirtyRegion region;
+		fprintf(logFile, "[INFO] Creating previous scene from scene file '%s'\n", updateSceneFname);
+		if (create_scene_from_file(updateSceneFname, &previousScene, threadsLength) != 0)
+			return 1;
+
+		fprintf(logFile, "[INFO] Reading previous render '%s'\n", updateImageFname);
+		if (load_ppm_p6_image(&image, updateImageFname) != 0)
+			return 1;
+
+		if (dirty_region_create(&region, imageWidth, imageHeight) != 0 ||
+			dirty_region_from_scenes(&previousScene, &scene, &region) != 0)
+			return 1;
+		scene_free(&previousScene);
+
+		fprintf(logFile, "[INFO] Re-tracing %zu of %u pixels\n", region.pixelsLength, region.width * region.height);
+		options.regionRef = &region;
+		if (!isStream && is_regular_output(outputFname)) {
+			fprintf(logFile, "[INFO] Writing image (PPM P6) to output file '%s' as it renders\n", outputFname);
+			if (image_writer_open(&writer, outputFname, &image, imageWidth, imageHeight) != 0)
+				return 1;
+			options.writerRef = &writer;
+		}
+		if (render(&scene, &image, &options, imageWidth, imageHeight, deadline) != 0)
+			return 1;
+		dirty_region_free(&region);
+	}
+	else {
+		// Raycast the scene into an image
+		fprintf(logFile, "[INFO] Raycasting scene into image\n");
+		if (gbufferFname != NULL)
+			options.gbufferRef = &gbuffer;
+		if (shmName != NULL) {
+			if (frame_buffer_create_shm(&frameBuffer, shmName, imageWidth, imageHeight, 0, pixelFormat) != 0)
+				return 1;
+			options.frameBufferRef = &frameBuffer;
+		}
+		else if (!isStream && is_regular_output(outputFname)) {
+			// Bands of rows are written out while the rest of the image renders
+			fprintf(logFile, "[INFO] Writing image (PPM P6) to output file '%s' as it renders\n", outputFname);
+			if (image_writer_open(&writer, outputFname, &image, imageWidth, imageHeight) != 0)
+				return 1;
+			options.writerRef = &writer;
+		}
+		if (render(&scene, &image, &options, imageWidth, imageHeight, deadline) != 0)
+			return 1;
+
+		if (shmName != NULL) {
+			// The segment is left in place for the reader, the output file is written from it
+			frame_buffer_publish(&frameBuffer);
+			fprintf(logFile, "[INFO] Published frame to shared memory segment '%s'\n", shmName);
+			if (frame_buffer_to_image(&frameBuffer, &image) != 0)
+				return 1;
+			frame_buffer_close(&frameBuffer);
+		}
+
+		if (gbufferFname != NULL) {
+			fprintf(logFile, "[INFO] Saving G-buffer to file '%s'\n", gbufferFname);
+			if (save_gbuffer(&gbuffer, gbufferFname) != 0)
+				return 1;
+		}
+	}
+
+	if (showNumaReport && relightFname == NULL) {
+		fprintf(logFile, "[INFO] Rendered %i tiles on %i threads across %i memory nodes, %i tiles stolen across nodes\n",
+			   stats.tilesLength, stats.threadsLength, stats.nodesLength, stats.tilesStolen);
+		if (stats.sceneCopiesLength > 0)
+			fprintf(logFile, "[INFO] Scene replicated on each of %i nodes\n", stats.sceneCopiesLength);
+		else
+			fprintf(logFile, "[INFO] Scene shared by every node\n");
+		fprintf(logFile, "[INFO] Pixel writes: %zu KiB local, %zu KiB remote, %zu KiB on unknown nodes\n",
+			   stats.localBytes / 1024, stats.remoteBytes / 1024, stats.unknownBytes / 1024);
+	}
 
 	// Write the image out to the specified file
-	printf("[INFO] Saving image (PPM P6) to output file '%s'\n", outputFname);
-	if (save_ppm_p6_image(&image, outputFname) != 0)
+	if (isStream) {
+		fprintf(logFile, "[INFO] Streaming image (%s) to '%s'\n", streamFormat == STREAM_FORMAT_Y4M ? "Y4M" : "PPM", outputFname);
+		if (frame_stream_open(&stream, outputFname, streamFormat, imageWidth, imageHeight, fps) != 0 ||
+			frame_stream_write(&stream, &image) != 0 || frame_stream_close(&stream) != 0)
+			return 1;
+	}
+	else if (options.writerRef != NULL) {
+		fprintf(logFile, "[INFO] Finishing image (PPM P6) in output file '%s'\n", outputFname);
+		if (image_writer_close(&writer) != 0)
+			return 1;
+	}
+	else {
+		fprintf(logFile, "[INFO] Saving image (PPM P6) to output file '%s'\n", outputFname);
+		if (save_ppm_p6_image(&image, outputFname) != 0)
+			return 1;
+	}
+
+	if (mipPrefix != NULL) {
+		fprintf(logFile, "[INFO] Saving %i pyramid levels%s (PPM P6) to files '%s_*.ppm'\n", mipLevels,
+				thumbnailSize > 0 ? " and thumbnail" : "", mipPrefix);
+		if (mip_pyramid_finish(&mip, &image) != 0 || mip_pyramid_save(&mip, mipPrefix) != 0)
+			return 1;
+		mip_pyramid_free(&mip);
+	}
+
+	if (heatmapFname != NULL) {
+		Image heatmap;
+		fprintf(logFile, "[INFO] Saving cost heatmap (PPM P6) to file '%s'\n", heatmapFname);
+		if (cost_buffer_to_heatmap(&cost, &heatmap) != 0 || save_ppm_p6_image(&heatmap, heatmapFname) != 0)
+			return 1;
+		free(heatmap.pixmapRef);
+	}
+
+	if (costFname != NULL) {
+		fprintf(logFile, "[INFO] Saving cost counters to file '%s'\n", costFname);
+		if (save_cost_buffer(&cost, costFname) != 0)
+			return 1;
+	}
+
+	scene_free(&scene);
+	free(image.pixmapRef);
+	if (relightFname != NULL || gbufferFname != NULL)
+		gbuffer_free(&gbuffer);
+	if (options.costRef != NULL)
+		cost_buffer_free(&cost);
+	if (tileCacheDir != NULL && finish_tile_cache(&tileCache) != 0)
 		return 1;
 
-	printf("[INFO] Finished!\n");
+	fprintf(logFile, "[INFO] Finished!\n");
 	return 0;
 }
@@ -0,0 +1,613 @@
+//
+// Created on 10/18/2026.
+//
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <float.h>
+#include "constants.h"
+#include "mesh.h"
+
+/**
+ * A ray prepared for the watertight triangle test, the axes are permuted so that the ray
+ * travels along kz and the shear maps it onto the +Z axis
+ */
+typedef struct TriangleRay {
+	int kx, ky, kz;
+	double Sx, Sy, Sz;
+} TriangleRay;
+
+/**
+ * Grow a buffer to hold at least the required number of elements
+ * @param bufferRef - The buffer to grow, it is left as it was if it can not grow
+ * @param size - The current capacity in elements, updated when the buffer grows
+ * @param required - The number of elements needed
+ * @param elementSize - The size of one element
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int grow_buffer(void **bufferRef, size_t *size, size_t required, size_t elementSize) {
+	size_t newSize = *size;
+	if (required <= newSize)
+		return 0;
+
+	while (newSize < required)
+		newSize *= 2;
+
+	void *buffer = realloc(*bufferRef, newSize * elementSize);
+	if (buffer == NULL)
+		return 1;
+	*bufferRef = buffer;
+	*size = newSize;
+	return 0;
+}
+
+/**
+ * Read a Wavefront OBJ file into an indexed triangle mesh and build its hierarchy. The file
+ * is streamed a line at a time straight into packed vertex and index buffers, only vertex
+ * positions and faces are used, polygons are triangulated as fans.
+ * @param fname - The OBJ file to read
+ * @param meshRef - The mesh to populate
+ * @return 0 if success, otherwise a failure occurred
+ */
+int load_obj_mesh(char *fname, Mesh *meshRef) {
+	FILE *fp = fopen(fname, "r");
+	char *line = NULL;
+	size_t lineSize = 0;
+	size_t verticesSize = INITIAL_BUFFER_SIZE;
+	size_t indicesSize = INITIAL_BUFFER_SIZE;
+	size_t verticesLength = 0;
+	size_t indicesLength = 0;
+	size_t lineNumber = 0;
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+	setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+	float *vertices = malloc(sizeof(float) * 3 * verticesSize);
+	uint32_t *indices = malloc(sizeof(uint32_t) * 3 * indicesSize);
+	if (vertices == NULL || indices == NULL) {
+		fprintf(stderr, "Error: Could not allocate the buffers for OBJ file '%s'\n", fname);
+		goto fail;
+	}
+
+	while (getline(&line, &lineSize, fp) != -1) {
+		char *c = line;
+		lineNumber++;
+
+		while (*c == ' ' || *c == '\t')
+			c++;
+
+		if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t')) {
+			// A vertex position
+			if (grow_buffer((void **) &vertices, &verticesSize, verticesLength + 1, sizeof(float) * 3) != 0) {
+				fprintf(stderr, "Error: Could not allocate space for %zu vertices of OBJ file '%s'\n", verticesLength + 1, fname);
+				goto fail;
+			}
+
+			char *end;
+			c++;
+			for (int i = 0; i < 3; i++) {
+				vertices[verticesLength * 3 + i] = strtof(c, &end);
+				if (end == c) {
+					fprintf(stderr, "Error: Invalid vertex on line %zu of OBJ file '%s'\n", lineNumber, fname);
+					goto fail;
+				}
+				c = end;
+			}
+			verticesLength++;
+		}
+		else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t')) {
+			// A face, triangulated as a fan around its first vertex
+			long first = -1;
+			long previous = -1;
+			int corners = 0;
+			char *end;
+			c++;
+
+			while (TRUE) {
+				long index = strtol(c, &end, 10);
+				if (end == c)
+					break;
+				c = end;
+				// Skip any texture coordinate and normal indices
+				while (*c != '\0' && !isspace((unsigned char) *c))
+					c++;
+
+				// Negative indices count back from the last vertex read
+				index = index < 0 ? (long) verticesLength + index : index - 1;
+				if (index < 0 || index >= (long) verticesLength) {
+					fprintf(stderr, "Error: Invalid face index on line %zu of OBJ file '%s'\n", lineNumber, fname);
+					goto fail;
+				}
+
+				if (corners == 0) {
+					first = index;
+				}
+				else if (corners >= 2) {
+					if (grow_buffer((void **) &indices, &indicesSize, indicesLength + 1, sizeof(uint32_t) * 3) != 0) {
+						fprintf(stderr, "Error: Could not allocate space for %zu triangles of OBJ file '%s'\n", indicesLength + 1, fname);
+						goto fail;
+					}
+					indices[indicesLength * 3] = (uint32_t) first;
+					indices[indicesLength * 3 + 1] = (uint32_t) previous;
+					indices[indicesLength * 3 + 2] = (uint32_t) index;
+					indicesLength++;
+				}
+				previous = index;
+				corners++;
+			}
+
+			if (corners < 3) {
+				fprintf(stderr, "Error: Face with less than 3 vertices on line %zu of OBJ file '%s'\n", lineNumber, fname);
+				goto fail;
+			}
+		}
+		// Everything else (normals, texture coordinates, groups, materials, comments) is ignored
+	}
+
+	if (indicesLength == 0) {
+		fprintf(stderr, "Error: OBJ file '%s' contains no faces\n", fname);
+		goto fail;
+	}
+	if (verticesLength > UINT32_MAX || indicesLength > INT32_MAX) {
+		fprintf(stderr, "Error: OBJ file '%s' is too large\n", fname);
+		goto fail;
+	}
+
+	free(line);
+	fclose(fp);
+
+	// Give back the unused capacity, the buffers are kept as they are if they can not shrink
+	float *shrunkVertices = realloc(vertices, sizeof(float) * 3 * verticesLength);
+	uint32_t *shrunkIndices = realloc(indices, sizeof(uint32_t) * 3 * indicesLength);
+	meshRef->vertices = shrunkVertices != NULL ? shrunkVertices : vertices;
+	meshRef->indices = shrunkIndices != NULL ? shrunkIndices : indices;
+	meshRef->nodes = NULL;
+	meshRef->verticesLength = (uint32_t) verticesLength;
+	meshRef->trianglesLength = (uint32_t) indicesLength;
+	meshRef->nodesLength = 0;
+
+	if (mesh_build_hierarchy(meshRef) != 0) {
+		mesh_free(meshRef);
+		return 1;
+	}
+
+	return 0;
+
+fail:
+	free(vertices);
+	free(indices);
+	free(line);
+	fclose(fp);
+	return 1;
+}
+
+/**
+ * Surface area heuristic cost of a box, half the surface area is enough to compare boxes
+ */
+static float box_area(float *min, float *max) {
+	float x = max[0] - min[0];
+	float y = max[1] - min[1];
+	float z = max[2] - min[2];
+	return x * y + y * z + z * x;
+}
+
+static void box_reset(float *min, float *max) {
+	for (int i = 0; i < 3; i++) {
+		min[i] = FLT_MAX;
+		max[i] = -FLT_MAX;
+	}
+}
+
+static void box_grow(float *min, float *max, float *otherMin, float *otherMax) {
+	for (int i = 0; i < 3; i++) {
+		if (otherMin[i] < min[i])
+			min[i] = otherMin[i];
+		if (otherMax[i] > max[i])
+			max[i] = otherMax[i];
+	}
+}
+
+/**
+ * Build the bounding volume hierarchy of a mesh using binned surface area heuristic splits.
+ * The build works from an explicit stack of nodes to split and reorders the triangles so
+ * that every leaf covers a contiguous range of them. If it fails the mesh is left without nodes.
+ * @param meshRef - The mesh to build the hierarchy of
+ * @return 0 if success, otherwise a failure occurred
+ */
+int mesh_build_hierarchy(Mesh *meshRef) {
+	uint32_t trianglesLength = meshRef->trianglesLength;
+	float *bounds = malloc(sizeof(float) * 6 * trianglesLength);
+	float *centroids = malloc(sizeof(float) * 3 * trianglesLength);
+	uint32_t *order = malloc(sizeof(uint32_t) * trianglesLength);
+	uint32_t *stack = malloc(sizeof(uint32_t) * trianglesLength * 2);
+	uint32_t *indices = malloc(sizeof(uint32_t) * 3 * trianglesLength);
+	MeshNode *nodes = malloc(sizeof(MeshNode) * (trianglesLength * 2 - 1));
+	int stackLength = 0;
+
+	if (bounds == NULL || centroids == NULL || order == NULL || stack == NULL || indices == NULL || nodes == NULL) {
+		fprintf(stderr, "Error: Could not allocate the hierarchy of a mesh of %u triangles\n", trianglesLength);
+		free(bounds);
+		free(centroids);
+		free(order);
+		free(stack);
+		free(indices);
+		free(nodes);
+		return 1;
+	}
+
+	// Precalculate the bounds and centroid of every triangle
+	for (uint32_t i = 0; i < trianglesLength; i++) {
+		float *min = &bounds[i * 6];
+		float *max = &bounds[i * 6 + 3];
+		box_reset(min, max);
+		for (int j = 0; j < 3; j++) {
+			float *vertex = &meshRef->vertices[meshRef->indices[i * 3 + j] * 3];
+			box_grow(min, max, vertex, vertex);
+		}
+		for (int j = 0; j < 3; j++)
+			centroids[i * 3 + j] = (min[j] + max[j]) * 0.5f;
+		order[i] = i;
+	}
+
+	meshRef->nodes = nodes;
+	meshRef->nodes[0].first = 0;
+	meshRef->nodes[0].count = trianglesLength;
+	meshRef->nodesLength = 1;
+	stack[stackLength++] = 0;
+
+	while (stackLength > 0) {
+		MeshNode *nodeRef = &meshRef->nodes[stack[--stackLength]];
+		uint32_t first = nodeRef->first;
+		uint32_t count = nodeRef->count;
+		float centroidMin[3];
+		float centroidMax[3];
+
+		box_reset(nodeRef->min, nodeRef->max);
+		box_reset(centroidMin, centroidMax);
+		for (uint32_t i = first; i < first + count; i++) {
+			box_grow(nodeRef->min, nodeRef->max, &bounds[order[i] * 6], &bounds[order[i] * 6 + 3]);
+			box_grow(centroidMin, centroidMax, &centroids[order[i] * 3], &centroids[order[i] * 3]);
+		}
+
+		if (count <= MESH_LEAF_SIZE)
+			continue;
+
+		// Split along the axis the centroids are spread the most on
+		int axis = 0;
+		for (int i = 1; i < 3; i++) {
+			if (centroidMax[i] - centroidMin[i] > centroidMax[axis] - centroidMin[axis])
+				axis = i;
+		}
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0)
+			continue;
+
+		// Sort the triangles into bins and find the cheapest split between bins
+		uint32_t binCounts[MESH_SAH_BINS] = {0};
+		float binMin[MESH_SAH_BINS][3];
+		float binMax[MESH_SAH_BINS][3];
+		for (int i = 0; i < MESH_SAH_BINS; i++)
+			box_reset(binMin[i], binMax[i]);
+
+		float binScale = MESH_SAH_BINS / extent;
+		for (uint32_t i = first; i < first + count; i++) {
+			int bin = (int) ((centroids[order[i] * 3 + axis] - centroidMin[axis]) * binScale);
+			if (bin >= MESH_SAH_BINS)
+				bin = MESH_SAH_BINS - 1;
+			binCounts[bin]++;
+			box_grow(binMin[bin], binMax[bin], &bounds[order[i] * 6], &bounds[order[i] * 6 + 3]);
+		}
+
+		float leftCost[MESH_SAH_BINS];
+		float sweepMin[3];
+		float sweepMax[3];
+		uint32_t sweepCount = 0;
+		box_reset(sweepMin, sweepMax);
+		for (int i = 0; i < MESH_SAH_BINS - 1; i++) {
+			sweepCount += binCounts[i];
+			box_grow(sweepMin, sweepMax, binMin[i], binMax[i]);
+			leftCost[i] = sweepCount ? sweepCount * box_area(sweepMin, sweepMax) : 0;
+		}
+
+		int bestSplit = -1;
+		float bestCost = count * box_area(nodeRef->min, nodeRef->max);
+		sweepCount = 0;
+		box_reset(sweepMin, sweepMax);
+		for (int i = MESH_SAH_BINS - 1; i > 0; i--) {
+			sweepCount += binCounts[i];
+			box_grow(sweepMin, sweepMax, binMin[i], binMax[i]);
+			float cost = leftCost[i - 1] + (sweepCount ? sweepCount * box_area(sweepMin, sweepMax) : 0);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		uint32_t middle;
+		if (bestSplit == -1) {
+			// Splitting doesn't pay off, but keep leaves small so traversal stays logarithmic
+			if (count <= MESH_LEAF_SIZE * 4)
+				continue;
+			middle = first + count / 2;
+		}
+		else {
+			// Partition the triangles on the chosen bin boundary
+			uint32_t i = first;
+			uint32_t j = first + count;
+			while (i < j) {
+				int bin = (int) ((centroids[order[i] * 3 + axis] - centroidMin[axis]) * binScale);
+				if (bin >= MESH_SAH_BINS)
+					bin = MESH_SAH_BINS - 1;
+				if (bin < bestSplit) {
+					i++;
+				}
+				else {
+					uint32_t temp = order[i];
+					order[i] = order[--j];
+					order[j] = temp;
+				}
+			}
+			middle = i;
+			if (middle == first || middle == first + count)
+				middle = first + count / 2;
+		}
+
+		uint32_t left = meshRef->nodesLength;
+		meshRef->nodes[left].first = first;
+		meshRef->nodes[left].count = middle - first;
+		meshRef->nodes[left + 1].first = middle;
+		meshRef->nodes[left + 1].count = first + count - middle;
+		meshRef->nodesLength += 2;
+
+		nodeRef->first = left;
+		nodeRef->count = 0;
+
+		stack[stackLength++] = left;
+		stack[stackLength++] = left + 1;
+	}
+
+	// Reorder the index buffer to match the leaves
+	for (uint32_t i = 0; i < trianglesLength; i++)
+		memcpy(&indices[i * 3], &meshRef->indices[order[i] * 3], sizeof(uint32_t) * 3);
+	free(meshRef->indices);
+	meshRef->indices = indices;
+
+	// Give back the unused nodes, they are kept as they are if they can not shrink
+	nodes = realloc(meshRef->nodes, sizeof(MeshNode) * meshRef->nodesLength);
+	if (nodes != NULL)
+		meshRef->nodes = nodes;
+
+	free(bounds);
+	free(centroids);
+	free(order);
+	free(stack);
+	return 0;
+}
+
+/**
+ * Releases the buffers held by a mesh
+ * @param meshRef - The mesh to free
+ */
+void mesh_free(Mesh *meshRef) {
+	free(meshRef->vertices);
+	free(meshRef->indices);
+	free(meshRef->nodes);
+	meshRef->vertices = NULL;
+	meshRef->indices = NULL;
+	meshRef->nodes = NULL;
+}
+
+/**
+ * Ray versus box slab test
+ * @return The distance the ray enters the box at, or INFINITY if it misses or enters after maxT
+ */
+static inline double intersect_node(MeshNode *nodeRef, V3 *rayOriginRef, V3 *inverseDirection, double maxT) {
+	double tNear = 0;
+	double tFar = maxT;
+
+	for (int i = 0; i < 3; i++) {
+		double t0 = (nodeRef->min[i] - rayOriginRef->array[i]) * inverseDirection->array[i];
+		double t1 = (nodeRef->max[i] - rayOriginRef->array[i]) * inverseDirection->array[i];
+		if (t0 > t1) {
+			double temp = t0;
+			t0 = t1;
+			t1 = temp;
+		}
+		// Written so that NaN (a zero direction component on a box face) keeps the old bound
+		tNear = t0 > tNear ? t0 : tNear;
+		tFar = t1 < tFar ? t1 : tFar;
+		if (tNear > tFar)
+			return INFINITY;
+	}
+
+	return tNear;
+}
+
+static inline void prepare_triangle_ray(V3 *rayDirectionRef, TriangleRay *rayRef) {
+	double *d = rayDirectionRef->array;
+
+	rayRef->kz = 0;
+	if (fabs(d[1]) > fabs(d[rayRef->kz]))
+		rayRef->kz = 1;
+	if (fabs(d[2]) > fabs(d[rayRef->kz]))
+		rayRef->kz = 2;
+	rayRef->kx = (rayRef->kz + 1) % 3;
+	rayRef->ky = (rayRef->kx + 1) % 3;
+
+	// Keep the winding consistent when the ray travels along -kz
+	if (d[rayRef->kz] < 0) {
+		int temp = rayRef->kx;
+		rayRef->kx = rayRef->ky;
+		rayRef->ky = temp;
+	}
+
+	rayRef->Sx = d[rayRef->kx] / d[rayRef->kz];
+	rayRef->Sy = d[rayRef->ky] / d[rayRef->kz];
+	rayRef->Sz = 1.0 / d[rayRef->kz];
+}
+
+/**
+ * Watertight ray triangle test (Woop, Benthin and Wald), rays through shared edges and
+ * vertices hit exactly one of the triangles sharing them so meshes show no cracks
+ */
+static inline double intersect_triangle_prepared(float *a, float *b, float *c, V3 *rayOriginRef, TriangleRay *rayRef) {
+	double *o = rayOriginRef->array;
+	int kx = rayRef->kx;
+	int ky = rayRef->ky;
+	int kz = rayRef->kz;
+
+	double Az = a[kz] - o[kz];
+	double Bz = b[kz] - o[kz];
+	double Cz = c[kz] - o[kz];
+	double Ax = a[kx] - o[kx] - rayRef->Sx * Az;
+	double Ay = a[ky] - o[ky] - rayRef->Sy * Az;
+	double Bx = b[kx] - o[kx] - rayRef->Sx * Bz;
+	double By = b[ky] - o[ky] - rayRef->Sy * Bz;
+	double Cx = c[kx] - o[kx] - rayRef->Sx * Cz;
+	double Cy = c[ky] - o[ky] - rayRef->Sy * Cz;
+
+	double U = Cx * By - Cy * Bx;
+	double V = Ax * Cy - Ay * Cx;
+	double W = Bx * Ay - By * Ax;
+
+	if ((U < 0 || V < 0 || W < 0) && (U > 0 || V > 0 || W > 0))
+		return INFINITY;
+
+	double det = U + V + W;
+	if (det == 0)
+		return INFINITY;
+
+	double T = U * Az * rayRef->Sz + V * Bz * rayRef->Sz + W * Cz * rayRef->Sz;
+	double t = T / det;
+	if (t <= 0)
+		return INFINITY;
+
+	return t;
+}
+
+/**
+ * Triangle intersection test
+ * @param a - The first vertex
+ * @param b - The second vertex
+ * @param c - The third vertex
+ * @param rayOriginRef - The ray origin
+ * @param rayDirectionRef - The ray direction
+ * @return The hit distance between the rayOrigin and the triangle along the rayDirection, if positive. Otherwise INFINITY.
+ */
+double intersect_triangle(V3 *a, V3 *b, V3 *c, V3 *rayOriginRef, V3 *rayDirectionRef) {
+	float fa[3], fb[3], fc[3];
+	TriangleRay ray;
+
+	for (int i = 0; i < 3; i++) {
+		fa[i] = (float) a->array[i];
+		fb[i] = (float) b->array[i];
+		fc[i] = (float) c->array[i];
+	}
+
+	prepare_triangle_ray(rayDirectionRef, &ray);
+	return intersect_triangle_prepared(fa, fb, fc, rayOriginRef, &ray);
+}
+
+/**
+ * Mesh intersection test, walks the hierarchy nearest child first
+ * @param meshRef - The mesh to check
+ * @param rayOriginRef - The ray origin
+ * @param rayDirectionRef - The ray direction
+ * @param ignoreTriangle - A triangle to skip, usually the one the ray starts on, or -1
+ * @param triangleRef - The triangle hit is written here
+ * @param testsRef - The number of node and triangle intersection tests made is added to this counter
+ * @return The hit distance between the rayOrigin and the mesh along the rayDirection, if positive. Otherwise INFINITY.
+ */
+double intersect_mesh(Mesh *meshRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreTriangle, int *triangleRef, uint32_t *testsRef) {
+	uint32_t stack[MESH_TRAVERSAL_STACK_SIZE];
+	uint32_t tests = 1;
+	int stackLength = 0;
+	double closest_t = INFINITY;
+	V3 inverseDirection;
+	TriangleRay ray;
+
+	for (int i = 0; i < 3; i++)
+		inverseDirection.array[i] = 1.0 / rayDirectionRef->array[i];
+	prepare_triangle_ray(rayDirectionRef, &ray);
+
+	if (intersect_node(&meshRef->nodes[0], rayOriginRef, &inverseDirection, closest_t) == INFINITY) {
+		*testsRef += tests;
+		return INFINITY;
+	}
+	stack[stackLength++] = 0;
+
+	while (stackLength > 0) {
+		MeshNode *nodeRef = &meshRef->nodes[stack[--stackLength]];
+
+		if (nodeRef->count > 0) {
+			tests += nodeRef->count;
+			for (uint32_t i = nodeRef->first; i < nodeRef->first + nodeRef->count; i++) {
+				if ((int) i == ignoreTriangle)
+					continue;
+
+				uint32_t *triangle = &meshRef->indices[i * 3];
+				double t = intersect_triangle_prepared(&meshRef->vertices[triangle[0] * 3],
+													   &meshRef->vertices[triangle[1] * 3],
+													   &meshRef->vertices[triangle[2] * 3],
+													   rayOriginRef, &ray);
+				if (t < closest_t) {
+					closest_t = t;
+					*triangleRef = (int) i;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so farther subtrees are culled by the closest hit
+		tests += 2;
+		double tLeft = intersect_node(&meshRef->nodes[nodeRef->first], rayOriginRef, &inverseDirection, closest_t);
+		double tRight = intersect_node(&meshRef->nodes[nodeRef->first + 1], rayOriginRef, &inverseDirection, closest_t);
+		uint32_t near = nodeRef->first;
+		uint32_t far = nodeRef->first + 1;
+		if (tRight < tLeft) {
+			double temp = tLeft;
+			tLeft = tRight;
+			tRight = temp;
+			near = nodeRef->first + 1;
+			far = nodeRef->first;
+		}
+
+		if (tRight != INFINITY && stackLength < MESH_TRAVERSAL_STACK_SIZE)
+			stack[stackLength++] = far;
+		if (tLeft != INFINITY && stackLength < MESH_TRAVERSAL_STACK_SIZE)
+			stack[stackLength++] = near;
+	}
+
+	*testsRef += tests;
+	return closest_t;
+}
+
+/**
+ * Calculates the geometric normal of a triangle
+ * @param meshRef - The mesh containing the triangle
+ * @param triangle - The index of the triangle
+ * @param result - The unit normal
+ */
+void mesh_triangle_normal(Mesh *meshRef, int triangle, V3 *result) {
+	V3 vertices[3];
+	V3 edge1;
+	V3 edge2;
+
+	for (int i = 0; i < 3; i++) {
+		float *vertex = &meshRef->vertices[meshRef->indices[triangle * 3 + i] * 3];
+		vertices[i].data.X = vertex[0];
+		vertices[i].data.Y = vertex[1];
+		vertices[i].data.Z = vertex[2];
+	}
+
+	v3_subtract(&vertices[1], &vertices[0], &edge1);
+	v3_subtract(&vertices[2], &vertices[0], &edge2);
+	v3_cross(&edge1, &edge2, result);
+	v3_normalize(result, result);
+}
@@ -0,0 +1,46 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_MESH_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_MESH_H
+
+#include <stdint.h>
+#include "3dmath.h"
+
+#define MESH_LEAF_SIZE 4
+#define MESH_SAH_BINS 12
+#define MESH_TRAVERSAL_STACK_SIZE 64
+
+/**
+ * MeshNode - A node of a mesh's bounding volume hierarchy, leaves hold count triangles
+ * starting at first, inner nodes have count 0 and their children at first and first + 1
+ */
+typedef struct MeshNode {
+	float min[3];
+	float max[3];
+	uint32_t first;
+	uint32_t count;
+} MeshNode;
+
+/**
+ * Mesh - An indexed triangle mesh, vertices are packed xyz floats and triangles are packed
+ * vertex index triples reordered to match the leaves of the hierarchy
+ */
+typedef struct Mesh {
+	float *vertices;
+	uint32_t *indices;
+	MeshNode *nodes;
+	uint32_t verticesLength;
+	uint32_t trianglesLength;
+	uint32_t nodesLength;
+} Mesh;
+
+int load_obj_mesh(char *fname, Mesh *meshRef);
+int mesh_build_hierarchy(Mesh *meshRef);
+void mesh_free(Mesh *meshRef);
+double intersect_mesh(Mesh *meshRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreTriangle, int *triangleRef, uint32_t *testsRef);
+double intersect_triangle(V3 *a, V3 *b, V3 *c, V3 *rayOriginRef, V3 *rayDirectionRef);
+void mesh_triangle_normal(Mesh *meshRef, int triangle, V3 *result);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_MESH_H
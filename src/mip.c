@@ -0,0 +1,265 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "mip.h"
+#include "ppm.h"
+#include "raycaster.h"
+
+/**
+ * Loads a pixel as one word
+ * @param pixelRef - The pixel to load
+ * @return The pixel's four bytes
+ */
+static inline uint32_t mip_load(const RGBApixel *pixelRef) {
+	uint32_t word;
+	memcpy(&word, pixelRef, sizeof(word));
+	return word;
+}
+
+/**
+ * Averages whole 2x2 blocks of two rows into one row of the next level. Each pixel is split into
+ * its even and odd bytes in 16 bit lanes, so four channel sums of at most 1022 fit in one word and
+ * the compiler packs several pixels into each vector add.
+ * @param row0 - The first row of the blocks
+ * @param row1 - The second row of the blocks
+ * @param out - The row of the next level
+ * @param length - The number of blocks
+ */
+static void mip_reduce_row(const RGBApixel *restrict row0, const RGBApixel *restrict row1, RGBApixel *restrict out,
+						   uint32_t length) {
+	for (uint32_t x = 0; x < length; x++) {
+		uint32_t a = mip_load(&row0[2 * x]), b = mip_load(&row0[2 * x + 1]);
+		uint32_t c = mip_load(&row1[2 * x]), d = mip_load(&row1[2 * x + 1]);
+		uint32_t even = (a & 0x00ff00ffu) + (b & 0x00ff00ffu) + (c & 0x00ff00ffu) + (d & 0x00ff00ffu) + 0x00020002u;
+		uint32_t odd = ((a >> 8) & 0x00ff00ffu) + ((b >> 8) & 0x00ff00ffu) + ((c >> 8) & 0x00ff00ffu) +
+					   ((d >> 8) & 0x00ff00ffu) + 0x00020002u;
+		uint32_t mean = ((even >> 2) & 0x00ff00ffu) | ((odd >> 2) & 0x00ff00ffu) << 8;
+		memcpy(&out[x], &mean, sizeof(mean));
+	}
+}
+
+/**
+ * Averages the 2x2 blocks of a rectangle of one level into the next, a block cut off by an odd
+ * width or height averages the pixels it has
+ * @param srcRef - The level to read
+ * @param dstRef - The next level, half the size rounded up
+ * @param x0 - The first column of the rectangle in srcRef, even
+ * @param y0 - The first row of the rectangle in srcRef, even
+ * @param x1 - The column past the end of the rectangle
+ * @param y1 - The row past the end of the rectangle
+ */
+static void mip_reduce(Image *srcRef, Image *dstRef, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+	uint32_t wholeX1 = x0 + (x1 - x0) / 2 * 2;
+
+	for (uint32_t y = y0; y < y1; y += 2) {
+		RGBApixel *row0 = &srcRef->pixmapRef[(size_t) y * srcRef->width];
+		RGBApixel *row1 = &srcRef->pixmapRef[(size_t) (y + 1 < y1 ? y + 1 : y) * srcRef->width];
+		RGBApixel *out = &dstRef->pixmapRef[(size_t) (y / 2) * dstRef->width];
+
+		// The last row of an odd height is paired with itself, which gives the mean of its two pixels
+		mip_reduce_row(&row0[x0], &row1[x0], &out[x0 / 2], (wholeX1 - x0) / 2);
+
+		// The last column of an odd width
+		if (wholeX1 < x1) {
+			uint8_t *pixel0 = (uint8_t *) &row0[wholeX1];
+			uint8_t *pixel1 = (uint8_t *) &row1[wholeX1];
+			uint8_t *outPixel = (uint8_t *) &out[wholeX1 / 2];
+			for (int c = 0; c < 4; c++)
+				outPixel[c] = (uint8_t) ((pixel0[c] + pixel1[c] + 1) >> 1);
+		}
+	}
+}
+
+/**
+ * Resamples an image to a smaller size, each pixel the mean of the source pixels its area covers
+ * @param srcRef - The image to read
+ * @param dstRef - The image to write, already allocated at its size
+ */
+static void mip_resample(Image *srcRef, Image *dstRef) {
+	for (uint32_t y = 0; y < dstRef->height; y++) {
+		uint32_t sy0 = (uint32_t) ((uint64_t) y * srcRef->height / dstRef->height);
+		uint32_t sy1 = (uint32_t) (((uint64_t) (y + 1) * srcRef->height + dstRef->height - 1) / dstRef->height);
+		for (uint32_t x = 0; x < dstRef->width; x++) {
+			uint32_t sx0 = (uint32_t) ((uint64_t) x * srcRef->width / dstRef->width);
+			uint32_t sx1 = (uint32_t) (((uint64_t) (x + 1) * srcRef->width + dstRef->width - 1) / dstRef->width);
+			uint32_t sum[4] = {0, 0, 0, 0};
+			uint32_t count = (sy1 - sy0) * (sx1 - sx0);
+
+			for (uint32_t sy = sy0; sy < sy1; sy++) {
+				for (uint32_t sx = sx0; sx < sx1; sx++) {
+					RGBApixel *pixelRef = &srcRef->pixmapRef[(size_t) sy * srcRef->width + sx];
+					sum[0] += pixelRef->r;
+					sum[1] += pixelRef->g;
+					sum[2] += pixelRef->b;
+					sum[3] += pixelRef->a;
+				}
+			}
+			RGBApixel *outRef = &dstRef->pixmapRef[(size_t) y * dstRef->width + x];
+			outRef->r = (uint8_t) ((sum[0] + count / 2) / count);
+			outRef->g = (uint8_t) ((sum[1] + count / 2) / count);
+			outRef->b = (uint8_t) ((sum[2] + count / 2) / count);
+			outRef->a = (uint8_t) ((sum[3] + count / 2) / count);
+		}
+	}
+}
+
+/**
+ * Allocates the levels and thumbnail of a pyramid for an image
+ * @param mipRef - The pyramid to create
+ * @param width - The width of the image
+ * @param height - The height of the image
+ * @param levelsLength - The number of levels below the image, at most MIP_MAX_LEVELS
+ * @param thumbnailSize - The longest side of the thumbnail, 0 for none
+ * @return 0 if success, otherwise a failure occurred
+ */
+int mip_pyramid_create(MipPyramid *mipRef, int width, int height, int levelsLength, int thumbnailSize) {
+	memset(mipRef, 0, sizeof(MipPyramid));
+	if (levelsLength < 0 || levelsLength > MIP_MAX_LEVELS || thumbnailSize < 0) {
+		fprintf(stderr, "Error: A pyramid has 0 to %d levels and a thumbnail of 0 or more pixels\n", MIP_MAX_LEVELS);
+		return 1;
+	}
+	mipRef->width = (uint32_t) width;
+	mipRef->height = (uint32_t) height;
+	mipRef->levelsLength = levelsLength;
+	mipRef->thumbnailSize = thumbnailSize;
+	mipRef->tilesX = (width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+	mipRef->tilesY = (height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+	while (mipRef->tileLevelsLength < levelsLength && RENDER_TILE_SIZE % (2 << mipRef->tileLevelsLength) == 0)
+		mipRef->tileLevelsLength++;
+
+	mipRef->tilesDone = calloc((size_t) mipRef->tilesX * mipRef->tilesY, sizeof(uint8_t));
+	int result = mipRef->tilesDone == NULL;
+	for (int k = 1; k <= levelsLength && result == 0; k++) {
+		Image *levelRef = &mipRef->levels[k];
+		levelRef->width = (mipRef->width + (1u << k) - 1) >> k;
+		levelRef->height = (mipRef->height + (1u << k) - 1) >> k;
+		levelRef->pixmapRef = malloc(sizeof(RGBApixel) * levelRef->width * levelRef->height);
+		result = levelRef->pixmapRef == NULL;
+	}
+	if (result == 0 && thumbnailSize > 0) {
+		// A small image is its own thumbnail
+		uint32_t longest = width > height ? (uint32_t) width : (uint32_t) height;
+		uint32_t side = longest < (uint32_t) thumbnailSize ? longest : (uint32_t) thumbnailSize;
+		mipRef->thumbnail.width = (uint32_t) (((uint64_t) width * side + longest / 2) / longest);
+		mipRef->thumbnail.height = (uint32_t) (((uint64_t) height * side + longest / 2) / longest);
+		mipRef->thumbnail.width += mipRef->thumbnail.width == 0;
+		mipRef->thumbnail.height += mipRef->thumbnail.height == 0;
+		mipRef->thumbnail.pixmapRef = malloc(sizeof(RGBApixel) * mipRef->thumbnail.width * mipRef->thumbnail.height);
+		result = mipRef->thumbnail.pixmapRef == NULL;
+	}
+	if (result != 0) {
+		fprintf(stderr, "Error: Could not allocate a pyramid for an image of size %ix%i\n", width, height);
+		mip_pyramid_free(mipRef);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Reduces a finished tile into every level a tile covers whole pixels of. Tiles write disjoint
+ * pixels of each level, so this is safe to call from any rendering thread.
+ * @param mipRef - The pyramid
+ * @param imageRef - The image being rendered
+ * @param x0 - The first column of the tile
+ * @param y0 - The first row of the tile
+ * @param x1 - The column past the end of the tile
+ * @param y1 - The row past the end of the tile
+ */
+void mip_pyramid_tile_done(MipPyramid *mipRef, Image *imageRef, int x0, int y0, int x1, int y1) {
+	uint32_t levelX0 = (uint32_t) x0, levelY0 = (uint32_t) y0, levelX1 = (uint32_t) x1, levelY1 = (uint32_t) y1;
+	Image *srcRef = imageRef;
+
+	for (int k = 1; k <= mipRef->tileLevelsLength; k++) {
+		mip_reduce(srcRef, &mipRef->levels[k], levelX0, levelY0, levelX1, levelY1);
+		srcRef = &mipRef->levels[k];
+		levelX0 /= 2;
+		levelY0 /= 2;
+		levelX1 = (levelX1 + 1) / 2;
+		levelY1 = (levelY1 + 1) / 2;
+	}
+	mipRef->tilesDone[(y0 / RENDER_TILE_SIZE) * mipRef->tilesX + x0 / RENDER_TILE_SIZE] = 1;
+}
+
+/**
+ * Completes a pyramid once its image is rendered. Tiles never reported done, for example after a
+ * cancelled job or a relight, are reduced from the image as it is now, then the levels below the
+ * tile levels and the thumbnail are made from the smallest level above them.
+ * @param mipRef - The pyramid
+ * @param imageRef - The rendered image, the size the pyramid was created for
+ * @return 0 if success, otherwise a failure occurred
+ */
+int mip_pyramid_finish(MipPyramid *mipRef, Image *imageRef) {
+	if (imageRef->width != mipRef->width || imageRef->height != mipRef->height) {
+		fprintf(stderr, "Error: A %ux%u image can not finish a pyramid of a %ux%u image\n",
+				imageRef->width, imageRef->height, mipRef->width, mipRef->height);
+		return 1;
+	}
+
+	for (int tile = 0; tile < mipRef->tilesX * mipRef->tilesY; tile++) {
+		if (mipRef->tilesDone[tile])
+			continue;
+		int x0 = tile % mipRef->tilesX * RENDER_TILE_SIZE;
+		int y0 = tile / mipRef->tilesX * RENDER_TILE_SIZE;
+		int x1 = x0 + RENDER_TILE_SIZE < (int) mipRef->width ? x0 + RENDER_TILE_SIZE : (int) mipRef->width;
+		int y1 = y0 + RENDER_TILE_SIZE < (int) mipRef->height ? y0 + RENDER_TILE_SIZE : (int) mipRef->height;
+		mip_pyramid_tile_done(mipRef, imageRef, x0, y0, x1, y1);
+	}
+
+	for (int k = mipRef->tileLevelsLength + 1; k <= mipRef->levelsLength; k++) {
+		Image *srcRef = k == 1 ? imageRef : &mipRef->levels[k - 1];
+		mip_reduce(srcRef, &mipRef->levels[k], 0, 0, srcRef->width, srcRef->height);
+	}
+
+	// The thumbnail is made from the smallest level still at least its size
+	if (mipRef->thumbnailSize > 0) {
+		Image *srcRef = imageRef;
+		for (int k = 1; k <= mipRef->levelsLength && mipRef->levels[k].width >= mipRef->thumbnail.width &&
+						mipRef->levels[k].height >= mipRef->thumbnail.height; k++)
+			srcRef = &mipRef->levels[k];
+		mip_resample(srcRef, &mipRef->thumbnail);
+	}
+	return 0;
+}
+
+/**
+ * Saves every level of a pyramid as a PPM P6 image named prefix_k.ppm for level k, and the
+ * thumbnail as prefix_thumb.ppm
+ * @param mipRef - The finished pyramid
+ * @param prefix - The prefix of the filenames
+ * @return 0 if success, otherwise a failure occurred
+ */
+int mip_pyramid_save(MipPyramid *mipRef, char *prefix) {
+	size_t fnameSize = strlen(prefix) + 16;
+	char *fname = malloc(fnameSize);
+	int result = fname == NULL;
+
+	for (int k = 1; k <= mipRef->levelsLength && result == 0; k++) {
+		snprintf(fname, fnameSize, "%s_%d.ppm", prefix, k);
+		result = save_ppm_p6_image(&mipRef->levels[k], fname);
+	}
+	if (result == 0 && mipRef->thumbnailSize > 0) {
+		snprintf(fname, fnameSize, "%s_thumb.ppm", prefix);
+		result = save_ppm_p6_image(&mipRef->thumbnail, fname);
+	}
+	free(fname);
+	return result;
+}
+
+/**
+ * Releases the levels and thumbnail of a pyramid
+ * @param mipRef - The pyramid to free
+ */
+void mip_pyramid_free(MipPyramid *mipRef) {
+	for (int k = 1; k <= MIP_MAX_LEVELS; k++) {
+		free(mipRef->levels[k].pixmapRef);
+		mipRef->levels[k].pixmapRef = NULL;
+	}
+	free(mipRef->thumbnail.pixmapRef);
+	free(mipRef->tilesDone);
+	mipRef->thumbnail.pixmapRef = NULL;
+	mipRef->tilesDone = NULL;
+}
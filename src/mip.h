@@ -0,0 +1,40 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_MIP_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_MIP_H
+
+#include <stdint.h>
+#include "imaging.h"
+
+#define MIP_MAX_LEVELS 16
+#define MIP_DEFAULT_LEVELS 3
+#define MIP_DEFAULT_THUMBNAIL_SIZE 128
+
+/**
+ * MipPyramid - Downsampled copies of an image built while it renders. Level k is the image at
+ * 1/2^k of its size, each pixel the mean of the 2x2 pixels of level k-1 it covers. Tiles are
+ * aligned to RENDER_TILE_SIZE, a power of two, so each level down to a single pixel per tile is
+ * reduced from a finished tile alone without reading the image again. Deeper levels and the
+ * thumbnail, whose longest side is thumbnailSize, are made from the smallest level when the render
+ * is finished.
+ */
+typedef struct MipPyramid {
+	uint32_t width, height;
+	int levelsLength;
+	int tileLevelsLength;
+	Image levels[MIP_MAX_LEVELS + 1];
+	int thumbnailSize;
+	Image thumbnail;
+	int tilesX, tilesY;
+	uint8_t *tilesDone;
+} MipPyramid;
+
+int mip_pyramid_create(MipPyramid *mipRef, int width, int height, int levelsLength, int thumbnailSize);
+void mip_pyramid_tile_done(MipPyramid *mipRef, Image *imageRef, int x0, int y0, int x1, int y1);
+int mip_pyramid_finish(MipPyramid *mipRef, Image *imageRef);
+int mip_pyramid_save(MipPyramid *mipRef, char *prefix);
+void mip_pyramid_free(MipPyramid *mipRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_MIP_H
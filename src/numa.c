@@ -0,0 +1,207 @@
+//
+// Created on 10/18/2026.
+//
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "numa.h"
+
+/**
+ * Compare two nodes by id for qsort
+ */
+static int numa_node_compare(const void *a, const void *b) {
+	return ((NumaNode *) a)->id - ((NumaNode *) b)->id;
+}
+
+/**
+ * Parse a kernel cpu list like "0-3,8,10-11" keeping only the cores the process may run on
+ * @param list - The cpu list to parse
+ * @param allowedRef - The cores the process may run on
+ * @param nodeRef - The node to store the cores in
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int numa_parse_cpulist(char *list, cpu_set_t *allowedRef, NumaNode *nodeRef) {
+	char *cursor = list;
+
+	nodeRef->cpus = malloc(sizeof(int) * CPU_SETSIZE);
+	nodeRef->cpusLength = 0;
+	if (nodeRef->cpus == NULL)
+		return 1;
+
+	while (*cursor != '\0' && *cursor != '\n') {
+		char *end;
+		long first = strtol(cursor, &end, 10);
+		long last = first;
+		if (end == cursor)
+			return 1;
+		if (*end == '-') {
+			cursor = end + 1;
+			last = strtol(cursor, &end, 10);
+			if (end == cursor)
+				return 1;
+		}
+
+		for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, allowedRef))
+				nodeRef->cpus[nodeRef->cpusLength++] = (int) cpu;
+		}
+
+		cursor = *end == ',' ? end + 1 : end;
+	}
+	return 0;
+}
+
+/**
+ * Reads the memory nodes of the machine from sysfs, nodes without a core the process may run on
+ * (memory only nodes or ones excluded by the affinity mask) are left out
+ * @param topologyRef - The topology to populate
+ * @return 0 if success, otherwise a failure occurred
+ */
+int numa_topology_load(NumaTopology *topologyRef) {
+	cpu_set_t allowed;
+	char path[256];
+	char list[4096];
+	int nodesCapacity = 0;
+
+	topologyRef->nodes = NULL;
+	topologyRef->nodesLength = 0;
+	topologyRef->cpusLength = 0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		CPU_ZERO(&allowed);
+		for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &allowed);
+	}
+
+	DIR *dir = opendir(NUMA_NODE_PATH);
+	struct dirent *entryRef;
+	while (dir != NULL && (entryRef = readdir(dir)) != NULL) {
+		int id;
+		char rest;
+		if (sscanf(entryRef->d_name, "node%d%c", &id, &rest) != 1)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/node%d/cpulist", NUMA_NODE_PATH, id);
+		FILE *fp = fopen(path, "r");
+		if (fp == NULL)
+			continue;
+		int isRead = fgets(list, sizeof(list), fp) != NULL;
+		fclose(fp);
+		if (!isRead)
+			continue;
+
+		if (topologyRef->nodesLength == nodesCapacity) {
+			nodesCapacity = nodesCapacity == 0 ? 4 : nodesCapacity * 2;
+			NumaNode *nodes = realloc(topologyRef->nodes, sizeof(NumaNode) * nodesCapacity);
+			if (nodes == NULL) {
+				closedir(dir);
+				numa_topology_free(topologyRef);
+				fprintf(stderr, "Error: Could not allocate the NUMA topology\n");
+				return 1;
+			}
+			topologyRef->nodes = nodes;
+		}
+
+		NumaNode *nodeRef = &topologyRef->nodes[topologyRef->nodesLength];
+		nodeRef->id = id;
+		if (numa_parse_cpulist(list, &allowed, nodeRef) != 0 || nodeRef->cpusLength == 0) {
+			free(nodeRef->cpus);
+			continue;
+		}
+		topologyRef->cpusLength += nodeRef->cpusLength;
+		topologyRef->nodesLength++;
+	}
+	if (dir != NULL)
+		closedir(dir);
+
+	// Without NUMA support every allowed core is on one node
+	if (topologyRef->nodesLength == 0) {
+		free(topologyRef->nodes);
+		topologyRef->nodes = malloc(sizeof(NumaNode));
+		if (topologyRef->nodes == NULL || numa_parse_cpulist("0-1048575", &allowed, &topologyRef->nodes[0]) != 0) {
+			numa_topology_free(topologyRef);
+			fprintf(stderr, "Error: Could not allocate the NUMA topology\n");
+			return 1;
+		}
+		topologyRef->nodes[0].id = 0;
+		topologyRef->nodesLength = 1;
+		topologyRef->cpusLength = topologyRef->nodes[0].cpusLength;
+	}
+
+	qsort(topologyRef->nodes, (size_t) topologyRef->nodesLength, sizeof(NumaNode), numa_node_compare);
+	return 0;
+}
+
+/**
+ * Releases the nodes held by a topology
+ * @param topologyRef - The topology to free
+ */
+void numa_topology_free(NumaTopology *topologyRef) {
+	for (int i = 0; i < topologyRef->nodesLength; i++)
+		free(topologyRef->nodes[i].cpus);
+	free(topologyRef->nodes);
+	topologyRef->nodes = NULL;
+	topologyRef->nodesLength = 0;
+	topologyRef->cpusLength = 0;
+}
+
+/**
+ * Restricts the calling thread to the cores of a node, so the memory it touches first is
+ * placed on that node
+ * @param nodeRef - The node to run on
+ * @return 0 if success, otherwise a failure occurred
+ */
+int numa_pin_thread(NumaNode *nodeRef) {
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	for (int i = 0; i < nodeRef->cpusLength; i++)
+		CPU_SET(nodeRef->cpus[i], &cpus);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0 ? 0 : 1;
+}
+
+/**
+ * Finds the node holding each page of a range of memory, pages that were never touched are
+ * NUMA_NODE_UNKNOWN
+ * @param address - The start of the range, rounded down to its page
+ * @param pagesLength - The number of pages to look up
+ * @param nodesRef - The node of each page is written here
+ * @return 0 if success, otherwise the kernel can not report page placement
+ */
+int numa_page_nodes(void *address, size_t pagesLength, int *nodesRef) {
+	size_t pageSize = numa_page_size();
+	uintptr_t first = (uintptr_t) address & ~(uintptr_t) (pageSize - 1);
+	void *pages[NUMA_PAGES_PER_QUERY];
+
+	for (size_t i = 0; i < pagesLength; i += NUMA_PAGES_PER_QUERY) {
+		size_t queryLength = pagesLength - i < NUMA_PAGES_PER_QUERY ? pagesLength - i : NUMA_PAGES_PER_QUERY;
+		for (size_t j = 0; j < queryLength; j++)
+			pages[j] = (void *) (first + (i + j) * pageSize);
+
+		// With no target nodes move_pages only reports where each page is
+		if (syscall(SYS_move_pages, 0, queryLength, pages, NULL, &nodesRef[i], 0) != 0)
+			return 1;
+		for (size_t j = 0; j < queryLength; j++) {
+			if (nodesRef[i + j] < 0)
+				nodesRef[i + j] = NUMA_NODE_UNKNOWN;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Determine the size of a page of memory
+ * @return The page size in bytes
+ */
+size_t numa_page_size() {
+	return (size_t) sysconf(_SC_PAGESIZE);
+}
@@ -0,0 +1,39 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_NUMA_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_NUMA_H
+
+#include <stddef.h>
+
+#define NUMA_NODE_PATH "/sys/devices/system/node"
+#define NUMA_NODE_UNKNOWN -1
+#define NUMA_PAGES_PER_QUERY 1024
+
+/**
+ * NumaNode - A memory node and the cores of it the process may run on
+ */
+typedef struct NumaNode {
+	int id;
+	int *cpus;
+	int cpusLength;
+} NumaNode;
+
+/**
+ * NumaTopology - The memory nodes of the machine that have a core the process may run on, a
+ * machine without NUMA support is a single node holding every allowed core
+ */
+typedef struct NumaTopology {
+	NumaNode *nodes;
+	int nodesLength;
+	int cpusLength;
+} NumaTopology;
+
+int numa_topology_load(NumaTopology *topologyRef);
+void numa_topology_free(NumaTopology *topologyRef);
+int numa_pin_thread(NumaNode *nodeRef);
+int numa_page_nodes(void *address, size_t pagesLength, int *nodesRef);
+size_t numa_page_size();
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_NUMA_H
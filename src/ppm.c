@@ -4,6 +4,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <ctype.h>
 #include "imaging.h"
 
 /**
@@ -45,4 +46,77 @@ int save_ppm_p6_image(Image *imageRef, char *fname) {
 		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
 		return 1;
 	}
-}
\ No newline at end of file
+}
+
+/**
+ * Read the next number of a PPM header, skipping whitespace and comments
+ * @param fp - The file to read from
+ * @param result - The number read
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int read_ppm_header_value(FILE *fp, int *result) {
+	int c = getc(fp);
+	while (c == '#' || isspace(c)) {
+		if (c == '#') {
+			while (c != '\n' && c != EOF)
+				c = getc(fp);
+		}
+		c = getc(fp);
+	}
+	if (!isdigit(c))
+		return 1;
+
+	ungetc(c, fp);
+	return fscanf(fp, "%d", result) == 1 ? 0 : 1;
+}
+
+/**
+ * Allocates space in the imageRef specified and reads a PPM P6 image with a max color of 255 into it
+ * @param imageRef - The image to read into
+ * @param fname - The input filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int load_ppm_p6_image(Image *imageRef, char *fname) {
+	FILE* fp = fopen(fname, "rb");
+	int width, height, maxColor;
+	uint8_t buffer[3];
+
+	if (fp == NULL) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+
+	if (getc(fp) != 'P' || getc(fp) != '6' || read_ppm_header_value(fp, &width) != 0 ||
+		read_ppm_header_value(fp, &height) != 0 || read_ppm_header_value(fp, &maxColor) != 0 ||
+		width <= 0 || height <= 0 || maxColor != 255 || !isspace(getc(fp))) {
+		fprintf(stderr, "Error: File '%s' is not a PPM P6 image with a max color of 255\n", fname);
+		fclose(fp);
+		return 1;
+	}
+
+	imageRef->width = (uint32_t) width;
+	imageRef->height = (uint32_t) height;
+	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * width * height);
+	if (imageRef->pixmapRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate an image of size %ix%i\n", width, height);
+		fclose(fp);
+		return 1;
+	}
+
+	for (size_t i = 0; i < (size_t) width * height; i++) {
+		if (fread(buffer, sizeof(uint8_t), 3, fp) != 3) {
+			fprintf(stderr, "Error: File '%s' ended before all of its pixels were read\n", fname);
+			free(imageRef->pixmapRef);
+			imageRef->pixmapRef = NULL;
+			fclose(fp);
+			return 1;
+		}
+		imageRef->pixmapRef[i].r = buffer[0];
+		imageRef->pixmapRef[i].g = buffer[1];
+		imageRef->pixmapRef[i].b = buffer[2];
+		imageRef->pixmapRef[i].a = 255;
+	}
+
+	fclose(fp);
+	return 0;
+}
@@ -8,5 +8,6 @@
 #include "imaging.h"
 
 int save_ppm_p6_image(Image *imageRef, char *fname);
+int load_ppm_p6_image(Image *imageRef, char *fname);
 
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_PPM_H
@@ -4,51 +4,978 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 #include "3dmath.h"
 #include "raycaster.h"
 #include "imaging.h"
+#include "gbuffer.h"
+#include "dirty.h"
+#include "numa.h"
+#include "cost.h"
+#include "render_job.h"
+#include "renderer.h"
+#include "thread_pool.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "mip.h"
+#include "tile_cache.h"
+#include "shadow_packet.h"
+#include "light_tree.h"
+#include "json.h"
+#include "raycaster_helpers.h"
+
+/**
+ * Sets the render options to their defaults
+ * @param optionsRef - The options to initialize
+ */
+void render_options_init(RenderOptions *optionsRef) {
+	optionsRef->gbufferRef = NULL;
+	optionsRef->regionRef = NULL;
+	optionsRef->costRef = NULL;
+	optionsRef->statsRef = NULL;
+	optionsRef->jobRef = NULL;
+	optionsRef->rendererRef = NULL;
+	optionsRef->frameBufferRef = NULL;
+	optionsRef->writerRef = NULL;
+	optionsRef->mipRef = NULL;
+	optionsRef->tileCacheRef = NULL;
+	optionsRef->threadsLength = 0;
+	optionsRef->maxDepth = DEFAULT_MAX_DEPTH;
+	optionsRef->rayBudget = DEFAULT_RAY_BUDGET;
+	optionsRef->lightSamples = 0;
+	optionsRef->areaLightSamples = AREA_LIGHT_DEFAULT_SAMPLES;
+	optionsRef->wavefront = 0;
+	optionsRef->firstRow = 0;
+	optionsRef->fullHeight = 0;
+}
+
+/**
+ * RenderNodeQueue - The tiles in the band of tile rows owned by one memory node, allocated by a
+ * thread on that node along with the node's copy of the scene
+ */
+typedef struct RenderNodeQueue {
+	pthread_mutex_t mutex;
+	int nextTile;
+	int endTile;
+	Scene *sceneRef;
+	Scene sceneCopy;
+	int hasSceneCopy;
+} RenderNodeQueue;
+
+/**
+ * RenderContext - Shared state of the threads rendering an image
+ */
+typedef struct RenderContext {
+	Scene *sceneRef;
+	Image *imageRef;
+	RenderOptions *optionsRef;
+	NumaTopology topology;
+	RenderNodeQueue **queues;
+	int *tileNodes;
+	PrimitiveBound *bounds;
+	LightTree *lightTreeRef;
+	uint64_t tileCacheKey;
+	int features;
+	int nodesLength;
+	int tilesX, tilesY;
+	int isPinned;
+	int isReplicated;
+	int result;
+} RenderContext;
+
+/**
+ * RenderWorker - One thread of a render, the node it runs on and its shadow packet
+ */
+typedef struct RenderWorker {
+	RenderContext *contextRef;
+	int node;
+	int tilesStolen;
+	ShadowPacket packet;
+} RenderWorker;
+
+/**
+ * Copies the work a ray stack counted for its pixel into a cost buffer
+ * @param costRef - The cost buffer to write to
+ * @param stackRef - The ray stack that traced the pixel
+ * @param pixel - The index of the pixel
+ */
+static void cost_buffer_store(CostBuffer *costRef, RayStack *stackRef, size_t pixel) {
+	uint32_t *countersRef = &costRef->countersRef[pixel * COST_CHANNELS];
+	countersRef[COST_INTERSECTION_TESTS] = stackRef->intersectionTests;
+	countersRef[COST_SHADOW_RAYS] = stackRef->shadowRays;
+	countersRef[COST_LIGHTS_SHADED] = stackRef->lightsShaded;
+}
+
+/**
+ * Generates the unit directions of the primary rays through a span of one row of pixels. The view
+ * plane point of each pixel is (X, Y, 1) where X only depends on the column and Y on the row, and
+ * the loop has no branches so the compiler turns it into packed square roots and divides. The
+ * results match calling v3_normalize on each view plane point bit for bit.
+ * @param cameraRef - The camera to generate rays for
+ * @param imageWidth - The width of the image
+ * @param imageHeight - The height of the image
+ * @param y - The row of the span
+ * @param x0 - The first column of the span
+ * @param x1 - The column past the end of the span
+ * @param directionsRef - The direction of column x is written to directionsRef[x - x0]
+ */
+void primary_rays_generate(Camera *cameraRef, int imageWidth, int imageHeight, int y, int x0, int x1, V3 *directionsRef) {
+	V3 viewPlanePos = {0, 0, 1};
+	double pixelHeight = cameraRef->height/imageHeight;
+	double pixelWidth = cameraRef->width/imageWidth;
+	double left = viewPlanePos.data.X - cameraRef->width/2.0;
+	double pointY = -(viewPlanePos.data.Y - cameraRef->height/2.0 + pixelHeight * (y + 0.5));
+	double pointYSquared = pointY * pointY;
+	double pointZSquared = viewPlanePos.data.Z * viewPlanePos.data.Z;
+
+	for (int x = x0; x < x1; x++) {
+		double pointX = left + pixelWidth * (x + 0.5);
+		double inverseLength = 1 / sqrt(pointX * pointX + pointYSquared + pointZSquared);
+		directionsRef[x - x0].data.X = pointX * inverseLength;
+		directionsRef[x - x0].data.Y = pointY * inverseLength;
+		directionsRef[x - x0].data.Z = viewPlanePos.data.Z * inverseLength;
+	}
+}
+
+/**
+ * Writes one rendered pixel into the frame buffer of the options when one is set, otherwise into the image
+ * @param imageRef - The image being rendered
+ * @param frameBufferRef - The frame buffer being rendered into, or NULL
+ * @param x - The column of the pixel
+ * @param y - The row of the pixel
+ * @param pixelRef - The pixel to write
+ */
+static inline void raycast_store(Image *imageRef, FrameBuffer *frameBufferRef, int x, int y, RGBApixel *pixelRef) {
+	if (frameBufferRef != NULL)
+		frame_buffer_store(frameBufferRef, x, y, pixelRef);
+	else
+		imageRef->pixmapRef[(size_t) y*imageRef->width + x] = *pixelRef;
+}
+
+/**
+ * Seeds the random numbers of one pixel from its index in the full image, so a band of rows
+ * renders exactly as the same rows of the whole image
+ * @param optionsRef - The options being rendered with
+ * @param imageWidth - The width of the image
+ * @param x - The column of the pixel
+ * @param y - The row of the pixel in the image being rendered
+ * @return The seed of the pixel
+ */
+static inline uint32_t raycast_seed(RenderOptions *optionsRef, int imageWidth, int x, int y) {
+	return (uint32_t) ((size_t) (y + optionsRef->firstRow) * imageWidth + x);
+}
+
+static void raycast_tile_wavefront(Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef, RayStack *stackRef,
+								   ShadowPacket *packetRef, int x0, int y0, int x1, int y1);
+
+/**
+ * Raycasts the pixels of one rectangle of the image. With a shadow packet the primary hits of the
+ * whole rectangle are found first, then the packet lists the primitives that could shadow them from
+ * each light and every pixel is shaded testing only those, or the hits are shaded as a wavefront
+ * when the options ask for it and the scene has no area lights. The image is the same either way.
+ * @param sceneRef - The input scene to render
+ * @param imageRef - The output image to write to, already allocated
+ * @param optionsRef - The options to render with
+ * @param stackRef - The ray stack of the calling thread
+ * @param packetRef - The shadow packet of the calling thread, reserved for the scene, or NULL
+ * @param x0 - The first column of the rectangle
+ * @param y0 - The first row of the rectangle
+ * @param x1 - The column past the end of the rectangle, at most RENDER_TILE_SIZE past x0
+ * @param y1 - The row past the end of the rectangle, at most RENDER_TILE_SIZE past y0
+ */
+void raycast_tile(Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef, RayStack *stackRef, ShadowPacket *packetRef,
+				  int x0, int y0, int x1, int y1) {
+	GBuffer *gbufferRef = optionsRef->gbufferRef;
+	DirtyRegion *regionRef = optionsRef->regionRef;
+	CostBuffer *costRef = optionsRef->costRef;
+	FrameBuffer *frameBufferRef = optionsRef->frameBufferRef;
+	int imageWidth = (int) imageRef->width;
+	int raysHeight = optionsRef->fullHeight > 0 ? optionsRef->fullHeight : (int) imageRef->height;
+
+    V3 cameraPos = {0, 0, 0};
+
+	RGBAColor colorFound;
+	RGBApixel pixel;
+	GBufferSample *sampleRef = NULL;
+	V3 rowDirections[RENDER_TILE_SIZE];
+	V3 *directionsRef = NULL;
+	int spanStart = x1;
+	V3 hitsMin = {INFINITY, INFINITY, INFINITY};
+	V3 hitsMax = {-INFINITY, -INFINITY, -INFINITY};
+
+	for (int y=y0; y<y1; y++) {
+		for (int x=x0; x<x1; x++) {
+			// Directions are generated a span of the row at a time
+			if (x == x0 || x - spanStart >= RENDER_TILE_SIZE) {
+				int spanEnd = x + RENDER_TILE_SIZE < x1 ? x + RENDER_TILE_SIZE : x1;
+				primary_rays_generate(&sceneRef->camera, imageWidth, raysHeight, y + optionsRef->firstRow, x, spanEnd, rowDirections);
+				directionsRef = rowDirections;
+				spanStart = x;
+			}
+
+			if (regionRef != NULL && !regionRef->maskRef[y*imageWidth + x])
+				continue;
+			V3 *rayDirectionRef = &directionsRef[x - spanStart];
+			ray_stack_reset(stackRef, raycast_seed(optionsRef, imageWidth, x, y));
+
+			// With a packet only the primary hit is found now, it is shaded once the tile's hits are known
+			if (packetRef != NULL) {
+				int packed = (y - y0)*RENDER_TILE_SIZE + x - x0;
+				GBufferSample *hitRef = &packetRef->samples[packed];
+				shoot_primary(&cameraPos, rayDirectionRef, sceneRef, stackRef, hitRef);
+				packetRef->primaryTests[packed] = stackRef->intersectionTests;
+				if (hitRef->primitiveId == GBUFFER_NO_HIT)
+					continue;
+				for (int i = 0; i < 3; i++) {
+					hitsMin.array[i] = fmin(hitsMin.array[i], hitRef->point.array[i]);
+					hitsMax.array[i] = fmax(hitsMax.array[i], hitRef->point.array[i]);
+				}
+				continue;
+			}
+
+			if (gbufferRef != NULL)
+				sampleRef = &gbufferRef->samplesRef[y*imageWidth + x];
+			shoot(&cameraPos, rayDirectionRef, sceneRef, stackRef, &colorFound, sampleRef);
+			shade(&colorFound, &pixel);
+			raycast_store(imageRef, frameBufferRef, x, y, &pixel);
+			if (costRef != NULL)
+				cost_buffer_store(costRef, stackRef, y*imageWidth + x);
+		}
+	}
+
+	if (packetRef == NULL)
+		return;
+
+	// A tile without a hit shades nothing, so its lists are never read
+	if (hitsMin.data.X <= hitsMax.data.X)
+		shadow_packet_cull(packetRef, sceneRef, &hitsMin, &hitsMax);
+
+	if (optionsRef->wavefront && !(stackRef->features & SCENE_FEATURE_AREA_LIGHTS)) {
+		raycast_tile_wavefront(sceneRef, imageRef, optionsRef, stackRef, packetRef, x0, y0, x1, y1);
+		return;
+	}
+
+	for (int y=y0; y<y1; y++) {
+		for (int x=x0; x<x1; x++) {
+			if (regionRef != NULL && !regionRef->maskRef[y*imageWidth + x])
+				continue;
+			int packed = (y - y0)*RENDER_TILE_SIZE + x - x0;
+
+			// Restore the pixel's stack as the first pass left it, the primary ray already paid for
+			ray_stack_reset(stackRef, raycast_seed(optionsRef, imageWidth, x, y));
+			stackRef->raysLeft--;
+			stackRef->intersectionTests = packetRef->primaryTests[packed];
+			if (gbufferRef != NULL)
+				gbufferRef->samplesRef[y*imageWidth + x] = packetRef->samples[packed];
+			shoot_shade(&packetRef->samples[packed], sceneRef, stackRef, packetRef, &colorFound);
+			shade(&colorFound, &pixel);
+			raycast_store(imageRef, frameBufferRef, x, y, &pixel);
+			if (costRef != NULL)
+				cost_buffer_store(costRef, stackRef, y*imageWidth + x);
+		}
+	}
+}
+
+/**
+ * Raycasts one rectangle of the image at a reduced resolution, a single pixel is traced for each
+ * square block of the rectangle and copied across the block. With a dirty region the first dirty
+ * pixel of a block is traced and only the dirty pixels of the block are written.
+ * @param sceneRef - The input scene to render
+ * @param imageRef - The output image to write to, already allocated
+ * @param optionsRef - The options to render with
+ * @param stackRef - The ray stack of the calling thread
+ * @param x0 - The first column of the rectangle
+ * @param y0 - The first row of the rectangle
+ * @param x1 - The column past the end of the rectangle
+ * @param y1 - The row past the end of the rectangle
+ * @param blockSize - The width of the blocks
+ */
+static void raycast_tile_blocks(Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef, RayStack *stackRef,
+								int x0, int y0, int x1, int y1, int blockSize) {
+	GBuffer *gbufferRef = optionsRef->gbufferRef;
+	DirtyRegion *regionRef = optionsRef->regionRef;
+	CostBuffer *costRef = optionsRef->costRef;
+	FrameBuffer *frameBufferRef = optionsRef->frameBufferRef;
+	int imageWidth = (int) imageRef->width;
+	int raysHeight = optionsRef->fullHeight > 0 ? optionsRef->fullHeight : (int) imageRef->height;
+	V3 cameraPos = {0, 0, 0};
+
+	RGBAColor colorFound;
+	RGBApixel pixel;
+	GBufferSample *sampleRef = NULL;
+	V3 rayDirection;
+
+	for (int blockY = y0; blockY < y1; blockY += blockSize) {
+		int blockY1 = blockY + blockSize < y1 ? blockY + blockSize : y1;
+		for (int blockX = x0; blockX < x1; blockX += blockSize) {
+			int blockX1 = blockX + blockSize < x1 ? blockX + blockSize : x1;
+
+			// Find the pixel of the block to trace, a block with no dirty pixels is skipped
+			int tracedX = -1, tracedY = -1;
+			for (int y = blockY; tracedX < 0 && y < blockY1; y++) {
+				for (int x = blockX; x < blockX1; x++) {
+					if (regionRef == NULL || regionRef->maskRef[y*imageWidth + x]) {
+						tracedX = x;
+						tracedY = y;
+						break;
+					}
+				}
+			}
+			if (tracedX < 0)
+				continue;
+
+			size_t traced = (size_t) tracedY*imageWidth + tracedX;
+			primary_rays_generate(&sceneRef->camera, imageWidth, raysHeight, tracedY + optionsRef->firstRow, tracedX, tracedX + 1,
+								  &rayDirection);
+			if (gbufferRef != NULL)
+				sampleRef = &gbufferRef->samplesRef[traced];
+			ray_stack_reset(stackRef, raycast_seed(optionsRef, imageWidth, tracedX, tracedY));
+			shoot(&cameraPos, &rayDirection, sceneRef, stackRef, &colorFound, sampleRef);
+			shade(&colorFound, &pixel);
+			if (costRef != NULL)
+				cost_buffer_store(costRef, stackRef, traced);
+
+			for (int y = blockY; y < blockY1; y++) {
+				for (int x = blockX; x < blockX1; x++) {
+					size_t copied = (size_t) y*imageWidth + x;
+					if (regionRef != NULL && !regionRef->maskRef[copied])
+						continue;
+					raycast_store(imageRef, frameBufferRef, x, y, &pixel);
+					if (copied == traced)
+						continue;
+					if (gbufferRef != NULL)
+						gbufferRef->samplesRef[copied] = *sampleRef;
+					if (costRef != NULL)
+						memcpy(&costRef->countersRef[copied * COST_CHANNELS], &costRef->countersRef[traced * COST_CHANNELS],
+							   sizeof(uint32_t) * COST_CHANNELS);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Thread body that prepares one node for rendering. Running on the node's cores, it allocates the
+ * node's tile queue and copy of the scene and touches the node's band of the image first, so the
+ * kernel places all of them in the node's memory.
+ * @param workerRef - The RenderWorker naming the node
+ * @return NULL
+ */
+static void *raycast_node_thread(void *workerRef) {
+	RenderWorker *renderWorkerRef = workerRef;
+	RenderContext *contextRef = renderWorkerRef->contextRef;
+	int node = renderWorkerRef->node;
+	Image *imageRef = contextRef->imageRef;
+
+	if (contextRef->isPinned)
+		numa_pin_thread(&contextRef->topology.nodes[node]);
+
+	// A queue kept by a renderer from an earlier render is reused
+	RenderNodeQueue *queueRef = contextRef->queues[node];
+	if (queueRef == NULL) {
+		queueRef = malloc(sizeof(RenderNodeQueue));
+		if (queueRef == NULL) {
+			fprintf(stderr, "Error: Could not allocate a render queue\n");
+			contextRef->result = 1;
+			return NULL;
+		}
+		pthread_mutex_init(&queueRef->mutex, NULL);
+		queueRef->hasSceneCopy = 0;
+		contextRef->queues[node] = queueRef;
+	}
+
+	int firstRow = node * contextRef->tilesY / contextRef->nodesLength;
+	int endRow = (node + 1) * contextRef->tilesY / contextRef->nodesLength;
+	queueRef->nextTile = firstRow * contextRef->tilesX;
+	queueRef->endTile = endRow * contextRef->tilesX;
+	queueRef->sceneRef = contextRef->sceneRef;
+
+	if (contextRef->isReplicated) {
+		int result = queueRef->hasSceneCopy ? scene_copy_update(contextRef->sceneRef, &queueRef->sceneCopy) :
+											  scene_copy(contextRef->sceneRef, &queueRef->sceneCopy);
+		queueRef->hasSceneCopy = result == 0;
+		if (result != 0) {
+			contextRef->result = 1;
+			return NULL;
+		}
+		queueRef->sceneRef = &queueRef->sceneCopy;
+	}
+
+	// A previous render being updated was already placed when it was read
+	if (contextRef->optionsRef->regionRef == NULL && contextRef->optionsRef->frameBufferRef != NULL) {
+		frame_buffer_clear_rows(contextRef->optionsRef->frameBufferRef, firstRow * RENDER_TILE_SIZE, endRow * RENDER_TILE_SIZE);
+	}
+	else if (contextRef->optionsRef->regionRef == NULL) {
+		size_t first = (size_t) firstRow * RENDER_TILE_SIZE * imageRef->width;
+		size_t end = (size_t) endRow * RENDER_TILE_SIZE * imageRef->width;
+		if (end > (size_t) imageRef->width * imageRef->height)
+			end = (size_t) imageRef->width * imageRef->height;
+		memset(&imageRef->pixmapRef[first], 0, sizeof(RGBApixel) * (end - first));
+	}
+
+	return NULL;
+}
+
+/**
+ * Takes the next tile from a node's queue
+ * @param queueRef - The queue to take from
+ * @return The tile, or -1 if the queue is empty
+ */
+static int raycast_take_tile(RenderNodeQueue *queueRef) {
+	int tile = -1;
+
+	pthread_mutex_lock(&queueRef->mutex);
+	if (queueRef->nextTile < queueRef->endTile)
+		tile = queueRef->nextTile++;
+	pthread_mutex_unlock(&queueRef->mutex);
+
+	return tile;
+}
+
+/**
+ * Thread body of raycast, renders the tiles of its own node and then steals from the other
+ * nodes until every queue is empty. The scene is always read from the thread's own node. When the
+ * render is a job, it stops once the job is cancelled, counts every tile finished and renders at a
+ * reduced resolution the tiles the job's deadline leaves no time to render in full.
+ * @param workerRef - The RenderWorker of this thread
+ * @return NULL
+ */
+static void *raycast_worker_thread(void *workerRef) {
+	RenderWorker *renderWorkerRef = workerRef;
+	RenderContext *contextRef = renderWorkerRef->contextRef;
+	RenderNodeQueue *ownQueueRef = contextRef->queues[renderWorkerRef->node];
+	RenderJob *jobRef = contextRef->optionsRef->jobRef;
+	TileCache *tileCacheRef = contextRef->optionsRef->tileCacheRef;
+	ShadowPacket *packetRef = NULL;
+	RayStack stack;
+
+	if (contextRef->isPinned)
+		numa_pin_thread(&contextRef->topology.nodes[renderWorkerRef->node]);
+	ray_stack_init(&stack, contextRef->optionsRef->maxDepth, contextRef->optionsRef->rayBudget);
+	stack.lightTreeRef = contextRef->lightTreeRef;
+	stack.lightSamples = contextRef->optionsRef->lightSamples;
+	stack.areaLightSamples = contextRef->optionsRef->areaLightSamples;
+	stack.features = contextRef->features;
+	stack.shadeKernel = shade_kernel_select(contextRef->features);
+
+	// Without room for a packet the tiles are shaded a pixel at a time
+	if (contextRef->bounds != NULL && shadow_packet_reserve(&renderWorkerRef->packet, contextRef->sceneRef) == 0) {
+		packetRef = &renderWorkerRef->packet;
+		packetRef->boundsRef = contextRef->bounds;
+	}
+
+	for (int i = 0; i < contextRef->nodesLength; i++) {
+		RenderNodeQueue *queueRef = contextRef->queues[(renderWorkerRef->node + i) % contextRef->nodesLength];
+		int tile;
+		while ((jobRef == NULL || !atomic_load(&jobRef->isCancelled)) && (tile = raycast_take_tile(queueRef)) >= 0) {
+			int x0 = tile % contextRef->tilesX * RENDER_TILE_SIZE;
+			int y0 = tile / contextRef->tilesX * RENDER_TILE_SIZE;
+			int x1 = x0 + RENDER_TILE_SIZE < (int) contextRef->imageRef->width ? x0 + RENDER_TILE_SIZE : (int) contextRef->imageRef->width;
+			int y1 = y0 + RENDER_TILE_SIZE < (int) contextRef->imageRef->height ? y0 + RENDER_TILE_SIZE : (int) contextRef->imageRef->height;
+
+			if (tileCacheRef != NULL && tile_cache_load(tileCacheRef, contextRef->tileCacheKey, contextRef->imageRef, x0, y0, x1, y1) == 0) {
+				// A cached tile is copied in place of being traced
+				if (jobRef != NULL)
+					render_job_tile_cached(jobRef);
+			}
+			else if (jobRef == NULL) {
+				raycast_tile(ownQueueRef->sceneRef, contextRef->imageRef, contextRef->optionsRef, &stack, packetRef, x0, y0, x1, y1);
+				if (tileCacheRef != NULL)
+					tile_cache_store(tileCacheRef, contextRef->tileCacheKey, contextRef->imageRef, x0, y0, x1, y1);
+			}
+			else {
+				int64_t startNs = render_job_now_ns();
+				int blockSize = render_job_block_size(jobRef);
+				if (blockSize > 1)
+					raycast_tile_blocks(ownQueueRef->sceneRef, contextRef->imageRef, contextRef->optionsRef, &stack, x0, y0, x1, y1, blockSize);
+				else
+					raycast_tile(ownQueueRef->sceneRef, contextRef->imageRef, contextRef->optionsRef, &stack, packetRef, x0, y0, x1, y1);
+				render_job_tile_done(jobRef, render_job_now_ns() - startNs, blockSize);
+
+				// Tiles rendered at a lower resolution to meet the deadline are never cached
+				if (tileCacheRef != NULL && blockSize == 1)
+					tile_cache_store(tileCacheRef, contextRef->tileCacheKey, contextRef->imageRef, x0, y0, x1, y1);
+			}
+			contextRef->tileNodes[tile] = renderWorkerRef->node;
+			renderWorkerRef->tilesStolen += i > 0;
+			if (contextRef->optionsRef->mipRef != NULL)
+				mip_pyramid_tile_done(contextRef->optionsRef->mipRef, contextRef->imageRef, x0, y0, x1, y1);
+			if (contextRef->optionsRef->writerRef != NULL)
+				image_writer_tile_done(contextRef->optionsRef->writerRef, tile / contextRef->tilesX);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Reports where a render's pixels were written, a write is local when the page holding it is on
+ * the node of the thread that rendered it
+ * @param contextRef - The finished render
+ * @param workers - The workers of the render
+ * @param workersLength - The number of workers
+ * @param statsRef - The report is written here
+ */
+static void raycast_stats(RenderContext *contextRef, RenderWorker *workers, int workersLength, RenderStats *statsRef) {
+	Image *imageRef = contextRef->imageRef;
+	FrameBuffer *frameBufferRef = contextRef->optionsRef->frameBufferRef;
+	size_t pageSize = numa_page_size();
+
+	// Pixels are written either to the image or to the rows of the frame buffer
+	uint8_t *pixels = frameBufferRef != NULL ? frameBufferRef->pixelsRef : (uint8_t *) imageRef->pixmapRef;
+	size_t pixelSize = frameBufferRef != NULL ? pixel_format_size(frameBufferRef->format) : sizeof(RGBApixel);
+	size_t stride = frameBufferRef != NULL ? frameBufferRef->stride : sizeof(RGBApixel) * imageRef->width;
+	uintptr_t firstPage = (uintptr_t) pixels & ~(uintptr_t) (pageSize - 1);
+	uintptr_t end = (uintptr_t) (pixels + stride * imageRef->height);
+	size_t pagesLength = (end - firstPage + pageSize - 1) / pageSize;
+	int *pageNodes = NULL;
+
+	memset(statsRef, 0, sizeof(RenderStats));
+	statsRef->threadsLength = workersLength;
+	statsRef->nodesLength = contextRef->nodesLength;
+	statsRef->sceneCopiesLength = contextRef->isReplicated ? contextRef->nodesLength : 0;
+	statsRef->tilesLength = contextRef->tilesX * contextRef->tilesY;
+	for (int i = 0; i < workersLength; i++)
+		statsRef->tilesStolen += workers[i].tilesStolen;
+
+	// On one node every page is local, otherwise ask the kernel where each page landed
+	if (contextRef->nodesLength > 1) {
+		pageNodes = malloc(sizeof(int) * pagesLength);
+		if (pageNodes != NULL && numa_page_nodes((void *) firstPage, pagesLength, pageNodes) != 0) {
+			free(pageNodes);
+			pageNodes = NULL;
+		}
+	}
+
+	for (int tile = 0; tile < statsRef->tilesLength; tile++) {
+		int x0 = tile % contextRef->tilesX * RENDER_TILE_SIZE;
+		int y0 = tile / contextRef->tilesX * RENDER_TILE_SIZE;
+		int x1 = x0 + RENDER_TILE_SIZE < (int) imageRef->width ? x0 + RENDER_TILE_SIZE : (int) imageRef->width;
+		int y1 = y0 + RENDER_TILE_SIZE < (int) imageRef->height ? y0 + RENDER_TILE_SIZE : (int) imageRef->height;
+		size_t rowBytes = pixelSize * (x1 - x0);
+
+		for (int y = y0; y < y1; y++) {
+			if (contextRef->nodesLength == 1) {
+				statsRef->localBytes += rowBytes;
+				continue;
+			}
+
+			uintptr_t address = (uintptr_t) (pixels + stride * y + pixelSize * x0);
+			int pageNode = pageNodes == NULL ? NUMA_NODE_UNKNOWN : pageNodes[(address - firstPage) / pageSize];
+			if (pageNode == NUMA_NODE_UNKNOWN)
+				statsRef->unknownBytes += rowBytes;
+			else if (pageNode == contextRef->topology.nodes[contextRef->tileNodes[tile]].id)
+				statsRef->localBytes += rowBytes;
+			else
+				statsRef->remoteBytes += rowBytes;
+		}
+	}
+
+	free(pageNodes);
+}
+
+/**
+ * Releases the queues, scene copies and worker state held by a render scratch
+ * @param scratchRef - The scratch to free
+ */
+void render_scratch_free(RenderScratch *scratchRef) {
+	for (int i = 0; i < scratchRef->queuesLength; i++) {
+		RenderNodeQueue *queueRef = scratchRef->queues[i];
+		if (queueRef == NULL)
+			continue;
+		if (queueRef->hasSceneCopy)
+			scene_free(&queueRef->sceneCopy);
+		pthread_mutex_destroy(&queueRef->mutex);
+		free(queueRef);
+	}
+	free(scratchRef->queues);
+	free(scratchRef->tileNodes);
+	for (int i = 0; i < scratchRef->workersCapacity; i++)
+		shadow_packet_free(&scratchRef->workers[i].packet);
+	free(scratchRef->workers);
+	free(scratchRef->bounds);
+	if (scratchRef->lightTree != NULL)
+		light_tree_free(scratchRef->lightTree);
+	free(scratchRef->lightTree);
+	memset(scratchRef, 0, sizeof(RenderScratch));
+}
+
+/**
+ * Makes sure a render scratch has room for a render, it only grows
+ * @param scratchRef - The scratch to grow, zeroed before its first use
+ * @param nodesLength - The number of memory nodes of the machine
+ * @param tilesLength - The number of tiles in the image
+ * @param workersLength - The number of worker threads
+ * @param primitivesLength - The number of primitives in the scene
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int render_scratch_reserve(RenderScratch *scratchRef, int nodesLength, int tilesLength, int workersLength, int primitivesLength) {
+	if (nodesLength > scratchRef->queuesLength) {
+		RenderNodeQueue **queues = realloc(scratchRef->queues, sizeof(RenderNodeQueue *) * nodesLength);
+		if (queues == NULL)
+			return 1;
+		memset(&queues[scratchRef->queuesLength], 0, sizeof(RenderNodeQueue *) * (nodesLength - scratchRef->queuesLength));
+		scratchRef->queues = queues;
+		scratchRef->queuesLength = nodesLength;
+	}
+	if (tilesLength > scratchRef->tilesCapacity) {
+		free(scratchRef->tileNodes);
+		scratchRef->tileNodes = malloc(sizeof(int) * tilesLength);
+		scratchRef->tilesCapacity = scratchRef->tileNodes != NULL ? tilesLength : 0;
+		if (scratchRef->tileNodes == NULL)
+			return 1;
+	}
+	if (workersLength > scratchRef->workersCapacity) {
+		for (int i = 0; i < scratchRef->workersCapacity; i++)
+			shadow_packet_free(&scratchRef->workers[i].packet);
+		free(scratchRef->workers);
+		scratchRef->workers = calloc((size_t) workersLength, sizeof(RenderWorker));
+		scratchRef->workersCapacity = scratchRef->workers != NULL ? workersLength : 0;
+		if (scratchRef->workers == NULL)
+			return 1;
+	}
+	if (primitivesLength > scratchRef->boundsCapacity) {
+		free(scratchRef->bounds);
+		scratchRef->bounds = malloc(sizeof(PrimitiveBound) * primitivesLength);
+		scratchRef->boundsCapacity = scratchRef->bounds != NULL ? primitivesLength : 0;
+		if (scratchRef->bounds == NULL)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Frees the pixmap raycast allocated for an image, so a failed render leaves nothing to free
+ * @param imageRef - The image the pixmap was allocated for
+ * @param ownedPixmapRef - The pixmap raycast allocated, NULL if the image was passed in allocated
+ */
+static void raycast_free_owned_pixmap(Image *imageRef, RGBApixel *ownedPixmapRef) {
+	if (ownedPixmapRef != NULL) {
+		free(ownedPixmapRef);
+		imageRef->pixmapRef = NULL;
+	}
+}
 
 /**
  * Allocates space in the imageRef specified for an image of the selected imageWidth and imageHeight.
- * Then raycasts a specified scene into the specified image.
+ * Then raycasts a specified scene into the specified image. With a dirty region set the image must
+ * already hold the previous render at this size, nothing is allocated and only the dirty pixels are traced.
+ * The image is rendered in tiles on every thread. On a machine with several memory nodes each node
+ * owns a band of tile rows, its threads are pinned to its cores and its band of the image, tile
+ * queue and (when small enough) copy of the scene are first touched from its cores. When the options
+ * name a job its counters are updated as tiles finish and the render stops early if it is cancelled,
+ * leaving the tiles not yet rendered black (or as they were in the previous render). When the options
+ * name a renderer the image is its framebuffer, already allocated at this size, and the renderer's
+ * threads, topology and scratch are used instead of ones made for this call. When the options name
+ * a frame buffer of this size the pixels are written into it in its format and the image is not used.
+ * When the options name an image writer for this image, its rows are written out while it renders.
+ * When the options name a pyramid for this image, each tile is reduced into it as it finishes.
+ * When the options give a full height the image is one band of the rows of a taller image.
+ * When the options name a tile cache, tiles found in it are copied instead of traced and the rest
+ * are added to it.
  * @param sceneRef - The input scene to render
  * @param imageRef - The output image to write to
+ * @param optionsRef - The options to render with, if the G-buffer is set the primary hits are captured into it
  * @param imageWidth - The height of the output image
  * @param imageHeight - The width of the output image
- * @return 0 if success, otherwise a failure occurred
+ * @return 0 if success, RENDER_CANCELLED if the job was cancelled, otherwise a failure occurred
  */
-int raycast(Scene *sceneRef, Image* imageRef, int imageWidth, int imageHeight) {
+int raycast(Scene *sceneRef, Image* imageRef, RenderOptions *optionsRef, int imageWidth, int imageHeight) {
+	GBuffer *gbufferRef = optionsRef->gbufferRef;
+	DirtyRegion *regionRef = optionsRef->regionRef;
+	Renderer *rendererRef = optionsRef->rendererRef;
+	FrameBuffer *frameBufferRef = optionsRef->frameBufferRef;
+	Image frameImage;
+	RGBApixel *ownedPixmapRef = NULL;
 
-	imageRef->width = (uint32_t) imageWidth;
-	imageRef->height= (uint32_t) imageHeight;
-	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * imageWidth * imageHeight);
+	// The writer reads the rows it writes from the image
+	if (optionsRef->writerRef != NULL && (frameBufferRef != NULL || optionsRef->writerRef->width != (uint32_t) imageWidth ||
+										  optionsRef->writerRef->height != (uint32_t) imageHeight)) {
+		fprintf(stderr, "Error: An image writer needs a %ix%i image and can not write from a frame buffer\n",
+				imageWidth, imageHeight);
+		return 1;
+	}
 
-	double cameraHeight = sceneRef->camera.height;
-	double cameraWidth = sceneRef->camera.width;
+	// The pyramid is reduced from the image's pixels, a whole image at its size
+	if (optionsRef->mipRef != NULL && (frameBufferRef != NULL || optionsRef->fullHeight > 0 ||
+									   optionsRef->mipRef->width != (uint32_t) imageWidth ||
+									   optionsRef->mipRef->height != (uint32_t) imageHeight)) {
+		fprintf(stderr, "Error: A pyramid needs a whole %ix%i image and can not be reduced from a frame buffer\n",
+				imageWidth, imageHeight);
+		return 1;
+	}
 
-	V3 viewPlanePos = {0, 0, 1};
-    V3 cameraPos = {0, 0, 0};
+	// A cached tile holds only its pixels, which are copied from and into the image
+	if (optionsRef->tileCacheRef != NULL && (frameBufferRef != NULL || regionRef != NULL || gbufferRef != NULL ||
+											 optionsRef->costRef != NULL)) {
+		fprintf(stderr, "Error: A tile cache can not be used with a frame buffer, dirty region, G-buffer or cost buffer\n");
+		return 1;
+	}
 
-	double pixelHeight = cameraHeight/imageHeight;
-	double pixelWidth = cameraWidth/imageWidth;
+	// A band has no dirty region of its own, it covers the full image
+	if (optionsRef->fullHeight > 0 && (optionsRef->firstRow < 0 || optionsRef->firstRow + imageHeight > optionsRef->fullHeight ||
+									   regionRef != NULL)) {
+		fprintf(stderr, "Error: Rows %i to %i of a %i row image can not be rendered as a band\n",
+				optionsRef->firstRow, optionsRef->firstRow + imageHeight, optionsRef->fullHeight);
+		return 1;
+	}
 
-	V3 rayDirection = {0, 0, 0}; // The direction of our ray
-    V3 point = {0, 0, 0}; // The point on the viewPlane that we intersect
+	if (frameBufferRef != NULL) {
+		// The pixels go straight to the frame buffer, the image only carries the size
+		if (frameBufferRef->width != (uint32_t) imageWidth || frameBufferRef->height != (uint32_t) imageHeight) {
+			fprintf(stderr, "Error: The frame buffer is %ux%u but a %ix%i render was requested\n",
+					frameBufferRef->width, frameBufferRef->height, imageWidth, imageHeight);
+			return 1;
+		}
+		frameImage.width = (uint32_t) imageWidth;
+		frameImage.height = (uint32_t) imageHeight;
+		frameImage.pixmapRef = NULL;
+		imageRef = &frameImage;
+	}
 
-	RGBAColor colorFound;
+	if (regionRef != NULL || rendererRef != NULL || frameBufferRef != NULL) {
+		// Only the dirty pixels are traced, the rest are kept from the previous render
+		if (regionRef != NULL && gbufferRef != NULL) {
+			fprintf(stderr, "Error: A G-buffer can not be captured while re-rendering a dirty region\n");
+			return 1;
+		}
+		if (imageRef->width != (uint32_t) imageWidth || imageRef->height != (uint32_t) imageHeight ||
+			(regionRef != NULL && (regionRef->width != (uint32_t) imageWidth || regionRef->height != (uint32_t) imageHeight))) {
+			fprintf(stderr, "Error: The previous render is %ux%u but a %ix%i render was requested\n",
+					imageRef->width, imageRef->height, imageWidth, imageHeight);
+			return 1;
+		}
+	}
+	else {
+		imageRef->width = (uint32_t) imageWidth;
+		imageRef->height= (uint32_t) imageHeight;
+		imageRef->pixmapRef = malloc(sizeof(RGBApixel) * imageWidth * imageHeight);
+		if (imageRef->pixmapRef == NULL) {
+			fprintf(stderr, "Error: Could not allocate an image of size %ix%i, try rendering it in bands with --band-rows\n",
+					imageWidth, imageHeight);
+			return 1;
+		}
+		ownedPixmapRef = imageRef->pixmapRef;
+	}
+
+	if ((gbufferRef != NULL && gbuffer_create(gbufferRef, imageWidth, imageHeight, sceneRef->primitivesLength) != 0) ||
+		(optionsRef->costRef != NULL && cost_buffer_create(optionsRef->costRef, imageWidth, imageHeight) != 0)) {
+		raycast_free_owned_pixmap(imageRef, ownedPixmapRef);
+		return 1;
+	}
+
+	RenderContext context;
+	RenderScratch localScratch;
+	RenderScratch *scratchRef = rendererRef != NULL ? &rendererRef->scratch : &localScratch;
+	context.sceneRef = sceneRef;
+	context.imageRef = imageRef;
+	context.optionsRef = optionsRef;
+	context.tilesX = (imageWidth + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+	context.tilesY = (imageHeight + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+	context.result = 0;
+	if (rendererRef != NULL)
+		context.topology = rendererRef->topology;
+	else if (numa_topology_load(&context.topology) != 0) {
+		raycast_free_owned_pixmap(imageRef, ownedPixmapRef);
+		return 1;
+	}
+
+	int threadsLength = optionsRef->threadsLength > 0 ? optionsRef->threadsLength :
+						rendererRef != NULL ? rendererRef->pool.threadsLength : context.topology.cpusLength;
+	if (threadsLength > context.tilesX * context.tilesY)
+		threadsLength = context.tilesX * context.tilesY;
+
+	// Every node gets a band of tile rows, threads are only pinned when there is more than one
+	context.nodesLength = context.topology.nodesLength < threadsLength ? context.topology.nodesLength : threadsLength;
+	if (context.nodesLength > context.tilesY)
+		context.nodesLength = context.tilesY;
+	context.isPinned = context.nodesLength > 1;
+	context.isReplicated = context.isPinned && scene_size(sceneRef) <= SCENE_REPLICATE_MAX_SIZE;
+	if (optionsRef->jobRef != NULL) {
+		optionsRef->jobRef->threadsLength = threadsLength;
+		atomic_store(&optionsRef->jobRef->tilesLength, context.tilesX * context.tilesY);
+	}
+
+	if (rendererRef == NULL)
+		memset(&localScratch, 0, sizeof(RenderScratch));
+	pthread_t *threads = rendererRef == NULL ? malloc(sizeof(pthread_t) * threadsLength) : NULL;
+	if (render_scratch_reserve(scratchRef, context.topology.nodesLength, context.tilesX * context.tilesY, threadsLength,
+							   sceneRef->primitivesLength) != 0 ||
+		(rendererRef == NULL && threads == NULL)) {
+		fprintf(stderr, "Error: Could not allocate the render threads\n");
+		context.result = 1;
+	}
+	context.queues = scratchRef->queues;
+	context.tileNodes = scratchRef->tileNodes;
+	RenderWorker *workers = scratchRef->workers;
+
+	// Hits are shaded by the kernel compiled for just the features the scene uses
+	context.features = scene_features(sceneRef);
+
+	// Every tile of the render is looked up under a key made from the scene and options once
+	context.tileCacheKey = optionsRef->tileCacheRef != NULL ?
+						   tile_cache_render_key(sceneRef, optionsRef, imageWidth, imageHeight) : 0;
 
-    point.data.Z = viewPlanePos.data.Z;
-	for (int y=0; y<imageHeight; y++) {
-        point.data.Y = -(viewPlanePos.data.Y - cameraHeight/2.0 + pixelHeight * (y + 0.5));
-		for (int x=0; x<imageWidth; x++) {
-            point.data.X = viewPlanePos.data.X - cameraWidth/2.0 + pixelWidth * (x + 0.5);
-			v3_normalize(&point, &rayDirection); // normalization, find the ray direction
-			shoot(&cameraPos, &rayDirection, sceneRef, &colorFound);
-			shade(&colorFound, &imageRef->pixmapRef[y*imageWidth + x]);
+	// With light samples a light tree picks the lights, otherwise tiles are shaded in shadow packets
+	// whenever there is a light to cast shadows
+	context.bounds = NULL;
+	context.lightTreeRef = NULL;
+	if (context.result == 0 && optionsRef->lightSamples > 0 && sceneRef->lightsLength > 0) {
+		if (scratchRef->lightTree == NULL)
+			scratchRef->lightTree = calloc(1, sizeof(LightTree));
+		if (scratchRef->lightTree == NULL)
+			fprintf(stderr, "Error: Could not allocate the light tree\n");
+		if (scratchRef->lightTree == NULL || light_tree_build(scratchRef->lightTree, sceneRef) != 0)
+			context.result = 1;
+		context.lightTreeRef = scratchRef->lightTree;
+	}
+	else if (context.result == 0 && sceneRef->lightsLength > 0 && sceneRef->primitivesLength > 0) {
+		primitive_bounds_calculate(sceneRef, scratchRef->bounds);
+		context.bounds = scratchRef->bounds;
+	}
+
+	// Each node allocates its queue, its copy of the scene and its band of the image from one of its cores
+	for (int i = 0; context.result == 0 && i < context.nodesLength; i++) {
+		workers[i].contextRef = &context;
+		workers[i].node = i;
+	}
+	if (context.result == 0 && rendererRef != NULL) {
+		if (context.isPinned)
+			thread_pool_run(&rendererRef->pool, raycast_node_thread, workers, sizeof(RenderWorker), context.nodesLength);
+		else
+			raycast_node_thread(&workers[0]);
+	}
+	else if (context.result == 0) {
+		for (int i = 0; i < context.nodesLength; i++) {
+			if (!context.isPinned || pthread_create(&threads[i], NULL, raycast_node_thread, &workers[i]) != 0)
+				threads[i] = pthread_self();
+		}
+		for (int i = 0; i < context.nodesLength; i++) {
+			if (pthread_equal(threads[i], pthread_self()))
+				raycast_node_thread(&workers[i]);
+			else
+				pthread_join(threads[i], NULL);
+		}
+	}
+
+	for (int i = 0; context.result == 0 && i < threadsLength; i++) {
+		workers[i].contextRef = &context;
+		workers[i].node = i % context.nodesLength;
+		workers[i].tilesStolen = 0;
+	}
+
+	// A renderer's threads do all of the work, otherwise without pinning the calling thread renders too
+	int threadsStarted = 0;
+	if (context.result == 0 && rendererRef != NULL) {
+		thread_pool_run(&rendererRef->pool, raycast_worker_thread, workers, sizeof(RenderWorker), threadsLength);
+		threadsStarted = threadsLength;
+	}
+	else {
+		for (int i = 0; context.result == 0 && i < threadsLength; i++) {
+			if (!context.isPinned && i == threadsLength - 1)
+				raycast_worker_thread(&workers[i]);
+			else if (pthread_create(&threads[threadsStarted], NULL, raycast_worker_thread, &workers[i]) == 0)
+				threadsStarted++;
+		}
+		for (int i = 0; i < threadsStarted; i++)
+			pthread_join(threads[i], NULL);
+	}
+
+	// Work stealing finishes the tiles of a node whose threads could not be started
+	if (context.result == 0 && threadsStarted == 0 && context.isPinned) {
+		context.isPinned = 0;
+		workers[0].tilesStolen = 0;
+		raycast_worker_thread(&workers[0]);
+	}
+
+	if (context.result == 0 && optionsRef->jobRef != NULL && atomic_load(&optionsRef->jobRef->isCancelled))
+		context.result = RENDER_CANCELLED;
+
+	if (context.result == 0 && optionsRef->statsRef != NULL)
+		raycast_stats(&context, workers, threadsLength, optionsRef->statsRef);
+
+	free(threads);
+	if (rendererRef == NULL) {
+		render_scratch_free(&localScratch);
+		numa_topology_free(&context.topology);
+	}
+
+	// A cancelled render keeps the tiles it finished
+	if (context.result != 0 && context.result != RENDER_CANCELLED)
+		raycast_free_owned_pixmap(imageRef, ownedPixmapRef);
+
+	return context.result;
+}
+
+/**
+ * Allocates space in the imageRef specified for an image the size of the G-buffer and re-shades
+ * every captured primary hit with the lights of the specified scene. No primary rays are traced,
+ * only the shadow rays towards each light and any reflection rays.
+ * @param sceneRef - The scene to take the lights from, its primitives must match the captured scene
+ * @param gbufferRef - The G-buffer captured by a previous call to raycast
+ * @param optionsRef - The options to render the reflections with
+ * @param imageRef - The output image to write to
+ * @return 0 if success, otherwise a failure occurred
+ */
+int relight(Scene *sceneRef, GBuffer *gbufferRef, RenderOptions *optionsRef, Image *imageRef) {
+	if (gbufferRef->primitivesLength != (uint32_t) sceneRef->primitivesLength) {
+		fprintf(stderr, "Error: G-buffer was captured from a scene with %u primitives, but the scene has %i\n",
+				gbufferRef->primitivesLength, sceneRef->primitivesLength);
+		return 1;
+	}
+
+	imageRef->width = gbufferRef->width;
+	imageRef->height = gbufferRef->height;
+	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * gbufferRef->width * gbufferRef->height);
+	if (imageRef->pixmapRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate an image of size %ux%u\n", gbufferRef->width, gbufferRef->height);
+		return 1;
+	}
+
+	if (optionsRef->costRef != NULL) {
+		if (cost_buffer_create(optionsRef->costRef, (int) gbufferRef->width, (int) gbufferRef->height) != 0) {
+			free(imageRef->pixmapRef);
+			imageRef->pixmapRef = NULL;
+			return 1;
+		}
+	}
+
+	RGBAColor colorFound;
+	V3 color;
+	V3 throughput = {1, 1, 1};
+	RayStack stack;
+	LightTree lightTree;
+	memset(&lightTree, 0, sizeof(LightTree));
+	ray_stack_init(&stack, optionsRef->maxDepth, optionsRef->rayBudget);
+	stack.areaLightSamples = optionsRef->areaLightSamples;
+	// The samples keep the specular colors of the scene they were captured from
+	stack.features = scene_features(sceneRef) | SCENE_FEATURE_SPECULAR;
+	stack.shadeKernel = shade_kernel_select(stack.features);
+	if (optionsRef->lightSamples > 0 && sceneRef->lightsLength > 0) {
+		if (light_tree_build(&lightTree, sceneRef) != 0) {
+			free(imageRef->pixmapRef);
+			imageRef->pixmapRef = NULL;
+			return 1;
 		}
+		stack.lightTreeRef = &lightTree;
+		stack.lightSamples = optionsRef->lightSamples;
 	}
 
+	for (size_t i = 0; i < (size_t) gbufferRef->width * gbufferRef->height; i++) {
+		ray_stack_reset(&stack, (uint32_t) i);
+		// The primary ray was paid for when the G-buffer was captured
+		stack.raysLeft--;
+		color.data.X = color.data.Y = color.data.Z = 0;
+		shade_hit(&gbufferRef->samplesRef[i], sceneRef, &stack, &throughput, 0, &color);
+		trace_stack(sceneRef, &stack, &color);
+		color_from_v3(&color, &colorFound);
+		shade(&colorFound, &imageRef->pixmapRef[i]);
+		if (optionsRef->costRef != NULL)
+			cost_buffer_store(optionsRef->costRef, &stack, i);
+	}
 
+	light_tree_free(&lightTree);
 	return 0;
 }
 
@@ -67,177 +994,1064 @@ int shade(RGBAColor* colorRef, RGBApixel *pixel) {
 }
 
 /**
- * Does the actual raytracing and sets the primitiveHit to a pointer to the primitive that was hit,
- * if any, when shooting the ray.
+ * Does the actual raytracing and finds the color along the ray, following reflections on the
+ * ray stack until it is empty or the pixel's ray budget is spent.
  * @param rayOriginRef - The origin of the ray
  * @param rayDirectionRef - The direction of the ray
  * @param sceneRef - A reference to the current scene
- * @param primitiveHit - A reference to a refrence of a primitive to set to the hit reference if a hit occurs
- * @return
+ * @param stackRef - The ray stack of the calling thread, reset for this pixel
+ * @param foundColor - The color found along the ray
+ * @param sampleRef - If not NULL, the primary hit sample is copied here
+ * @return 0 if success, otherwise a failure occurred
  */
-int shoot(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RGBAColor *foundColor) {
-	Primitive *primitiveRef;
-	Primitive *primitiveHitRef = NULL;
-	set_color(foundColor, 0, 0, 0, 1);
-	// Our current closest t value
-	double primitive_t = INFINITY;
-	// A possible t value replacement
-	double possible_t;
+int shoot(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RayStack *stackRef, RGBAColor *foundColor, GBufferSample *sampleRef) {
+	GBufferSample sample;
 
-	for (int i = 0; i < sceneRef->primitivesLength; i++) {
-		possible_t = INFINITY;
-		primitiveRef = sceneRef->primitives[i];
+	shoot_primary(rayOriginRef, rayDirectionRef, sceneRef, stackRef, &sample);
+	if (sampleRef != NULL)
+		*sampleRef = sample;
+	shoot_shade(&sample, sceneRef, stackRef, NULL, foundColor);
 
-		switch(primitiveRef->type) {
-			case PLANE_T:
-				possible_t = intersect_plane(&primitiveRef->data.plane, rayOriginRef, rayDirectionRef);
-				break;
-			case SPHERE_T:
-				possible_t = intersect_sphere(&primitiveRef->data.sphere, rayOriginRef, rayDirectionRef);
-				break;
-		}
-		// Set the new possible shadow
-		if (possible_t > 0 && possible_t < primitive_t) {
-			primitive_t = possible_t;
-			primitiveHitRef = primitiveRef;
-		}
-	}
-
-	if (primitiveHitRef != NULL) {
-		// Calculate our new rayOrigin
-		V3 color = {0.1, 0.1, 0.1};
-		// Light intensity
-		V3 I;
-
-		V3 newRayOrigin;
-		V3 newRayDirection;
-		v3_scale(rayDirectionRef, primitive_t, &newRayOrigin);
-		v3_add(rayOriginRef, &newRayOrigin, &newRayOrigin);
-		// Shadow test
-		for (int i = 0; i < sceneRef->lightsLength; i++) {
-			Light *lightRef;
-			lightRef = sceneRef->lights[i];
-			double light_t = INFINITY;
-			double light_distance = INFINITY;
-
-			// Figure out newRayDirection
-			switch (lightRef->type) {
-				case POINTLIGHT_T:
-					v3_subtract(&lightRef->data.pointLight.position, &newRayOrigin, &newRayDirection);
-					v3_normalize(&newRayDirection, &newRayDirection);
-					v3_distance(&lightRef->data.pointLight.position, &newRayOrigin, &light_distance);
-					v3_copy(&lightRef->data.pointLight.color, &I);
-					break;
-				case SPOTLIGHT_T:
-					v3_subtract(&lightRef->data.pointLight.position, &newRayOrigin, &newRayDirection);
-					v3_normalize(&newRayDirection, &newRayDirection);
-					v3_distance(&lightRef->data.pointLight.position, &newRayOrigin, &light_distance);
-					v3_copy(&lightRef->data.pointLight.color, &I);
-					break;
-			}
+	return 0;
+}
 
-			// See if this should be in shadow
-			for (int j = 0; j < sceneRef->primitivesLength; j++) {
-				possible_t = INFINITY;
-				primitiveRef = sceneRef->primitives[j];
+/**
+ * Traces the primary ray of shoot() and builds the sample of its closest hit
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene
+ * @param stackRef - The ray stack of the calling thread, reset for this pixel
+ * @param sampleRef - The hit sample is written here
+ */
+void shoot_primary(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RayStack *stackRef, GBufferSample *sampleRef) {
+	double primitive_t;
+	int childId;
 
-				// Skip the current object
-				if (primitiveRef == primitiveHitRef)
-					continue;
+	stackRef->raysLeft--;
+	sampleRef->primitiveId = intersect_closest(sceneRef, rayOriginRef, rayDirectionRef, GBUFFER_NO_HIT, GBUFFER_NO_HIT,
+											   &primitive_t, &childId, &stackRef->intersectionTests);
+	sampleRef->childId = childId;
+	if (sampleRef->primitiveId != GBUFFER_NO_HIT)
+		build_sample(sceneRef, rayOriginRef, rayDirectionRef, sampleRef->primitiveId, childId, primitive_t, sampleRef);
+}
 
-				switch(primitiveRef->type) {
-					case PLANE_T:
-						possible_t = intersect_plane(&primitiveRef->data.plane, &newRayOrigin, &newRayDirection);
-						break;
-					case SPHERE_T:
-						possible_t = intersect_sphere(&primitiveRef->data.sphere, &newRayOrigin, &newRayDirection);
-						break;
-				}
-				// Set the new possible shadow
-				if (possible_t > 0 && possible_t < light_distance) {
-					light_t = possible_t;
-					break;
-				}
-			}
+/**
+ * Shades a primary hit traced by shoot_primary() and follows its reflections
+ * @param sampleRef - The primary hit to shade
+ * @param sceneRef - A reference to the current scene
+ * @param stackRef - The ray stack of the calling thread, holding the work counted for the primary ray
+ * @param packetRef - The shadow packet of the hit's tile, or NULL to test every primitive for shadows
+ * @param foundColor - The color found along the ray
+ */
+void shoot_shade(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, ShadowPacket *packetRef, RGBAColor *foundColor) {
+	V3 color = {0, 0, 0};
+	V3 throughput = {1, 1, 1};
+
+	// The packet's occluder lists only hold for shadow rays leaving the tile's primary hits
+	stackRef->shadowPacketRef = packetRef;
+	shade_hit(sampleRef, sceneRef, stackRef, &throughput, 0, &color);
+	stackRef->shadowPacketRef = NULL;
+	trace_stack(sceneRef, stackRef, &color);
+	color_from_v3(&color, foundColor);
+}
+
+/**
+ * Pops rays off the ray stack until it is empty, adding the light found along each of them to color
+ * @param sceneRef - A reference to the current scene
+ * @param stackRef - The ray stack to drain
+ * @param color - The color to accumulate into
+ */
+void trace_stack(Scene *sceneRef, RayStack *stackRef, V3 *color) {
+	GBufferSample sample;
+	double primitive_t;
+	int childId;
+
+	while (stackRef->length > 0) {
+		RayStackEntry *entryRef = &stackRef->entries[--stackRef->length];
+
+		if (stackRef->raysLeft <= 0) {
+			stackRef->length = 0;
+			break;
+		}
+		stackRef->raysLeft--;
+
+		sample.primitiveId = intersect_closest(sceneRef, &entryRef->origin, &entryRef->direction,
+											   entryRef->ignoreId, entryRef->ignoreChildId, &primitive_t, &childId,
+											   &stackRef->intersectionTests);
+		if (sample.primitiveId == GBUFFER_NO_HIT)
+			continue;
+
+		// Copy out what we need, shading may push over this entry
+		V3 throughput = entryRef->throughput;
+		int depth = entryRef->depth;
+		build_sample(sceneRef, &entryRef->origin, &entryRef->direction, sample.primitiveId, childId, primitive_t, &sample);
+		shade_hit(&sample, sceneRef, stackRef, &throughput, depth, color);
+	}
+}
+
+/**
+ * The second half of shade_hit, adds the direct lighting of a hit whose shadow rays are already
+ * charged to color and pushes its reflection ray when shade_hit would.
+ * @param sampleRef - The hit that was shaded
+ * @param stackRef - The ray stack to push the reflection ray on
+ * @param throughput - The weight of this hit in the final pixel color
+ * @param depth - The number of reflections taken to reach this hit
+ * @param shadowRays - The shadow rays charged for shading a hit
+ * @param local - The unclamped direct lighting of the hit
+ * @param color - The color to accumulate into
+ */
+static void shade_hit_reflect(GBufferSample *sampleRef, RayStack *stackRef, V3 *throughput, int depth, int shadowRays,
+							  V3 *local, V3 *color) {
+	double reflectivity = sampleRef->reflectivity;
+	for (int i = 0; i < 3; i++)
+		color->array[i] += throughput->array[i] * (1 - reflectivity) * local->array[i];
+
+	if (reflectivity <= 0 || depth >= stackRef->maxDepth || stackRef->length >= RAY_STACK_SIZE)
+		return;
+
+	// The reflection needs its own ray plus its shadow rays if it hits something
+	if (stackRef->raysLeft < 1 + shadowRays)
+		return;
+
+	V3 childThroughput;
+	v3_scale(throughput, reflectivity, &childThroughput);
+
+	// Russian roulette, rays that can only add a little to the pixel are terminated early
+	// and the survivors are reweighted so the result stays unbiased
+	if (depth + 1 >= RUSSIAN_ROULETTE_DEPTH) {
+		double p = childThroughput.data.X;
+		if (childThroughput.data.Y > p)
+			p = childThroughput.data.Y;
+		if (childThroughput.data.Z > p)
+			p = childThroughput.data.Z;
+		if (p < RUSSIAN_ROULETTE_THRESHOLD) {
+			double survival = p / RUSSIAN_ROULETTE_THRESHOLD;
+			if (ray_stack_random(stackRef) >= survival)
+				return;
+			v3_scale(&childThroughput, 1 / survival, &childThroughput);
+		}
+	}
+
+	RayStackEntry *entryRef = &stackRef->entries[stackRef->length++];
+	v3_copy(&sampleRef->point, &entryRef->origin);
+	v3_reflect(&sampleRef->view, &sampleRef->normal, &entryRef->direction);
+	v3_copy(&childThroughput, &entryRef->throughput);
+	entryRef->depth = depth + 1;
+	entryRef->ignoreId = sampleRef->primitiveId;
+	entryRef->ignoreChildId = sampleRef->childId;
+}
+
+/**
+ * Adds the direct lighting of a hit weighted by its throughput to color and pushes the mirror
+ * reflection ray if the hit is reflective, the depth limit allows it, it survives russian
+ * roulette and the pixel has enough ray budget left to pay for it.
+ * @param sampleRef - The hit to shade, a miss adds nothing
+ * @param sceneRef - A reference to the current scene
+ * @param stackRef - The ray stack to push the reflection ray on
+ * @param throughput - The weight of this hit in the final pixel color
+ * @param depth - The number of reflections taken to reach this hit
+ * @param color - The color to accumulate into
+ */
+void shade_hit(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, V3 *throughput, int depth, V3 *color) {
+	V3 local;
+
+	if (sampleRef->primitiveId == GBUFFER_NO_HIT)
+		return;
+
+	// The shadow rays are always traced, they are only charged so the reflections stop sooner
+	int shadowRays = stackRef->lightTreeRef != NULL ? stackRef->lightSamples : sceneRef->lightsLength;
+	stackRef->raysLeft -= shadowRays;
+	stackRef->shadeKernel(sampleRef, sceneRef, stackRef, &local);
+	shade_hit_reflect(sampleRef, stackRef, throughput, depth, shadowRays, &local, color);
+}
+
+/**
+ * Finds the closest primitive along a ray
+ * @param sceneRef - A reference to the current scene
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param ignoreId - The id of a primitive to skip, usually the one the ray starts on, or GBUFFER_NO_HIT
+ * @param ignoreChildId - If the ignored primitive has children, only this child is skipped
+ * @param tRef - The distance to the closest hit is written here
+ * @param childIdRef - The child hit within an instance or mesh is written here, otherwise GBUFFER_NO_HIT
+ * @param testsRef - The number of intersection tests made is added to this counter
+ * @return The id of the primitive hit, or GBUFFER_NO_HIT
+ */
+int intersect_closest(Scene *sceneRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreId, int ignoreChildId, double *tRef, int *childIdRef, uint32_t *testsRef) {
+	int primitiveHitId = GBUFFER_NO_HIT;
+	int childHitId = GBUFFER_NO_HIT;
+	// Our current closest t value
+	double primitive_t = INFINITY;
+	// A possible t value replacement
+	double possible_t;
+	int childId;
+	int id = 0;
+	// The ignored sphere or plane is the only one not tested
+	uint32_t tests = sceneRef->spheresLength + sceneRef->planesLength - (ignoreId >= 0 && ignoreId < sceneRef->spheresLength + sceneRef->planesLength);
+
+	for (int i = 0; i < sceneRef->spheresLength; i++, id++) {
+		if (id == ignoreId)
+			continue;
+
+		possible_t = intersect_sphere(&sceneRef->spheres[i], rayOriginRef, rayDirectionRef);
+		if (possible_t > 0 && possible_t < primitive_t) {
+			primitive_t = possible_t;
+			primitiveHitId = id;
+			childHitId = GBUFFER_NO_HIT;
+		}
+	}
+
+	for (int i = 0; i < sceneRef->planesLength; i++, id++) {
+		if (id == ignoreId)
+			continue;
+
+		possible_t = intersect_plane(&sceneRef->planes[i], rayOriginRef, rayDirectionRef);
+		if (possible_t > 0 && possible_t < primitive_t) {
+			primitive_t = possible_t;
+			primitiveHitId = id;
+			childHitId = GBUFFER_NO_HIT;
+		}
+	}
+
+	// Instances and meshes are never skipped entirely, only the child the ray starts on
+	for (int i = 0; i < sceneRef->instancesLength; i++, id++) {
+		possible_t = intersect_instance(sceneRef, &sceneRef->instances[i], rayOriginRef, rayDirectionRef,
+										id == ignoreId ? ignoreChildId : GBUFFER_NO_HIT, &childId, &tests);
+		if (possible_t > 0 && possible_t < primitive_t) {
+			primitive_t = possible_t;
+			primitiveHitId = id;
+			childHitId = childId;
+		}
+	}
+
+	for (int i = 0; i < sceneRef->meshesLength; i++, id++) {
+		possible_t = intersect_mesh(&sceneRef->meshes[i].mesh, rayOriginRef, rayDirectionRef,
+									id == ignoreId ? ignoreChildId : GBUFFER_NO_HIT, &childId, &tests);
+		if (possible_t > 0 && possible_t < primitive_t) {
+			primitive_t = possible_t;
+			primitiveHitId = id;
+			childHitId = childId;
+		}
+	}
+
+	*tRef = primitive_t;
+	*childIdRef = childHitId;
+	*testsRef += tests;
+	return primitiveHitId;
+}
 
-			if (light_t != INFINITY)
-				// Our light is in shadow
+/**
+ * Determine if anything lies along a ray before a distance, used for shadow rays where the
+ * first hit found is enough
+ * @param sceneRef - A reference to the current scene
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param maxT - Hits at or beyond this distance are ignored
+ * @param ignoreId - The id of a primitive to skip, usually the one the ray starts on, or GBUFFER_NO_HIT
+ * @param ignoreChildId - If the ignored primitive has children, only this child is skipped
+ * @param testsRef - The number of intersection tests made is added to this counter
+ * @return 1 if the ray is blocked, otherwise 0
+ */
+int intersect_any(Scene *sceneRef, V3 *rayOriginRef, V3 *rayDirectionRef, double maxT, int ignoreId, int ignoreChildId, uint32_t *testsRef) {
+	double possible_t;
+	int childId;
+	int id = 0;
+
+	for (int i = 0; i < sceneRef->spheresLength; i++, id++) {
+		if (id == ignoreId)
+			continue;
+
+		(*testsRef)++;
+		possible_t = intersect_sphere(&sceneRef->spheres[i], rayOriginRef, rayDirectionRef);
+		if (possible_t > 0 && possible_t < maxT)
+			return 1;
+	}
+
+	for (int i = 0; i < sceneRef->planesLength; i++, id++) {
+		if (id == ignoreId)
+			continue;
+
+		(*testsRef)++;
+		possible_t = intersect_plane(&sceneRef->planes[i], rayOriginRef, rayDirectionRef);
+		if (possible_t > 0 && possible_t < maxT)
+			return 1;
+	}
+
+	for (int i = 0; i < sceneRef->instancesLength; i++, id++) {
+		possible_t = intersect_instance(sceneRef, &sceneRef->instances[i], rayOriginRef, rayDirectionRef,
+										id == ignoreId ? ignoreChildId : GBUFFER_NO_HIT, &childId, testsRef);
+		if (possible_t > 0 && possible_t < maxT)
+			return 1;
+	}
+
+	for (int i = 0; i < sceneRef->meshesLength; i++, id++) {
+		possible_t = intersect_mesh(&sceneRef->meshes[i].mesh, rayOriginRef, rayDirectionRef,
+									id == ignoreId ? ignoreChildId : GBUFFER_NO_HIT, &childId, testsRef);
+		if (possible_t > 0 && possible_t < maxT)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * The body of intersect_any_of, always inlined so each shading kernel gets a copy specialised for
+ * its features. Without SCENE_FEATURE_CHILDREN every id is a sphere or a plane.
+ */
+static inline __attribute__((always_inline)) int intersect_any_of_kernel(Scene *sceneRef, int *ids, int idsLength,
+					 V3 *rayOriginRef, V3 *rayDirectionRef, double maxT, int ignoreId, int ignoreChildId, uint32_t *testsRef,
+					 int features) {
+	double possible_t = INFINITY;
+	int childId;
+	int index;
+
+	for (int i = 0; i < idsLength; i++) {
+		int id = ids[i];
+		if (!(features & SCENE_FEATURE_CHILDREN)) {
+			if (id == ignoreId)
 				continue;
+			(*testsRef)++;
+			possible_t = id < sceneRef->spheresLength ?
+						 intersect_sphere(&sceneRef->spheres[id], rayOriginRef, rayDirectionRef) :
+						 intersect_plane(&sceneRef->planes[id - sceneRef->spheresLength], rayOriginRef, rayDirectionRef);
+			if (possible_t > 0 && possible_t < maxT)
+				return 1;
+			continue;
+		}
+		switch (scene_primitive_type(sceneRef, id, &index)) {
+			case SPHERE_T:
+				if (id == ignoreId)
+					continue;
+				(*testsRef)++;
+				possible_t = intersect_sphere(&sceneRef->spheres[index], rayOriginRef, rayDirectionRef);
+				break;
+			case PLANE_T:
+				if (id == ignoreId)
+					continue;
+				(*testsRef)++;
+				possible_t = intersect_plane(&sceneRef->planes[index], rayOriginRef, rayDirectionRef);
+				break;
+			case INSTANCE_T:
+				possible_t = intersect_instance(sceneRef, &sceneRef->instances[index], rayOriginRef, rayDirectionRef,
+												id == ignoreId ? ignoreChildId : GBUFFER_NO_HIT, &childId, testsRef);
+				break;
+			case MESH_T:
+				possible_t = intersect_mesh(&sceneRef->meshes[index].mesh, rayOriginRef, rayDirectionRef,
+											id == ignoreId ? ignoreChildId : GBUFFER_NO_HIT, &childId, testsRef);
+				break;
+		}
+		if (possible_t > 0 && possible_t < maxT)
+			return 1;
+	}
 
-			// Light_position - newRayOrigin;
-			V3 L;
-			// Reflection of L
-			V3 R;
-			// RayDirection
-			V3 V;
-			// Normal
-			V3 N;
-			// Primitive diffuse color
-			V3 KD;
-			// Primitive specular color
-			V3 KS;
-
-			// Calculate L
-			v3_subtract(&sceneRef->lights[i]->data.pointLight.position, &newRayOrigin, &L);
-			v3_normalize(&L, &L);
-
-			// Calculate R
-			v3_reflect(&L, &N, &R);
-
-			// Calculate V
-			v3_copy(rayDirectionRef, &V);
-			v3_normalize(&V, &V);
-
-			switch(primitiveHitRef->type) {
-				case PLANE_T:
-					// Calculate N
-					v3_copy(&primitiveHitRef->data.plane.normal, &N);
-					// Calculate KD
-					v3_copy(&primitiveHitRef->data.plane.diffuseColor, &KD);
-					// Calculate KS
-					v3_copy(&primitiveHitRef->data.plane.specularColor, &KS);
-					break;
-
-				case SPHERE_T:
-					// Calculate N
-					v3_subtract(&newRayOrigin, &primitiveHitRef->data.sphere.position, &N);
-					v3_normalize(&N, &N);
-
-					// Calculate KD
-					v3_copy(&primitiveHitRef->data.sphere.diffuseColor, &KD);
-					// Calculate KS
-					v3_copy(&primitiveHitRef->data.sphere.specularColor, &KS);
-					break;
+	return 0;
+}
+
+/**
+ * Determine if a ray is blocked by one of a list of primitives before it travels maxT, the same
+ * test as intersect_any restricted to the listed ids
+ * @param sceneRef - A reference to the current scene
+ * @param ids - The ids of the primitives to test, in increasing order
+ * @param idsLength - The number of ids
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param maxT - Hits at or beyond this distance are ignored
+ * @param ignoreId - The id of a primitive to skip, usually the one the ray starts on, or GBUFFER_NO_HIT
+ * @param ignoreChildId - If the ignored primitive has children, only this child is skipped
+ * @param testsRef - The number of intersection tests made is added to this counter
+ * @return 1 if the ray is blocked, otherwise 0
+ */
+int intersect_any_of(Scene *sceneRef, int *ids, int idsLength, V3 *rayOriginRef, V3 *rayDirectionRef, double maxT,
+					 int ignoreId, int ignoreChildId, uint32_t *testsRef) {
+	return intersect_any_of_kernel(sceneRef, ids, idsLength, rayOriginRef, rayDirectionRef, maxT, ignoreId, ignoreChildId,
+								   testsRef, SCENE_FEATURE_ALL);
+}
+
+/**
+ * Intersects a ray with a primitive of a group
+ * @param primitiveRef - The sphere or plane to check
+ * @param rayOriginRef - The ray origin
+ * @param rayDirectionRef - The ray direction
+ * @return The hit distance between the rayOrigin and the primitive along the rayDirection, if positive. Otherwise INFINITY.
+ */
+double intersect_primitive(Primitive *primitiveRef, V3 *rayOriginRef, V3 *rayDirectionRef) {
+	switch(primitiveRef->type) {
+		case PLANE_T:
+			return intersect_plane(&primitiveRef->data.plane, rayOriginRef, rayDirectionRef);
+		case SPHERE_T:
+			return intersect_sphere(&primitiveRef->data.sphere, rayOriginRef, rayDirectionRef);
+		case INSTANCE_T:
+		case MESH_T:
+			// Groups can only contain spheres and planes
+			break;
+	}
+
+	return INFINITY;
+}
+
+/**
+ * Instance intersection test, the ray is moved into the group's space and tested against the
+ * group's primitives there
+ * @param sceneRef - A reference to the current scene
+ * @param instanceRef - The instance to check
+ * @param rayOriginRef - The ray origin
+ * @param rayDirectionRef - The ray direction
+ * @param ignoreChildId - A primitive of the group to skip, or GBUFFER_NO_HIT
+ * @param childIdRef - The primitive of the group hit is written here
+ * @param testsRef - The number of intersection tests made, the bound included, is added to this counter
+ * @return The hit distance between the rayOrigin and the instance along the rayDirection, if positive. Otherwise INFINITY.
+ */
+double intersect_instance(Scene *sceneRef, Instance *instanceRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreChildId, int *childIdRef, uint32_t *testsRef) {
+	Group *groupRef = &sceneRef->groups[instanceRef->groupId];
+	V3 origin;
+	V3 direction;
+	double scale;
+
+	a3_transform_point(&instanceRef->worldToObject, rayOriginRef, &origin);
+	a3_transform_vector(&instanceRef->worldToObject, rayDirectionRef, &direction);
+
+	// The intersection tests expect a unit direction, distances found along it are
+	// converted back to world distances by dividing by the direction's scale
+	v3_magnitude(&direction, &scale);
+	v3_scale(&direction, 1 / scale, &direction);
+
+	if (groupRef->boundRadius != INFINITY) {
+		Sphere bound;
+		v3_copy(&groupRef->boundCenter, &bound.position);
+		bound.radius = groupRef->boundRadius;
+		(*testsRef)++;
+		if (intersect_sphere(&bound, &origin, &direction) == INFINITY)
+			return INFINITY;
+	}
+
+	*testsRef += groupRef->primitivesLength - (ignoreChildId >= 0 && ignoreChildId < groupRef->primitivesLength);
+
+	double primitive_t = INFINITY;
+	double possible_t;
+
+	for (int i = 0; i < groupRef->primitivesLength; i++) {
+		if (i == ignoreChildId)
+			continue;
+
+		possible_t = intersect_primitive(&groupRef->primitives[i], &origin, &direction);
+
+		if (possible_t > 0 && possible_t < primitive_t) {
+			primitive_t = possible_t;
+			*childIdRef = i;
+		}
+	}
+
+	if (primitive_t == INFINITY)
+		return INFINITY;
+
+	return primitive_t / scale;
+}
+
+/**
+ * Fills in a hit sample for a ray that hit a primitive
+ * @param sceneRef - A reference to the current scene
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param primitiveId - The id of the primitive that was hit
+ * @param childId - The child hit within an instance or mesh, or GBUFFER_NO_HIT
+ * @param t - The distance along the ray to the hit
+ * @param sampleRef - The sample to fill in
+ */
+void build_sample(Scene *sceneRef, V3 *rayOriginRef, V3 *rayDirectionRef, int primitiveId, int childId, double t, GBufferSample *sampleRef) {
+	int index;
+	sampleRef->primitiveId = primitiveId;
+	sampleRef->childId = childId;
+
+	// Calculate the hit point
+	v3_scale(rayDirectionRef, t, &sampleRef->point);
+	v3_add(rayOriginRef, &sampleRef->point, &sampleRef->point);
+
+	// Calculate V
+	v3_copy(rayDirectionRef, &sampleRef->view);
+	v3_normalize(&sampleRef->view, &sampleRef->view);
+
+	switch (scene_primitive_type(sceneRef, primitiveId, &index)) {
+		case SPHERE_T:
+			sphere_surface(&sceneRef->spheres[index], &sampleRef->point, sampleRef);
+			break;
+
+		case PLANE_T:
+			plane_surface(&sceneRef->planes[index], sampleRef);
+			break;
+
+		case INSTANCE_T: {
+			Instance *instanceRef = &sceneRef->instances[index];
+			V3 point;
+			V3 normal;
+
+			// Find the surface in the group's space and bring the normal back out
+			a3_transform_point(&instanceRef->worldToObject, &sampleRef->point, &point);
+			primitive_surface(&sceneRef->groups[instanceRef->groupId].primitives[childId], &point, sampleRef);
+			a3_transform_normal(&instanceRef->worldToObject, &sampleRef->normal, &normal);
+			v3_normalize(&normal, &sampleRef->normal);
+			break;
+		}
+
+		case MESH_T: {
+			TriangleMesh *meshRef = &sceneRef->meshes[index];
+			double facing;
+
+			// Calculate N, facing the ray since OBJ winding is not reliable
+			mesh_triangle_normal(&meshRef->mesh, childId, &sampleRef->normal);
+			v3_dot(&sampleRef->normal, &sampleRef->view, &facing);
+			if (facing > 0)
+				v3_scale(&sampleRef->normal, -1, &sampleRef->normal);
+			// Calculate KD
+			v3_copy(&meshRef->diffuseColor, &sampleRef->diffuseColor);
+			// Calculate KS
+			v3_copy(&meshRef->specularColor, &sampleRef->specularColor);
+			sampleRef->reflectivity = meshRef->reflectivity;
+			break;
+		}
+	}
+}
+
+/**
+ * Fills in the normal and material of a hit sample for a sphere or plane of a group
+ * @param primitiveRef - The sphere or plane that was hit
+ * @param pointRef - The hit point, in the same space as the primitive
+ * @param sampleRef - The sample to fill in
+ */
+void primitive_surface(Primitive *primitiveRef, V3 *pointRef, GBufferSample *sampleRef) {
+	switch(primitiveRef->type) {
+		case PLANE_T:
+			plane_surface(&primitiveRef->data.plane, sampleRef);
+			break;
+
+		case SPHERE_T:
+			sphere_surface(&primitiveRef->data.sphere, pointRef, sampleRef);
+			break;
+
+		case INSTANCE_T:
+		case MESH_T:
+			// Groups can only contain spheres and planes
+			break;
+	}
+}
+
+/**
+ * Fills in the normal and material of a hit sample for a sphere
+ * @param sphereRef - The sphere that was hit
+ * @param pointRef - The hit point, in the same space as the sphere
+ * @param sampleRef - The sample to fill in
+ */
+void sphere_surface(Sphere *sphereRef, V3 *pointRef, GBufferSample *sampleRef) {
+	// Calculate N
+	v3_subtract(pointRef, &sphereRef->position, &sampleRef->normal);
+	v3_normalize(&sampleRef->normal, &sampleRef->normal);
+	// Calculate KD
+	v3_copy(&sphereRef->diffuseColor, &sampleRef->diffuseColor);
+	// Calculate KS
+	v3_copy(&sphereRef->specularColor, &sampleRef->specularColor);
+	sampleRef->reflectivity = sphereRef->reflectivity;
+}
+
+/**
+ * Fills in the normal and material of a hit sample for a plane
+ * @param planeRef - The plane that was hit
+ * @param sampleRef - The sample to fill in
+ */
+void plane_surface(Plane *planeRef, GBufferSample *sampleRef) {
+	// Calculate N
+	v3_copy(&planeRef->normal, &sampleRef->normal);
+	// Calculate KD
+	v3_copy(&planeRef->diffuseColor, &sampleRef->diffuseColor);
+	// Calculate KS
+	v3_copy(&planeRef->specularColor, &sampleRef->specularColor);
+	sampleRef->reflectivity = planeRef->reflectivity;
+}
+
+/**
+ * Finds two edges spanning an area light as seen from a point. A rectangle is spanned by its own
+ * edges, a sphere by the radii of the disk it shows the point, at right angles to the direction to it.
+ * @param areaLightRef - The light to span
+ * @param fromRef - The point the light is seen from
+ * @param aRef - The first edge is written here
+ * @param bRef - The second edge is written here
+ */
+static void area_light_frame(AreaLight *areaLightRef, V3 *fromRef, V3 *aRef, V3 *bRef) {
+	if (areaLightRef->shape == AREA_RECTANGLE_T) {
+		*aRef = areaLightRef->edgeU;
+		*bRef = areaLightRef->edgeV;
+		return;
+	}
+
+	V3 w, axis = {1, 0, 0};
+	double length;
+	v3_subtract(fromRef, &areaLightRef->position, &w);
+	v3_magnitude(&w, &length);
+	if (length == 0)
+		w.data.X = w.data.Y = 0, w.data.Z = length = 1;
+	v3_scale(&w, 1 / length, &w);
+	if (fabs(w.data.X) > 0.9)
+		axis.data.X = 0, axis.data.Y = 1;
+	v3_cross(&w, &axis, aRef);
+	v3_normalize(aRef, aRef);
+	v3_cross(&w, aRef, bRef);
+	v3_scale(aRef, areaLightRef->radius, aRef);
+	v3_scale(bRef, areaLightRef->radius, bRef);
+}
+
+/**
+ * Traces a shadow ray from a hit to a jittered point in each cell of a strata by strata grid over
+ * an area light
+ * @param sampleRef - The hit the shadow rays start from
+ * @param sceneRef - A reference to the current scene
+ * @param stackRef - The ray stack of the calling thread, its random numbers jitter the points
+ * @param areaLightRef - The light to sample
+ * @param aRef - The first edge spanning the light
+ * @param bRef - The second edge spanning the light
+ * @param strata - The number of cells along each edge
+ * @return The number of points the hit sees
+ */
+static int area_light_trace(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, AreaLight *areaLightRef,
+							V3 *aRef, V3 *bRef, int strata) {
+	int visible = 0;
+
+	for (int i = 0; i < strata; i++) {
+		for (int j = 0; j < strata; j++) {
+			double s = (i + ray_stack_random(stackRef)) / strata;
+			double t = (j + ray_stack_random(stackRef)) / strata;
+			V3 point = areaLightRef->position;
+			V3 direction;
+			double distance;
+
+			// A rectangle is covered evenly, a disk by rings of equal area
+			if (areaLightRef->shape == AREA_RECTANGLE_T) {
+				for (int k = 0; k < 3; k++)
+					point.array[k] += (s - 0.5) * aRef->array[k] + (t - 0.5) * bRef->array[k];
 			}
+			else {
+				double radius = sqrt(s), angle = 2 * M_PI * t;
+				for (int k = 0; k < 3; k++)
+					point.array[k] += radius * (cos(angle) * aRef->array[k] + sin(angle) * bRef->array[k]);
+			}
+
+			v3_subtract(&point, &sampleRef->point, &direction);
+			v3_magnitude(&direction, &distance);
+			if (distance == 0) {
+				visible++;
+				continue;
+			}
+			v3_scale(&direction, 1 / distance, &direction);
+			stackRef->shadowRays++;
+			if (!intersect_any(sceneRef, &sampleRef->point, &direction, distance,
+							   sampleRef->primitiveId, sampleRef->childId, &stackRef->intersectionTests))
+				visible++;
+		}
+	}
+	return visible;
+}
+
+/**
+ * Estimates how much of an area light a hit sees. A few stratified probe rays classify the hit as
+ * fully lit, fully shadowed or in penumbra, and only a hit in penumbra traces up to the
+ * areaLightSamples rays of the stack. The one ray already charged for the light is always traced,
+ * the probes and penumbra rays only as far as the ray budget left allows.
+ * @param sampleRef - The hit to test
+ * @param sceneRef - A reference to the current scene
+ * @param stackRef - The ray stack of the calling thread
+ * @param areaLightRef - The light to test
+ * @return The fraction of the light the hit sees, between 0 and 1
+ */
+static double area_light_visibility(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, AreaLight *areaLightRef) {
+	int probes = AREA_LIGHT_PROBE_STRATA * AREA_LIGHT_PROBE_STRATA;
+	int strata = (int) sqrt((double) stackRef->areaLightSamples);
+	V3 a, b;
+
+	area_light_frame(areaLightRef, &sampleRef->point, &a, &b);
+	if (stackRef->raysLeft < probes - 1)
+		return area_light_trace(sampleRef, sceneRef, stackRef, areaLightRef, &a, &b, 1);
+	int visible = area_light_trace(sampleRef, sceneRef, stackRef, areaLightRef, &a, &b, AREA_LIGHT_PROBE_STRATA);
+	stackRef->raysLeft -= probes - 1;
+
+	// The penumbra is sampled with as many of its rays as the budget has left
+	if (strata * strata > stackRef->raysLeft)
+		strata = stackRef->raysLeft > 0 ? (int) sqrt((double) stackRef->raysLeft) : 0;
+	if (visible == 0 || visible == probes || strata <= AREA_LIGHT_PROBE_STRATA)
+		return (double) visible / probes;
+
+	// In penumbra, the probes only told us that
+	visible = area_light_trace(sampleRef, sceneRef, stackRef, areaLightRef, &a, &b, strata);
+	stackRef->raysLeft -= strata * strata;
+	return (double) visible / (strata * strata);
+}
+
+/**
+ * Finds what a light that reaches a hit adds to it, the Phong terms of shade_light
+ * @param sampleRef - The hit to shade
+ * @param lightRef - The light
+ * @param directionRef - The unit direction from the hit to the light
+ * @param distance - The distance from the hit to the light
+ * @param visible - The fraction of the light the hit sees
+ * @param contributionRef - The unclamped color the light adds is written here
+ * @param features - The SceneFeature_t flags the kernel handles, a constant in every kernel
+ */
+static inline __attribute__((always_inline)) void shade_light_direct(GBufferSample *sampleRef, Light *lightRef,
+																	 V3 *directionRef, double distance, double visible,
+																	 V3 *contributionRef, int features) {
+	// Light intensity
+	V3 *I = &lightRef->data.pointLight.color;
+	// Light_position - hit point;
+	V3 L;
+
+	// Calculate L
+	v3_subtract(&lightRef->data.pointLight.position, &sampleRef->point, &L);
+	v3_normalize(&L, &L);
+
+	double frad;
+	double fang = 1;
+	// Get diffuse color contribution
+	calculate_diffuse(&sampleRef->normal, &L, &sampleRef->diffuseColor, I, contributionRef);
+	// Get specular color contribution, it is always black in a scene without specular colors
+	if (features & SCENE_FEATURE_SPECULAR) {
+		// Reflection of L
+		V3 R;
+		V3 specular;
+		v3_reflect(&L, &sampleRef->normal, &R);
+		calculate_specular(&sampleRef->view, &R, &sampleRef->specularColor, I, &sampleRef->normal, &L, &specular);
+		v3_add(contributionRef, &specular, contributionRef);
+	}
+	calculate_frad(lightRef, distance, &frad);
+	if (features & SCENE_FEATURE_SPOT_LIGHTS)
+		calculate_fang(lightRef, directionRef, &fang);
+	v3_scale(contributionRef, frad * fang * visible, contributionRef);
+}
+
+/**
+ * Finds what one light adds to a hit, nothing if the light is in shadow. Always inlined into the
+ * shading kernels, the work for the features the kernel was compiled without is left out.
+ * @param sampleRef - The hit to shade
+ * @param sceneRef - A reference to the current scene
+ * @param stackRef - The ray stack of the calling thread, the shadow ray and light shaded are counted on it
+ * @param lightIndex - The index of the light in the scene
+ * @param contributionRef - The unclamped color the light adds is written here when it is not in shadow
+ * @param features - The SceneFeature_t flags the kernel handles, a constant in every kernel
+ * @return 1 if the light reaches the hit, otherwise 0
+ */
+static inline __attribute__((always_inline)) int shade_light(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef,
+															 int lightIndex, V3 *contributionRef, int features) {
+	Light *lightRef = &sceneRef->lights[lightIndex];
+	double light_distance;
+	V3 newRayDirection;
+
+	// Figure out newRayDirection, every light is read as a point light
+	v3_subtract(&lightRef->data.pointLight.position, &sampleRef->point, &newRayDirection);
+	v3_normalize(&newRayDirection, &newRayDirection);
+	v3_distance(&lightRef->data.pointLight.position, &sampleRef->point, &light_distance);
 
-			V3 lightContribution = {0, 0, 0};
-			V3 diffuse;
-			V3 specular;
-			double frad;
-			double fang;
-			// Get diffuse color contribution
-			calculate_diffuse(&N, &L, &KD, &I, &diffuse);
-			// Get specular color contribution
-			calculate_specular(&V, &R, &KS, &I, &N, &L, &specular);
-			calculate_frad(lightRef, light_distance, &frad);
-			calculate_fang(lightRef, &newRayDirection, &fang);
-			v3_add(&diffuse, &specular, &lightContribution);
-			v3_scale(&lightContribution, frad * fang, &lightContribution);
-			color.array[0] += lightContribution.array[0];
-			color.array[1] += lightContribution.array[1];
-			color.array[2] += lightContribution.array[2];
-		}
-
-		// Figure out lighting
-		foundColor->data.R = (uint8_t) (clamp(color.array[0])*255);
-		foundColor->data.G = (uint8_t) (clamp(color.array[1])*255);
-		foundColor->data.B = (uint8_t) (clamp(color.array[2])*255);
-		foundColor->data.A = 1;
+	// See if this should be in shadow, skipping the current object or for instances and
+	// meshes only the part that was hit. With a shadow packet only the primitives listed for
+	// the light are tested, and none at all when nothing can shadow the tile from it. An area
+	// light is shaded as a point light at its center, dimmed by the fraction of it the hit sees.
+	ShadowPacket *packetRef = stackRef->shadowPacketRef;
+	double visible = 1;
+	if ((features & SCENE_FEATURE_AREA_LIGHTS) && lightRef->type == AREALIGHT_T) {
+		visible = area_light_visibility(sampleRef, sceneRef, stackRef, &lightRef->data.areaLight);
+		if (visible == 0)
+			return 0;
+	}
+	else if (packetRef == NULL) {
+		stackRef->shadowRays++;
+		if (intersect_any(sceneRef, &sampleRef->point, &newRayDirection, light_distance,
+						  sampleRef->primitiveId, sampleRef->childId, &stackRef->intersectionTests))
+			// Our light is in shadow
+			return 0;
+	}
+	else if (packetRef->occludersLength[lightIndex] > 0) {
+		stackRef->shadowRays++;
+		if (intersect_any_of_kernel(sceneRef, &packetRef->occluders[(size_t) lightIndex * packetRef->primitivesCapacity],
+									packetRef->occludersLength[lightIndex], &sampleRef->point, &newRayDirection, light_distance,
+									sampleRef->primitiveId, sampleRef->childId, &stackRef->intersectionTests, features))
+			return 0;
+	}
+	stackRef->lightsShaded++;
+	shade_light_direct(sampleRef, lightRef, &newRayDirection, light_distance, visible, contributionRef, features);
+	return 1;
+}
+
+/**
+ * The body of shade_sample, always inlined so a copy can be compiled for every set of features
+ * @param features - The SceneFeature_t flags the kernel handles, a constant in every kernel
+ */
+static inline __attribute__((always_inline)) int shade_sample_kernel(GBufferSample *sampleRef, Scene *sceneRef,
+																	 RayStack *stackRef, V3 *color, int features) {
+	V3 lightContribution;
+
+	color->data.X = color->data.Y = color->data.Z = 0;
+
+	if (sampleRef->primitiveId == GBUFFER_NO_HIT)
+		return 0;
+
+	color->data.X = color->data.Y = color->data.Z = 0.1;
+
+	if (stackRef->lightTreeRef != NULL) {
+		for (int i = 0; i < stackRef->lightSamples; i++) {
+			double probability;
+			int light = light_tree_sample(stackRef->lightTreeRef, &sampleRef->point, stackRef, &probability);
+			if (light < 0)
+				break;
+			if (!shade_light(sampleRef, sceneRef, stackRef, light, &lightContribution, features))
+				continue;
+			double weight = 1 / (probability * stackRef->lightSamples);
+			for (int j = 0; j < 3; j++)
+				color->array[j] += lightContribution.array[j] * weight;
+		}
+		return 0;
+	}
+
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		if (!shade_light(sampleRef, sceneRef, stackRef, i, &lightContribution, features))
+			continue;
+		color->array[0] += lightContribution.array[0];
+		color->array[1] += lightContribution.array[1];
+		color->array[2] += lightContribution.array[2];
 	}
 
 	return 0;
 }
 
+/**
+ * Runs the shadow and lighting part of shoot() for a single hit sample. With a light tree on the
+ * stack only its samples are shaded, each weighted by one over its probability and the number of samples.
+ * This kernel handles every feature, shade_kernel_select finds a faster one for a given scene.
+ * @param sampleRef - The hit to shade, a miss is shaded black
+ * @param sceneRef - A reference to the current scene, the lights to shade with are taken from here
+ * @param stackRef - The ray stack of the calling thread, the shadow rays and lights shaded are counted on it
+ * @param color - The resulting unclamped color
+ * @return 0 if success, otherwise a failure occurred
+ */
+int shade_sample(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, V3 *color) {
+	return shade_sample_kernel(sampleRef, sceneRef, stackRef, color, SCENE_FEATURE_ALL);
+}
+
+// Compiles shade_sample for one set of SceneFeature_t flags
+#define SHADE_KERNEL(features) \
+	static int shade_sample_##features(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, V3 *color) { \
+		return shade_sample_kernel(sampleRef, sceneRef, stackRef, color, features); \
+	}
+
+SHADE_KERNEL(0)
+SHADE_KERNEL(1)
+SHADE_KERNEL(2)
+SHADE_KERNEL(3)
+SHADE_KERNEL(4)
+SHADE_KERNEL(5)
+SHADE_KERNEL(6)
+SHADE_KERNEL(7)
+SHADE_KERNEL(8)
+SHADE_KERNEL(9)
+SHADE_KERNEL(10)
+SHADE_KERNEL(11)
+SHADE_KERNEL(12)
+SHADE_KERNEL(13)
+SHADE_KERNEL(14)
+
+static const ShadeKernel shadeKernels[SCENE_FEATURE_ALL + 1] = {
+	shade_sample_0, shade_sample_1, shade_sample_2, shade_sample_3,
+	shade_sample_4, shade_sample_5, shade_sample_6, shade_sample_7,
+	shade_sample_8, shade_sample_9, shade_sample_10, shade_sample_11,
+	shade_sample_12, shade_sample_13, shade_sample_14, shade_sample
+};
+
+/**
+ * Picks the shading kernel compiled for a set of scene features, it shades exactly like
+ * shade_sample for any scene without the features left out
+ * @param features - The SceneFeature_t flags of the scene, as found by scene_features
+ * @return The kernel to shade the scene's hits with
+ */
+ShadeKernel shade_kernel_select(int features) {
+	return shadeKernels[features & SCENE_FEATURE_ALL];
+}
+
+/**
+ * Compare two queued wavefront hits for qsort, by primitive id and then by position in the tile
+ */
+static int wavefront_hit_compare(const void *a, const void *b) {
+	uint64_t hitA = *(const uint64_t *) a;
+	uint64_t hitB = *(const uint64_t *) b;
+	return (hitA > hitB) - (hitA < hitB);
+}
+
+/**
+ * Shades the primary hits of a rectangle found by raycast_tile as a wavefront, one stage at a time
+ * over every hit instead of one pixel at a time. The hits are queued sorted by the primitive they
+ * hit, so hits on one surface and material run together. Then for each light in turn the shadow
+ * rays of every hit are traced against the light's occluder list and the lit hits are shaded,
+ * keeping one light and its occluders in cache. Last each pixel follows its reflections as before.
+ * The lights are added to each hit in the same order as shade_sample, and without area lights
+ * shading draws no random numbers, so the image and the work counted are the same.
+ * @param sceneRef - The input scene to render
+ * @param imageRef - The output image to write to, already allocated
+ * @param optionsRef - The options to render with
+ * @param stackRef - The ray stack of the calling thread
+ * @param packetRef - The shadow packet holding the hits of the rectangle, culled for them
+ * @param x0 - The first column of the rectangle
+ * @param y0 - The first row of the rectangle
+ * @param x1 - The column past the end of the rectangle
+ * @param y1 - The row past the end of the rectangle
+ */
+static void raycast_tile_wavefront(Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef, RayStack *stackRef,
+								   ShadowPacket *packetRef, int x0, int y0, int x1, int y1) {
+	GBuffer *gbufferRef = optionsRef->gbufferRef;
+	DirtyRegion *regionRef = optionsRef->regionRef;
+	CostBuffer *costRef = optionsRef->costRef;
+	FrameBuffer *frameBufferRef = optionsRef->frameBufferRef;
+	int imageWidth = (int) imageRef->width;
+	int features = stackRef->features;
+	RGBAColor colorFound;
+	RGBApixel pixel;
+
+	// Queue the hits, the primitive id above the position in the tile
+	packetRef->hitsLength = 0;
+	for (int y=y0; y<y1; y++) {
+		for (int x=x0; x<x1; x++) {
+			int packed = (y - y0)*RENDER_TILE_SIZE + x - x0;
+			if ((regionRef != NULL && !regionRef->maskRef[y*imageWidth + x]) ||
+				packetRef->samples[packed].primitiveId == GBUFFER_NO_HIT)
+				continue;
+			packetRef->hits[packetRef->hitsLength++] = (uint64_t) packetRef->samples[packed].primitiveId << 32 | (uint32_t) packed;
+			packetRef->shading[packed].data.X = packetRef->shading[packed].data.Y = packetRef->shading[packed].data.Z = 0.1;
+			packetRef->shadowRays[packed] = 0;
+			packetRef->lightsShaded[packed] = 0;
+		}
+	}
+	qsort(packetRef->hits, (size_t) packetRef->hitsLength, sizeof(uint64_t), wavefront_hit_compare);
+
+	// Trace the shadow rays of every hit to a light, then shade the hits it reaches
+	for (int l = 0; l < sceneRef->lightsLength; l++) {
+		Light *lightRef = &sceneRef->lights[l];
+		int *occluders = &packetRef->occluders[(size_t) l * packetRef->primitivesCapacity];
+		int occludersLength = packetRef->occludersLength[l];
+
+		for (int i = 0; i < packetRef->hitsLength; i++) {
+			int packed = (int) (uint32_t) packetRef->hits[i];
+			GBufferSample *sampleRef = &packetRef->samples[packed];
+			V3 direction;
+			V3 contribution;
+			double distance;
+
+			v3_subtract(&lightRef->data.pointLight.position, &sampleRef->point, &direction);
+			v3_normalize(&direction, &direction);
+			v3_distance(&lightRef->data.pointLight.position, &sampleRef->point, &distance);
+			if (occludersLength > 0) {
+				packetRef->shadowRays[packed]++;
+				if (intersect_any_of_kernel(sceneRef, occluders, occludersLength, &sampleRef->point, &direction, distance,
+											sampleRef->primitiveId, sampleRef->childId, &packetRef->primaryTests[packed], features))
+					continue;
+			}
+			packetRef->lightsShaded[packed]++;
+			shade_light_direct(sampleRef, lightRef, &direction, distance, 1, &contribution, features);
+			for (int j = 0; j < 3; j++)
+				packetRef->shading[packed].array[j] += contribution.array[j];
+		}
+	}
+
+	// Each pixel takes its direct light and follows its reflections
+	for (int y=y0; y<y1; y++) {
+		for (int x=x0; x<x1; x++) {
+			if (regionRef != NULL && !regionRef->maskRef[y*imageWidth + x])
+				continue;
+			int packed = (y - y0)*RENDER_TILE_SIZE + x - x0;
+			GBufferSample *sampleRef = &packetRef->samples[packed];
+			V3 color = {0, 0, 0};
+			V3 throughput = {1, 1, 1};
+
+			ray_stack_reset(stackRef, raycast_seed(optionsRef, imageWidth, x, y));
+			stackRef->raysLeft--;
+			stackRef->intersectionTests = packetRef->primaryTests[packed];
+			if (gbufferRef != NULL)
+				gbufferRef->samplesRef[y*imageWidth + x] = *sampleRef;
+			if (sampleRef->primitiveId != GBUFFER_NO_HIT) {
+				stackRef->shadowRays = packetRef->shadowRays[packed];
+				stackRef->lightsShaded = packetRef->lightsShaded[packed];
+				// Traced in the shadow stage whatever the budget, charged like shade_hit does
+				stackRef->raysLeft -= sceneRef->lightsLength;
+				shade_hit_reflect(sampleRef, stackRef, &throughput, 0, sceneRef->lightsLength, &packetRef->shading[packed], &color);
+				trace_stack(sceneRef, stackRef, &color);
+			}
+			color_from_v3(&color, &colorFound);
+			shade(&colorFound, &pixel);
+			raycast_store(imageRef, frameBufferRef, x, y, &pixel);
+			if (costRef != NULL)
+				cost_buffer_store(costRef, stackRef, y*imageWidth + x);
+		}
+	}
+}
+
+/**
+ * Converts an unclamped color into an RGBAColor
+ * @param color - The color to convert
+ * @param foundColor - The resulting color
+ */
+void color_from_v3(V3 *color, RGBAColor *foundColor) {
+	foundColor->data.R = (uint8_t) (clamp(color->array[0])*255);
+	foundColor->data.G = (uint8_t) (clamp(color->array[1])*255);
+	foundColor->data.B = (uint8_t) (clamp(color->array[2])*255);
+	foundColor->data.A = 1;
+}
+
+/**
+ * Sets up a ray stack for a thread, the stack holds no allocations of its own
+ * @param stackRef - The stack to initialize
+ * @param maxDepth - The maximum number of reflections to follow
+ * @param rayBudget - The rays per pixel, every ray is charged to it and reflections stop once it is spent
+ */
+void ray_stack_init(RayStack *stackRef, int maxDepth, int rayBudget) {
+	stackRef->length = 0;
+	stackRef->maxDepth = maxDepth < RAY_STACK_SIZE ? maxDepth : RAY_STACK_SIZE;
+	stackRef->rayBudget = rayBudget;
+	stackRef->raysLeft = rayBudget;
+	stackRef->rngState = 1;
+	stackRef->shadowPacketRef = NULL;
+	stackRef->lightTreeRef = NULL;
+	stackRef->lightSamples = 0;
+	stackRef->areaLightSamples = AREA_LIGHT_DEFAULT_SAMPLES;
+	stackRef->shadeKernel = shade_sample;
+	stackRef->features = SCENE_FEATURE_ALL;
+}
+
+/**
+ * Empties a ray stack and refills the ray budget before a new pixel, the random number
+ * generator is seeded from the pixel so renders are repeatable
+ * @param stackRef - The stack to reset
+ * @param seed - The seed for this pixel, usually its index
+ */
+void ray_stack_reset(RayStack *stackRef, uint32_t seed) {
+	stackRef->length = 0;
+	stackRef->raysLeft = stackRef->rayBudget;
+	stackRef->intersectionTests = 0;
+	stackRef->shadowRays = 0;
+	stackRef->lightsShaded = 0;
+	// Hash the seed so neighbouring pixels don't get correlated sequences
+	seed ^= seed >> 16;
+	seed *= 0x7feb352dU;
+	seed ^= seed >> 15;
+	seed *= 0x846ca68bU;
+	seed ^= seed >> 16;
+	stackRef->rngState = seed != 0 ? seed : 1;
+}
+
+/**
+ * Draws a random number from the ray stack's generator (xorshift32)
+ * @param stackRef - The stack to draw from
+ * @return A random number in [0, 1)
+ */
+double ray_stack_random(RayStack *stackRef) {
+	uint32_t x = stackRef->rngState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	stackRef->rngState = x;
+	return x / 4294967296.0;
+}
+
+
 /**
  * Clamp a value between 0 and 1
  * @param a
@@ -7,13 +7,29 @@
 
 #include "3dmath.h"
 #include "imaging.h"
+#include "gbuffer.h"
+#include "mesh.h"
+
+#define DEFAULT_MAX_DEPTH 4
+#define DEFAULT_RAY_BUDGET 64
+#define RAY_STACK_SIZE 32
+#define RUSSIAN_ROULETTE_DEPTH 2
+#define RUSSIAN_ROULETTE_THRESHOLD 0.1
+#define SCENE_INITIAL_CAPACITY 16
+#define SCENE_CHUNKS_PER_THREAD 4
+#define SCENE_REPLICATE_MAX_SIZE (64 << 20)
+#define RENDER_TILE_SIZE 32
+#define AREA_LIGHT_DEFAULT_SAMPLES 64
+#define AREA_LIGHT_PROBE_STRATA 2
 
 /**
  * Supported Primitive Types
  */
 typedef enum PrimitiveType_t {
 	SPHERE_T,
-	PLANE_T
+	PLANE_T,
+	INSTANCE_T,
+	MESH_T
 } PrimitiveType_t;
 
 /**
@@ -21,9 +37,18 @@ typedef enum PrimitiveType_t {
  */
 typedef enum LightType_t {
 	POINTLIGHT_T,
-	SPOTLIGHT_T
+	SPOTLIGHT_T,
+	AREALIGHT_T
 } LightType_t;
 
+/**
+ * Supported Area Light Shapes
+ */
+typedef enum AreaLightShape_t {
+	AREA_RECTANGLE_T,
+	AREA_SPHERE_T
+} AreaLightShape_t;
+
 /**
  * Camera Struct
  */
@@ -40,6 +65,7 @@ typedef struct Sphere {
 	V3 specularColor;
 	V3 position;
 	double radius;
+	double reflectivity;
 } Sphere;
 
 /**
@@ -50,10 +76,29 @@ typedef struct Plane {
 	V3 specularColor;
 	V3 position;
 	V3 normal;
+	double reflectivity;
 } Plane;
 
 /**
- * Primitive Struct
+ * Triangle Mesh Struct - The material of a mesh loaded from an OBJ file
+ */
+typedef struct TriangleMesh {
+	V3 diffuseColor;
+	V3 specularColor;
+	double reflectivity;
+	Mesh mesh;
+} TriangleMesh;
+
+/**
+ * Instance Struct - A placement of a group, only the transform into the group's space is stored
+ */
+typedef struct Instance {
+	int groupId;
+	A3 worldToObject;
+} Instance;
+
+/**
+ * Primitive Struct - A sphere or plane inside of a group
  */
 typedef struct Primitive {
 	PrimitiveType_t type;
@@ -63,6 +108,20 @@ typedef struct Primitive {
 	} data;
 } Primitive;
 
+/**
+ * Group Struct - Primitives defined once and placed any number of times by instances,
+ * the bounding sphere is INFINITY when the group contains a plane. Instances may refer to a
+ * group before it is defined, isDefined is set once its definition is read.
+ */
+typedef struct Group {
+	char *name;
+	Primitive *primitives;
+	int primitivesLength;
+	int isDefined;
+	V3 boundCenter;
+	double boundRadius;
+} Group;
+
 /**
  * Point Light
  */
@@ -91,33 +150,263 @@ typedef struct SpotLight {
 } SpotLight;
 
 /**
- * Light Struct
+ * Area Light - A rectangle spanning edgeU and edgeV centered on position, or a sphere of radius
+ * around it. It is shaded as a point light at its center, dimmed by how much of it a point sees.
+ */
+
+typedef struct AreaLight {
+	V3 color;
+	V3 position;
+	float radialA2;
+	float radialA1;
+	float radialA0;
+	AreaLightShape_t shape;
+	V3 edgeU;
+	V3 edgeV;
+	double radius;
+} AreaLight;
+
+/**
+ * Light Struct - Every kind of light starts with the fields of a point light, so they can be
+ * read through pointLight whatever the type
  */
 typedef struct Light {
 	LightType_t type;
 	union {
 		PointLight pointLight;
 		SpotLight spotLight;
+		AreaLight areaLight;
 	} data;
 } Light;
 
 /**
- * Scene Struct
+ * Scene Struct - Every kind of object is stored by value in its own growable array. Primitive ids
+ * are assigned to the spheres first, then the planes, instances and meshes. While a scene file is
+ * being loaded directory names the directory relative mesh files are resolved against.
  */
 typedef struct Scene {
 	Camera camera;
-	Primitive** primitives;
-	Light** lights;
+	int hasCamera;
+	Sphere *spheres;
+	Plane *planes;
+	Instance *instances;
+	TriangleMesh *meshes;
+	Light *lights;
+	Group *groups;
+	int spheresLength, spheresCapacity;
+	int planesLength, planesCapacity;
+	int instancesLength, instancesCapacity;
+	int meshesLength, meshesCapacity;
+	int lightsLength, lightsCapacity;
+	int groupsLength, groupsCapacity;
 	int primitivesLength;
-	int lightsLength;
+	char *directory;
 } Scene;
 
+/**
+ * Determine the type of a primitive from its id
+ * @param sceneRef - The scene the id belongs to
+ * @param primitiveId - The id of the primitive
+ * @param indexRef - The index of the primitive within the array of its type is written here
+ * @return The type of the primitive
+ */
+static inline PrimitiveType_t scene_primitive_type(Scene *sceneRef, int primitiveId, int *indexRef) {
+	if (primitiveId < sceneRef->spheresLength) {
+		*indexRef = primitiveId;
+		return SPHERE_T;
+	}
+	primitiveId -= sceneRef->spheresLength;
+	if (primitiveId < sceneRef->planesLength) {
+		*indexRef = primitiveId;
+		return PLANE_T;
+	}
+	primitiveId -= sceneRef->planesLength;
+	if (primitiveId < sceneRef->instancesLength) {
+		*indexRef = primitiveId;
+		return INSTANCE_T;
+	}
+	*indexRef = primitiveId - sceneRef->instancesLength;
+	return MESH_T;
+}
+
+/**
+ * Scene Features - What a scene holds that shading has to handle, a shading kernel is compiled
+ * for every combination and the tightest one for the scene is picked before rendering
+ */
+typedef enum SceneFeature_t {
+	SCENE_FEATURE_SPOT_LIGHTS = 1,
+	SCENE_FEATURE_AREA_LIGHTS = 2,
+	SCENE_FEATURE_SPECULAR = 4,
+	SCENE_FEATURE_CHILDREN = 8,
+	SCENE_FEATURE_ALL = 15
+} SceneFeature_t;
+
+// Define needed structure prototypes
+typedef struct ShadowPacket ShadowPacket;
+typedef struct PrimitiveBound PrimitiveBound;
+typedef struct LightTree LightTree;
+
+/**
+ * A ray waiting to be traced on a RayStack
+ */
+typedef struct RayStackEntry {
+	V3 origin;
+	V3 direction;
+	V3 throughput;
+	int depth;
+	int ignoreId;
+	int ignoreChildId;
+} RayStackEntry;
+
+typedef struct RayStack RayStack;
+
+/**
+ * ShadeKernel - Shades a hit sample with the lights of a scene, see shade_sample
+ */
+typedef int (*ShadeKernel)(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, V3 *color);
+
+/**
+ * RayStack - An explicit stack of secondary rays used instead of recursion, each rendering
+ * thread owns one and reuses it for every pixel so tracing does not allocate. It also counts
+ * the work done on the current pixel. While a primary hit is shaded shadowPacketRef may name the
+ * packet of its tile, whose occluder lists then replace the full shadow test. When lightTreeRef is
+ * set every hit is shaded with lightSamples lights picked from the tree instead of every light.
+ * Area lights in penumbra are sampled with about areaLightSamples shadow rays. Hits are shaded with
+ * shadeKernel, shade_sample unless a kernel specialised for the features of the scene was selected.
+ */
+typedef struct RayStack {
+	RayStackEntry entries[RAY_STACK_SIZE];
+	int length;
+	int maxDepth;
+	int rayBudget;
+	int raysLeft;
+	uint32_t rngState;
+	uint32_t intersectionTests;
+	uint32_t shadowRays;
+	uint32_t lightsShaded;
+	ShadowPacket *shadowPacketRef;
+	LightTree *lightTreeRef;
+	int lightSamples;
+	int areaLightSamples;
+	ShadeKernel shadeKernel;
+	int features;
+} RayStack;
+
+/**
+ * RenderStats - Where the threads of a render ran and whether the pixels they wrote were in the
+ * memory of their own node, bytes on pages the kernel could not place are unknown
+ */
+typedef struct RenderStats {
+	int threadsLength;
+	int nodesLength;
+	int sceneCopiesLength;
+	int tilesLength;
+	int tilesStolen;
+	size_t localBytes;
+	size_t remoteBytes;
+	size_t unknownBytes;
+} RenderStats;
+
+// Define needed structure prototypes
+typedef struct DirtyRegion DirtyRegion;
+typedef struct CostBuffer CostBuffer;
+typedef struct RenderJob RenderJob;
+typedef struct Renderer Renderer;
+typedef struct RenderNodeQueue RenderNodeQueue;
+typedef struct RenderWorker RenderWorker;
+typedef struct FrameBuffer FrameBuffer;
+typedef struct ImageWriter ImageWriter;
+typedef struct MipPyramid MipPyramid;
+typedef struct TileCache TileCache;
+
+/**
+ * RenderScratch - The tile queues, per node scene copies, primitive bounds and worker state of a
+ * render, a renderer keeps them between calls so renders after the first allocate nothing
+ */
+typedef struct RenderScratch {
+	RenderNodeQueue **queues;
+	int queuesLength;
+	int *tileNodes;
+	int tilesCapacity;
+	RenderWorker *workers;
+	int workersCapacity;
+	PrimitiveBound *bounds;
+	int boundsCapacity;
+	LightTree *lightTree;
+} RenderScratch;
+
+/**
+ * RenderOptions - Settings for a call to raycast, every pointer may be left NULL.
+ * gbufferRef - The primary hit of every pixel is captured into it.
+ * costRef - The work spent on each pixel is counted into it.
+ * regionRef - Only its pixels are traced, into an image that already holds the previous render.
+ * statsRef - The threads, tiles, scene copies and memory placement of the render are written to it.
+ * jobRef - The render reports its progress to it and honours its cancel flag and deadline.
+ * rendererRef - The render runs on the renderer's threads and reuses its scratch.
+ * frameBufferRef - The pixels are written straight into it instead of the image.
+ * writerRef - Every band of tile rows is handed to it as soon as its last tile is finished.
+ * mipRef - Every finished tile is reduced into the pyramid's levels.
+ * tileCacheRef - Tiles rendered before with the same scene and options are copied from it.
+ * threadsLength - The threads to render on, 0 renders on every core.
+ * maxDepth - The most reflections followed from a primary hit.
+ * rayBudget - The rays a pixel may trace before its reflections stop being followed.
+ * lightSamples - Above 0, each hit is shaded with that many lights picked from a light tree.
+ * areaLightSamples - The shadow rays traced to an area light from a point in its penumbra.
+ * wavefront - Shadow packet tiles are shaded a stage at a time instead of a pixel at a time.
+ * firstRow - The row of the full image the first row of a band is, used with fullHeight.
+ * fullHeight - Above 0, the image is the rows of a fullHeight row image starting at firstRow.
+ */
+typedef struct RenderOptions {
+	GBuffer *gbufferRef;
+	CostBuffer *costRef;
+	DirtyRegion *regionRef;
+	RenderStats *statsRef;
+	RenderJob *jobRef;
+	Renderer *rendererRef;
+	FrameBuffer *frameBufferRef;
+	ImageWriter *writerRef;
+	MipPyramid *mipRef;
+	TileCache *tileCacheRef;
+	int threadsLength;
+	int maxDepth;
+	int rayBudget;
+	int lightSamples;
+	int areaLightSamples;
+	int wavefront;
+	int firstRow;
+	int fullHeight;
+} RenderOptions;
+
 // Define needed structure prototypes
 typedef struct JSONArray JSONArray;
 
-int raycast(Scene *sceneRef, Image* imageRef, int imageWidth, int imageHeight);
+void render_options_init(RenderOptions *optionsRef);
+int raycast(Scene *sceneRef, Image* imageRef, RenderOptions *optionsRef, int imageWidth, int imageHeight);
+void render_scratch_free(RenderScratch *scratchRef);
+void primary_rays_generate(Camera *cameraRef, int imageWidth, int imageHeight, int y, int x0, int x1, V3 *directionsRef);
+void raycast_tile(Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef, RayStack *stackRef, ShadowPacket *packetRef, int x0, int y0, int x1, int y1);
+int relight(Scene *sceneRef, GBuffer *gbufferRef, RenderOptions *optionsRef, Image *imageRef);
 int shade(RGBAColor* colorRef, RGBApixel *pixel);
-int shoot(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RGBAColor *foundColor);
+int shoot(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RayStack *stackRef, RGBAColor *foundColor, GBufferSample *sampleRef);
+void shoot_primary(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RayStack *stackRef, GBufferSample *sampleRef);
+void shoot_shade(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, ShadowPacket *packetRef, RGBAColor *foundColor);
+void trace_stack(Scene *sceneRef, RayStack *stackRef, V3 *color);
+void shade_hit(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, V3 *throughput, int depth, V3 *color);
+int intersect_closest(Scene *sceneRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreId, int ignoreChildId, double *tRef, int *childIdRef, uint32_t *testsRef);
+int intersect_any(Scene *sceneRef, V3 *rayOriginRef, V3 *rayDirectionRef, double maxT, int ignoreId, int ignoreChildId, uint32_t *testsRef);
+int intersect_any_of(Scene *sceneRef, int *ids, int idsLength, V3 *rayOriginRef, V3 *rayDirectionRef, double maxT, int ignoreId, int ignoreChildId, uint32_t *testsRef);
+double intersect_primitive(Primitive *primitiveRef, V3 *rayOriginRef, V3 *rayDirectionRef);
+double intersect_instance(Scene *sceneRef, Instance *instanceRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreChildId, int *childIdRef, uint32_t *testsRef);
+void build_sample(Scene *sceneRef, V3 *rayOriginRef, V3 *rayDirectionRef, int primitiveId, int childId, double t, GBufferSample *sampleRef);
+void primitive_surface(Primitive *primitiveRef, V3 *pointRef, GBufferSample *sampleRef);
+void sphere_surface(Sphere *sphereRef, V3 *pointRef, GBufferSample *sampleRef);
+void plane_surface(Plane *planeRef, GBufferSample *sampleRef);
+int shade_sample(GBufferSample *sampleRef, Scene *sceneRef, RayStack *stackRef, V3 *color);
+ShadeKernel shade_kernel_select(int features);
+void color_from_v3(V3 *color, RGBAColor *foundColor);
+void ray_stack_init(RayStack *stackRef, int maxDepth, int rayBudget);
+void ray_stack_reset(RayStack *stackRef, uint32_t seed);
+double ray_stack_random(RayStack *stackRef);
 double intersect_sphere(Sphere *sphereRef, V3 *rayOriginRef, V3 *rayDirectionRef);
 double intersect_plane(Plane *planeRef, V3 *rayOriginRef, V3 *rayDirectionRef);
 double clamp(double a);
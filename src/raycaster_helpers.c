@@ -5,9 +5,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "json.h"
 #include "3dmath.h"
 #include "raycaster.h"
+#include "raycaster_helpers.h"
 
 /**
  * Converts a JSONArray to a V3 vector with error checking
@@ -42,417 +46,1696 @@ int JSONArray_to_V3(JSONArray *JSONArrayRef, V3 *vectorRef) {
 }
 
 /**
- * Populates a scene based on the input JSONRootValue
- * @param JSONValueSceneRef - The JSON value containing a JSONArray to be used to populate the scene
- * @param sceneRef - A reference to the scene to populate
+ * Converts a JSONObject describing a sphere to a Sphere with error checking
+ * @param JSONObjectRef - A reference to the JSONObject describing the sphere
+ * @param sphereRef - The sphere to write into
+ * @return 0 if success, otherwise a failure occurred
+ */
+int JSONObject_to_sphere(JSONObject *JSONObjectRef, Sphere *sphereRef) {
+	JSONValue *JSONValueTempRef;
+
+	// Read the diffuse color
+	if (JSONObject_get_value("diffuse_color", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sphereRef->diffuseColor) != 0) {
+		return 1;
+	}
+
+	// Check colors
+	for (int j = 0; j < 3; j++) {
+		if (sphereRef->diffuseColor.array[j] < 0) {
+			fprintf(stderr, "Error: Color cannot be negative\n");
+			return 1;
+		}
+		if (sphereRef->diffuseColor.array[j] > 1) {
+			fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+			return 1;
+		}
+	}
+
+	// Read the specular color
+	if (JSONObject_get_value("specular_color", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sphereRef->specularColor) != 0) {
+		return 1;
+	}
+
+	// Check colors
+	for (int j = 0; j < 3; j++) {
+		if (sphereRef->specularColor.array[j] < 0) {
+			fprintf(stderr, "Error: Color cannot be negative\n");
+			return 1;
+		}
+		if (sphereRef->specularColor.array[j] > 1) {
+			fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+			return 1;
+		}
+	}
+
+	// Read the position
+	if (JSONObject_get_value("position", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sphereRef->position) != 0) {
+		return 1;
+	}
+
+	// Read the radius
+	if (JSONObject_get_value("radius", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != NUMBER_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->data.dataNumber < 0) {
+		fprintf(stderr, "Error: Negative sphere radius is not allowed\n");
+		return 1;
+	}
+
+	sphereRef->radius = JSONValueTempRef->data.dataNumber;
+
+	// Read the reflectivity if it exists
+	if (JSONObject_get_value("reflectivity", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONValueTempRef->data.dataNumber < 0 || JSONValueTempRef->data.dataNumber > 1) {
+			fprintf(stderr, "Error: Primitive reflectivity must be between 0.0 and 1.0\n");
+			return 1;
+		}
+
+		sphereRef->reflectivity = JSONValueTempRef->data.dataNumber;
+	}
+	else {
+		sphereRef->reflectivity = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * Converts a JSONObject describing a plane to a Plane with error checking
+ * @param JSONObjectRef - A reference to the JSONObject describing the plane
+ * @param planeRef - The plane to write into
+ * @return 0 if success, otherwise a failure occurred
+ */
+int JSONObject_to_plane(JSONObject *JSONObjectRef, Plane *planeRef) {
+	JSONValue *JSONValueTempRef;
+
+	// Read the diffuse color
+	if (JSONObject_get_value("diffuse_color", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &planeRef->diffuseColor) != 0) {
+		return 1;
+	}
+
+	// Check colors
+	for (int j = 0; j < 3; j++) {
+		if (planeRef->diffuseColor.array[j] < 0) {
+			fprintf(stderr, "Error: Color cannot be negative\n");
+			return 1;
+		}
+		if (planeRef->diffuseColor.array[j] > 1) {
+			fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+			return 1;
+		}
+	}
+
+	// Read the specular color
+	if (JSONObject_get_value("specular_color", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &planeRef->specularColor) != 0) {
+		return 1;
+	}
+
+	// Check colors
+	for (int j = 0; j < 3; j++) {
+		if (planeRef->specularColor.array[j] < 0) {
+			fprintf(stderr, "Error: Color cannot be negative\n");
+			return 1;
+		}
+		if (planeRef->specularColor.array[j] > 1) {
+			fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+			return 1;
+		}
+	}
+
+	// Read the position
+	if (JSONObject_get_value("position", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &planeRef->position) != 0) {
+		return 1;
+	}
+
+	// Read the normal
+	if (JSONObject_get_value("normal", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &planeRef->normal) != 0) {
+		return 1;
+	}
+
+	// Normalize the direction
+	v3_normalize(&planeRef->normal, &planeRef->normal);
+
+	// Read the reflectivity if it exists
+	if (JSONObject_get_value("reflectivity", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONValueTempRef->data.dataNumber < 0 || JSONValueTempRef->data.dataNumber > 1) {
+			fprintf(stderr, "Error: Primitive reflectivity must be between 0.0 and 1.0\n");
+			return 1;
+		}
+
+		planeRef->reflectivity = JSONValueTempRef->data.dataNumber;
+	}
+	else {
+		planeRef->reflectivity = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * Converts a JSONObject describing a mesh to a TriangleMesh with error checking, the OBJ file
+ * it refers to is loaded here
+ * @param JSONObjectRef - A reference to the JSONObject describing the mesh
+ * @param directory - The directory a relative OBJ file name is resolved against, NULL for the working directory
+ * @param meshRef - The mesh to write into
+ * @return 0 if success, otherwise a failure occurred
+ */
+int JSONObject_to_mesh(JSONObject *JSONObjectRef, char *directory, TriangleMesh *meshRef) {
+	JSONValue *JSONValueTempRef;
+
+	// The mesh owns nothing until its OBJ file is loaded, so a failed mesh can still be freed
+	memset(&meshRef->mesh, 0, sizeof(Mesh));
+
+	// Read the diffuse color
+	if (JSONObject_get_value("diffuse_color", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &meshRef->diffuseColor) != 0) {
+		return 1;
+	}
+
+	// Check colors
+	for (int j = 0; j < 3; j++) {
+		if (meshRef->diffuseColor.array[j] < 0) {
+			fprintf(stderr, "Error: Color cannot be negative\n");
+			return 1;
+		}
+		if (meshRef->diffuseColor.array[j] > 1) {
+			fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+			return 1;
+		}
+	}
+
+	// Read the specular color
+	if (JSONObject_get_value("specular_color", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &meshRef->specularColor) != 0) {
+		return 1;
+	}
+
+	// Check colors
+	for (int j = 0; j < 3; j++) {
+		if (meshRef->specularColor.array[j] < 0) {
+			fprintf(stderr, "Error: Color cannot be negative\n");
+			return 1;
+		}
+		if (meshRef->specularColor.array[j] > 1) {
+			fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+			return 1;
+		}
+	}
+
+	// Read the reflectivity if it exists
+	if (JSONObject_get_value("reflectivity", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONValueTempRef->data.dataNumber < 0 || JSONValueTempRef->data.dataNumber > 1) {
+			fprintf(stderr, "Error: Primitive reflectivity must be between 0.0 and 1.0\n");
+			return 1;
+		}
+
+		meshRef->reflectivity = JSONValueTempRef->data.dataNumber;
+	}
+	else {
+		meshRef->reflectivity = 0;
+	}
+
+	// Read the OBJ file
+	if (JSONObject_get_value("file", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != STRING_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	char *path = JSONValueTempRef->data.dataString;
+	char *resolvedPath = NULL;
+	if (directory != NULL && path[0] != '/') {
+		resolvedPath = malloc(strlen(directory) + strlen(path) + 2);
+		if (resolvedPath == NULL) {
+			fprintf(stderr, "Error: Could not allocate the path of mesh file '%s'\n", path);
+			return 1;
+		}
+		sprintf(resolvedPath, "%s/%s", directory, path);
+		path = resolvedPath;
+	}
+
+	int result = load_obj_mesh(path, &meshRef->mesh);
+	free(resolvedPath);
+	return result;
+}
+
+/**
+ * Converts a JSONObject describing a sphere or plane to a Primitive with error checking
+ * @param JSONObjectRef - A reference to the JSONObject describing the primitive
+ * @param type - The value of the object's "type" key
+ * @param primitiveRef - The primitive to write into
+ * @return 0 if success, otherwise a failure occurred
+ */
+int JSONObject_to_primitive(JSONObject *JSONObjectRef, char *type, Primitive *primitiveRef) {
+	if (strcmp(type, "sphere") == 0) {
+		primitiveRef->type = SPHERE_T;
+		return JSONObject_to_sphere(JSONObjectRef, &primitiveRef->data.sphere);
+	}
+	else if (strcmp(type, "plane") == 0) {
+		primitiveRef->type = PLANE_T;
+		return JSONObject_to_plane(JSONObjectRef, &primitiveRef->data.plane);
+	}
+
+	fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+	return 1;
+}
+
+
+/**
+ * Finds a group by name, instances may refer to a group before it is defined so an undefined
+ * group is created for names that have not been seen yet
+ * @param sceneRef - The scene containing the groups
+ * @param name - The name of the group
+ * @return The id of the group, or -1 if it could not be created
+ */
+int scene_find_group(Scene *sceneRef, char *name) {
+	for (int i = 0; i < sceneRef->groupsLength; i++) {
+		if (strcmp(sceneRef->groups[i].name, name) == 0)
+			return i;
+	}
+
+	Group *groupRef = scene_array_append((void **) &sceneRef->groups, &sceneRef->groupsLength,
+										 &sceneRef->groupsCapacity, sizeof(Group));
+	if (groupRef == NULL)
+		return -1;
+
+	groupRef->name = strdup(name);
+	if (groupRef->name == NULL) {
+		fprintf(stderr, "Error: Could not allocate the name of group '%s'\n", name);
+		sceneRef->groupsLength--;
+		return -1;
+	}
+	groupRef->primitives = NULL;
+	groupRef->primitivesLength = 0;
+	groupRef->isDefined = 0;
+	calculate_group_bounds(groupRef);
+
+	return sceneRef->groupsLength - 1;
+}
+
+/**
+ * Converts a JSONObject describing a group into the scene's group of the same name with error checking
+ * @param JSONObjectRef - A reference to the JSONObject describing the group
+ * @param sceneRef - The scene to add the group to
+ * @return 0 if success, otherwise a failure occurred
+ */
+int JSONObject_to_group(JSONObject *JSONObjectRef, Scene *sceneRef) {
+	JSONValue *JSONValueTempRef;
+	JSONArray *JSONGroupArrayRef;
+
+	// Read the name
+	if (JSONObject_get_value("name", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != STRING_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	int groupId = scene_find_group(sceneRef, JSONValueTempRef->data.dataString);
+	if (groupId == -1)
+		return 1;
+
+	Group *groupRef = &sceneRef->groups[groupId];
+	if (groupRef->isDefined) {
+		fprintf(stderr, "Error: Group '%s' is defined more than once\n", groupRef->name);
+		return 1;
+	}
+
+	// Read the objects
+	if (JSONObject_get_value("objects", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	JSONGroupArrayRef = JSONValueTempRef->data.dataArray;
+
+	groupRef->primitives = malloc(sizeof(Primitive) * JSONGroupArrayRef->length);
+	if (groupRef->primitives == NULL && JSONGroupArrayRef->length > 0) {
+		fprintf(stderr, "Error: Could not allocate space for %i objects of group '%s'\n", JSONGroupArrayRef->length,
+				groupRef->name);
+		return 1;
+	}
+	groupRef->primitivesLength = JSONGroupArrayRef->length;
+
+	for (int j = 0; j < JSONGroupArrayRef->length; j++) {
+		if (JSONGroupArrayRef->values[j]->type != OBJECT_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		JSONObject *JSONChildRef = JSONGroupArrayRef->values[j]->data.dataObject;
+
+		if (JSONObject_get_value("type", JSONChildRef, &JSONValueTempRef) != 0 || JSONValueTempRef->type != STRING_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (strcmp(JSONValueTempRef->data.dataString, "sphere") != 0 &&
+			strcmp(JSONValueTempRef->data.dataString, "plane") != 0) {
+			fprintf(stderr, "Error: Groups may only contain spheres and planes\n");
+			return 1;
+		}
+
+		if (JSONObject_to_primitive(JSONChildRef, JSONValueTempRef->data.dataString, &groupRef->primitives[j]) != 0) {
+			return 1;
+		}
+	}
+
+	calculate_group_bounds(groupRef);
+	groupRef->isDefined = 1;
+
+	return 0;
+}
+
+/**
+ * Calculates a sphere bounding every primitive of a group, used to skip instances a ray misses
+ * @param groupRef - The group to calculate the bounds of
+ */
+void calculate_group_bounds(Group *groupRef) {
+	V3 min = {INFINITY, INFINITY, INFINITY};
+	V3 max = {-INFINITY, -INFINITY, -INFINITY};
+
+	groupRef->boundRadius = INFINITY;
+	groupRef->boundCenter.data.X = groupRef->boundCenter.data.Y = groupRef->boundCenter.data.Z = 0;
+
+	if (groupRef->primitivesLength == 0)
+		return;
+
+	for (int i = 0; i < groupRef->primitivesLength; i++) {
+		// Planes are unbounded
+		if (groupRef->primitives[i].type != SPHERE_T)
+			return;
+
+		Sphere *sphereRef = &groupRef->primitives[i].data.sphere;
+		for (int j = 0; j < 3; j++) {
+			if (sphereRef->position.array[j] - sphereRef->radius < min.array[j])
+				min.array[j] = sphereRef->position.array[j] - sphereRef->radius;
+			if (sphereRef->position.array[j] + sphereRef->radius > max.array[j])
+				max.array[j] = sphereRef->position.array[j] + sphereRef->radius;
+		}
+	}
+
+	v3_add(&min, &max, &groupRef->boundCenter);
+	v3_scale(&groupRef->boundCenter, 0.5, &groupRef->boundCenter);
+
+	double radius = 0;
+	for (int i = 0; i < groupRef->primitivesLength; i++) {
+		double distance;
+		v3_distance(&groupRef->boundCenter, &groupRef->primitives[i].data.sphere.position, &distance);
+		if (distance + groupRef->primitives[i].data.sphere.radius > radius)
+			radius = distance + groupRef->primitives[i].data.sphere.radius;
+	}
+	groupRef->boundRadius = radius;
+}
+
+/**
+ * Calculate the world space box around a sphere
+ * @param sphereRef - The sphere to bound
+ * @param minRef - The lowest corner of the box is written here
+ * @param maxRef - The highest corner of the box is written here
+ */
+void sphere_bounds(Sphere *sphereRef, V3 *minRef, V3 *maxRef) {
+	for (int i = 0; i < 3; i++) {
+		minRef->array[i] = sphereRef->position.array[i] - sphereRef->radius;
+		maxRef->array[i] = sphereRef->position.array[i] + sphereRef->radius;
+	}
+}
+
+/**
+ * Calculate the world space box around a mesh from the root of its hierarchy
+ * @param meshRef - The mesh to bound
+ * @param minRef - The lowest corner of the box is written here
+ * @param maxRef - The highest corner of the box is written here
+ * @return 0 if the mesh has a box, otherwise it has no triangles
+ */
+int mesh_bounds(TriangleMesh *meshRef, V3 *minRef, V3 *maxRef) {
+	if (meshRef->mesh.nodesLength == 0)
+		return 1;
+
+	for (int i = 0; i < 3; i++) {
+		minRef->array[i] = meshRef->mesh.nodes[0].min[i];
+		maxRef->array[i] = meshRef->mesh.nodes[0].max[i];
+	}
+	return 0;
+}
+
+/**
+ * Calculate the world space sphere around an instance from the bounding sphere of its group,
+ * the sphere is scaled by the largest stretch the linear part of the transform can apply. An
+ * instance of an unbounded group, or one with a transform that can not be inverted, gets an
+ * infinite radius.
+ * @param sceneRef - The scene holding the instance's group
+ * @param instanceRef - The instance to bound
+ * @param centerRef - The center of the sphere is written here
+ * @param radiusRef - The radius of the sphere is written here
+ */
+void instance_bound_sphere(Scene *sceneRef, Instance *instanceRef, V3 *centerRef, double *radiusRef) {
+	Group *groupRef = &sceneRef->groups[instanceRef->groupId];
+	A3 objectToWorld;
+	double stretch = 0;
+
+	if (!isfinite(groupRef->boundRadius) || a3_invert(&instanceRef->worldToObject, &objectToWorld) != 0) {
+		centerRef->data.X = centerRef->data.Y = centerRef->data.Z = 0;
+		*radiusRef = INFINITY;
+		return;
+	}
+
+	// The Frobenius norm bounds the spectral norm from above
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			stretch += objectToWorld.m[i][j] * objectToWorld.m[i][j];
+	*radiusRef = groupRef->boundRadius * sqrt(stretch);
+
+	a3_transform_point(&objectToWorld, &groupRef->boundCenter, centerRef);
+}
+
+/**
+ * Calculate the world space box around an instance from its bounding sphere, unbounded instances
+ * get an infinite box
+ * @param sceneRef - The scene holding the instance's group
+ * @param instanceRef - The instance to bound
+ * @param minRef - The lowest corner of the box is written here
+ * @param maxRef - The highest corner of the box is written here
+ */
+void instance_bounds(Scene *sceneRef, Instance *instanceRef, V3 *minRef, V3 *maxRef) {
+	V3 center;
+	double radius;
+
+	instance_bound_sphere(sceneRef, instanceRef, &center, &radius);
+	if (!isfinite(radius)) {
+		minRef->data.X = minRef->data.Y = minRef->data.Z = -INFINITY;
+		maxRef->data.X = maxRef->data.Y = maxRef->data.Z = INFINITY;
+		return;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		minRef->array[i] = center.array[i] - radius;
+		maxRef->array[i] = center.array[i] + radius;
+	}
+}
+
+/**
+ * Converts a JSONObject describing an instance of a group to an Instance with error checking,
+ * the group may be defined later in the scene
+ * @param JSONObjectRef - A reference to the JSONObject describing the instance
+ * @param sceneRef - The scene containing the groups
+ * @param instanceRef - The instance to write into
+ * @return 0 if success, otherwise a failure occurred
+ */
+int JSONObject_to_instance(JSONObject *JSONObjectRef, Scene *sceneRef, Instance *instanceRef) {
+	JSONValue *JSONValueTempRef;
+	V3 translation = {0, 0, 0};
+	V3 rotation = {0, 0, 0};
+	V3 scale = {1, 1, 1};
+
+	// Find the group
+	if (JSONObject_get_value("group", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != STRING_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	instanceRef->groupId = scene_find_group(sceneRef, JSONValueTempRef->data.dataString);
+	if (instanceRef->groupId == -1)
+		return 1;
+
+	// Read the translation if it exists
+	if (JSONObject_get_value("translation", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != ARRAY_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &translation) != 0) {
+			return 1;
+		}
+	}
+
+	// Read the rotation (degrees about X, then Y, then Z) if it exists
+	if (JSONObject_get_value("rotation", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != ARRAY_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &rotation) != 0) {
+			return 1;
+		}
+	}
+
+	// Read the scale, either uniform or per axis, if it exists
+	if (JSONObject_get_value("scale", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type == NUMBER_T) {
+			scale.data.X = scale.data.Y = scale.data.Z = JSONValueTempRef->data.dataNumber;
+		}
+		else if (JSONValueTempRef->type == ARRAY_T) {
+			if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &scale) != 0) {
+				return 1;
+			}
+		}
+		else {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+	}
+
+	// Build objectToWorld = translation * rotationZ * rotationY * rotationX * scale
+	A3 objectToWorld;
+	A3 step;
+	A3 temp;
+	a3_identity(&objectToWorld);
+	for (int i = 0; i < 3; i++)
+		objectToWorld.m[i][i] = scale.array[i];
+
+	for (int axis = 0; axis < 3; axis++) {
+		double angle = rotation.array[axis] * (M_PI/180);
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+
+		a3_identity(&step);
+		step.m[u][u] = cos(angle);
+		step.m[u][v] = -sin(angle);
+		step.m[v][u] = sin(angle);
+		step.m[v][v] = cos(angle);
+
+		a3_multiply(&step, &objectToWorld, &temp);
+		objectToWorld = temp;
+	}
+
+	for (int i = 0; i < 3; i++)
+		objectToWorld.m[i][3] = translation.array[i];
+
+	if (a3_invert(&objectToWorld, &instanceRef->worldToObject) != 0) {
+		fprintf(stderr, "Error: Instance scale must not be 0\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Converts a JSONObject describing a light to a Light with error checking, lights with a
+ * non-zero theta are spot lights
+ * @param JSONObjectRef - A reference to the JSONObject describing the light
+ * @param lightRef - The light to write into
+ * @return 0 if success, otherwise a failure occurred
+ */
+int JSONObject_to_light(JSONObject *JSONObjectRef, Light *lightRef) {
+	JSONValue *JSONValueTempRef;
+
+	lightRef->type = POINTLIGHT_T;
+
+	// Read the color
+	if (JSONObject_get_value("color", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &lightRef->data.pointLight.color) != 0) {
+		return 1;
+	}
+
+	// Check colors
+	for (int j = 0; j < 3; j++) {
+		if (lightRef->data.pointLight.color.array[j] < 0) {
+			fprintf(stderr, "Error: Color cannot be negative\n");
+			return 1;
+		}
+	}
+
+	// Read the position
+	if (JSONObject_get_value("position", JSONObjectRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+
+	if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &lightRef->data.pointLight.position) != 0) {
+		return 1;
+	}
+
+	// Read the radialA2
+	if (JSONObject_get_value("radial-a2", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+
+		lightRef->data.pointLight.radialA2 = JSONValueTempRef->data.dataNumber;
+	}
+	else {
+		lightRef->data.pointLight.radialA2 = 1;
+	}
+
+	// Read the radialA1
+	if (JSONObject_get_value("radial-a1", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+
+		lightRef->data.pointLight.radialA1 = JSONValueTempRef->data.dataNumber;
+	}
+	else {
+		lightRef->data.pointLight.radialA1 = 0;
+	}
+
+	// Read the radialA0
+	if (JSONObject_get_value("radial-a0", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+
+		lightRef->data.pointLight.radialA0 = JSONValueTempRef->data.dataNumber;
+	}
+	else {
+		lightRef->data.pointLight.radialA0 = 0;
+	}
+
+	// Ensure that A0, A1, and A2 are not all 0
+	if (lightRef->data.pointLight.radialA0 == 0 &&
+			lightRef->data.pointLight.radialA1 == 0 &&
+			lightRef->data.pointLight.radialA2 == 0) {
+		fprintf(stderr, "Error: Input scene light constants must have one constant not equal to 0\n");
+		return 1;
+	}
+
+	if (lightRef->data.pointLight.radialA0 < 0 ||
+		lightRef->data.pointLight.radialA1 < 0 ||
+		lightRef->data.pointLight.radialA2 < 0) {
+		fprintf(stderr, "Error: Input scene light constants must not be negative\n");
+		return 1;
+	}
+
+	// Read the angularA0 if it exists
+	if (JSONObject_get_value("theta", JSONObjectRef, &JSONValueTempRef) == 0) {
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+
+		if (JSONValueTempRef->data.dataNumber != 0) {
+			lightRef->type = SPOTLIGHT_T;
+
+			// Translate Theta into radians
+			lightRef->data.spotLight.theta = (float) (JSONValueTempRef->data.dataNumber * (M_PI/180));
+
+
+			if (JSONObject_get_value("angular-a0", JSONObjectRef, &JSONValueTempRef) != 0) {
+				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+				return 1;
+			}
+			if (JSONValueTempRef->type != NUMBER_T) {
+				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+				return 1;
+			}
+
+			lightRef->data.spotLight.angularA0 = JSONValueTempRef->data.dataNumber;
+
+			if (lightRef->data.spotLight.angularA0 < 0) {
+				fprintf(stderr, "Error: Input scene light constants must not be negative\n");
+				return 1;
+			}
+
+			// Read the direction
+			if (JSONObject_get_value("direction", JSONObjectRef, &JSONValueTempRef) != 0) {
+				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+				return 1;
+			}
+			if (JSONValueTempRef->type != ARRAY_T) {
+				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+				return 1;
+			}
+
+			if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &lightRef->data.spotLight.direction) != 0) {
+				return 1;
+			}
+
+			// Normalize the direction
+			v3_normalize(&lightRef->data.spotLight.direction, &lightRef->data.spotLight.direction);
+		}
+	}
+
+	// Read the shape of an area light if it exists
+	if (JSONObject_get_value("shape", JSONObjectRef, &JSONValueTempRef) == 0) {
+		AreaLight *areaLightRef = &lightRef->data.areaLight;
+
+		if (JSONValueTempRef->type != STRING_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (lightRef->type == SPOTLIGHT_T) {
+			fprintf(stderr, "Error: A light can not be both a spot light and an area light\n");
+			return 1;
+		}
+		lightRef->type = AREALIGHT_T;
+
+		if (strcmp(JSONValueTempRef->data.dataString, "rectangle") == 0) {
+			areaLightRef->shape = AREA_RECTANGLE_T;
+			areaLightRef->radius = 0;
+
+			// Read the edges
+			if (JSONObject_get_value("edge-u", JSONObjectRef, &JSONValueTempRef) != 0 || JSONValueTempRef->type != ARRAY_T) {
+				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+				return 1;
+			}
+			if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &areaLightRef->edgeU) != 0)
+				return 1;
+			if (JSONObject_get_value("edge-v", JSONObjectRef, &JSONValueTempRef) != 0 || JSONValueTempRef->type != ARRAY_T) {
+				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+				return 1;
+			}
+			if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &areaLightRef->edgeV) != 0)
+				return 1;
+		}
+		else if (strcmp(JSONValueTempRef->data.dataString, "sphere") == 0) {
+			areaLightRef->shape = AREA_SPHERE_T;
+			memset(&areaLightRef->edgeU, 0, sizeof(V3));
+			memset(&areaLightRef->edgeV, 0, sizeof(V3));
+
+			// Read the radius
+			if (JSONObject_get_value("radius", JSONObjectRef, &JSONValueTempRef) != 0 || JSONValueTempRef->type != NUMBER_T) {
+				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+				return 1;
+			}
+			areaLightRef->radius = JSONValueTempRef->data.dataNumber;
+			if (areaLightRef->radius < 0) {
+				fprintf(stderr, "Error: Radius cannot be negative\n");
+				return 1;
+			}
+		}
+		else {
+			fprintf(stderr, "Error: Unknown area light shape '%s'\n", JSONValueTempRef->data.dataString);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Calculate the world space box around a light, a point for point and spot lights
+ * @param lightRef - The light to bound
+ * @param minRef - The lowest corner of the box is written here
+ * @param maxRef - The highest corner of the box is written here
+ */
+void light_bounds(Light *lightRef, V3 *minRef, V3 *maxRef) {
+	V3 *positionRef = &lightRef->data.pointLight.position;
+
+	for (int i = 0; i < 3; i++) {
+		double extent = 0;
+		if (lightRef->type == AREALIGHT_T) {
+			AreaLight *areaLightRef = &lightRef->data.areaLight;
+			extent = areaLightRef->shape == AREA_SPHERE_T ? areaLightRef->radius :
+					 (fabs(areaLightRef->edgeU.array[i]) + fabs(areaLightRef->edgeV.array[i])) / 2;
+		}
+		minRef->array[i] = positionRef->array[i] - extent;
+		maxRef->array[i] = positionRef->array[i] + extent;
+	}
+}
+
+/**
+ * Sets up an empty scene
+ * @param sceneRef - The scene to initialize
+ */
+void scene_init(Scene *sceneRef) {
+	memset(sceneRef, 0, sizeof(Scene));
+}
+
+/**
+ * Makes room for one more element at the end of one of the scene's arrays, the capacity is
+ * doubled whenever it runs out so appending stays cheap
+ * @param arrayRef - The array to grow
+ * @param lengthRef - The number of elements in use, incremented here
+ * @param capacityRef - The number of elements allocated
+ * @param elementSize - The size of one element
+ * @return The new element, or NULL if the array could not grow
+ */
+void *scene_array_append(void **arrayRef, int *lengthRef, int *capacityRef, size_t elementSize) {
+	if (*lengthRef == *capacityRef) {
+		int capacity = *capacityRef == 0 ? SCENE_INITIAL_CAPACITY : *capacityRef * 2;
+		void *array = realloc(*arrayRef, elementSize * capacity);
+		if (array == NULL) {
+			fprintf(stderr, "Error: Could not allocate space for %i scene objects\n", capacity);
+			return NULL;
+		}
+		*arrayRef = array;
+		*capacityRef = capacity;
+	}
+
+	// Start zeroed so a scene that fails part way through an element can still be freed
+	void *elementRef = (char *) *arrayRef + elementSize * (*lengthRef)++;
+	memset(elementRef, 0, elementSize);
+	return elementRef;
+}
+
+/**
+ * Releases the unused capacity at the end of one of the scene's arrays
+ * @param arrayRef - The array to shrink
+ * @param length - The number of elements in use
+ * @param capacityRef - The number of elements allocated
+ * @param elementSize - The size of one element
+ */
+void scene_array_shrink(void **arrayRef, int length, int *capacityRef, size_t elementSize) {
+	if (length == *capacityRef)
+		return;
+
+	if (length == 0) {
+		free(*arrayRef);
+		*arrayRef = NULL;
+	}
+	else {
+		void *array = realloc(*arrayRef, elementSize * length);
+		if (array != NULL)
+			*arrayRef = array;
+	}
+	*capacityRef = length;
+}
+
+/**
+ * Adds one value of the top level scene array to a scene, matches JSONValueCallback so scenes can
+ * be read a value at a time
+ * @param JSONValueRef - The value to add, it must be an object with a type
+ * @param sceneRef - The scene to add to
  * @return 0 if success, otherwise a failure occurred
  */
-int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
+int add_JSONValue_to_scene(JSONValue *JSONValueRef, void *sceneRef) {
+	Scene *sceneTempRef = sceneRef;
 	JSONObject *JSONObjectTempRef;
 	JSONValue *JSONValueTempRef;
-	JSONArray *JSONSceneArrayRef;
 
-	// Make sure that we were passed a JSONArray
-	if (JSONValueSceneRef->type != ARRAY_T) {
+	// Everything should be an object with a type
+	if (JSONValueRef->type != OBJECT_T) {
 		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
 		return 1;
 	}
-	JSONSceneArrayRef = JSONValueSceneRef->data.dataArray;
+	JSONObjectTempRef = JSONValueRef->data.dataObject;
 
-	int size = JSONSceneArrayRef->length - 1;
-	sceneRef->primitives = malloc(sizeof(Primitive*) * size);
-	sceneRef->lights = malloc(sizeof(Light*) * size);
+	if (JSONObject_get_value("type", JSONObjectTempRef, &JSONValueTempRef) != 0) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	if (JSONValueTempRef->type != STRING_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
 
-	int primitivesLength = 0;
-	int lightsLength = 0;
-	for (int i = 0; i < JSONSceneArrayRef->length; i++) {
-		// Look at the objects we loaded in JSON
-		if (JSONSceneArrayRef->values[i]->type == OBJECT_T) {
-			// Everything should have a type
-			JSONObjectTempRef = JSONSceneArrayRef->values[i]->data.dataObject;
+	char *type = JSONValueTempRef->data.dataString;
+	if (strcmp(type, "camera") == 0) {
+		// We found a camera
 
-			if (JSONObject_get_value("type", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-				return 1;
-			}
-			if (JSONValueTempRef->type != STRING_T) {
-				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-				return 1;
-			}
+		// Read the height
+		if (JSONObject_get_value("height", JSONObjectTempRef, &JSONValueTempRef) != 0) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONValueTempRef->data.dataNumber < 0) {
+			fprintf(stderr, "Error: Negative camera height is not allowed\n");
+			return 1;
+		}
+		sceneTempRef->camera.height = JSONValueTempRef->data.dataNumber;
+
+		// Read the width
+		if (JSONObject_get_value("width", JSONObjectTempRef, &JSONValueTempRef) != 0) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONValueTempRef->type != NUMBER_T) {
+			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+			return 1;
+		}
+		if (JSONValueTempRef->data.dataNumber < 0) {
+			fprintf(stderr, "Error: Negative camera width is not allowed\n");
+			return 1;
+		}
+		sceneTempRef->camera.width = JSONValueTempRef->data.dataNumber;
+		sceneTempRef->hasCamera = 1;
+	}
+	else if (strcmp(type, "sphere") == 0) {
+		Sphere *sphereRef = scene_array_append((void **) &sceneTempRef->spheres, &sceneTempRef->spheresLength,
+											   &sceneTempRef->spheresCapacity, sizeof(Sphere));
+		if (sphereRef == NULL || JSONObject_to_sphere(JSONObjectTempRef, sphereRef) != 0)
+			return 1;
+	}
+	else if (strcmp(type, "plane") == 0) {
+		Plane *planeRef = scene_array_append((void **) &sceneTempRef->planes, &sceneTempRef->planesLength,
+											 &sceneTempRef->planesCapacity, sizeof(Plane));
+		if (planeRef == NULL || JSONObject_to_plane(JSONObjectTempRef, planeRef) != 0)
+			return 1;
+	}
+	else if (strcmp(type, "mesh") == 0) {
+		TriangleMesh *meshRef = scene_array_append((void **) &sceneTempRef->meshes, &sceneTempRef->meshesLength,
+												   &sceneTempRef->meshesCapacity, sizeof(TriangleMesh));
+		if (meshRef == NULL || JSONObject_to_mesh(JSONObjectTempRef, sceneTempRef->directory, meshRef) != 0)
+			return 1;
+	}
+	else if (strcmp(type, "group") == 0) {
+		// Groups are only drawn through instances
+		if (JSONObject_to_group(JSONObjectTempRef, sceneTempRef) != 0)
+			return 1;
+	}
+	else if (strcmp(type, "instance") == 0) {
+		Instance *instanceRef = scene_array_append((void **) &sceneTempRef->instances, &sceneTempRef->instancesLength,
+												   &sceneTempRef->instancesCapacity, sizeof(Instance));
+		if (instanceRef == NULL || JSONObject_to_instance(JSONObjectTempRef, sceneTempRef, instanceRef) != 0)
+			return 1;
+	}
+	else if (strcmp(type, "light") == 0) {
+		Light *lightRef = scene_array_append((void **) &sceneTempRef->lights, &sceneTempRef->lightsLength,
+											 &sceneTempRef->lightsCapacity, sizeof(Light));
+		if (lightRef == NULL || JSONObject_to_light(JSONObjectTempRef, lightRef) != 0)
+			return 1;
+	}
+	else {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
 
+	return 0;
+}
 
-			if (strcmp(JSONValueTempRef->data.dataString, "camera") == 0) {
-				// We found a camera
-
-				// Read the height
-				if (JSONObject_get_value("height", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != NUMBER_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->data.dataNumber < 0) {
-					fprintf(stderr, "Error: Negative camera height is not allowed\n");
-					return 1;
-				}
-				sceneRef->camera.height = JSONValueTempRef->data.dataNumber;
-
-				// Read the width
-
-				if (JSONObject_get_value("width", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != NUMBER_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->data.dataNumber < 0) {
-					fprintf(stderr, "Error: Negative camera width is not allowed\n");
-					return 1;
-				}
-
-				sceneRef->camera.width = JSONValueTempRef->data.dataNumber;
-			}
-			else if (strcmp(JSONValueTempRef->data.dataString, "sphere") == 0) {
-				// We found a sphere
-				sceneRef->primitives[primitivesLength] = malloc(sizeof(Primitive));
-				sceneRef->primitives[primitivesLength]->type = SPHERE_T;
-
-				// Read the diffuse color
-				if (JSONObject_get_value("diffuse_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.sphere.diffuseColor) != 0) {
-					return 1;
-				}
-
-				// Check colors
-				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.sphere.diffuseColor.array[j] < 0) {
-						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
-					}
-					if (sceneRef->primitives[primitivesLength]->data.sphere.diffuseColor.array[j] > 1) {
-						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
-					}
-				}
-
-				// Read the specular color
-				if (JSONObject_get_value("specular_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.sphere.specularColor) != 0) {
-					return 1;
-				}
-
-				// Check colors
-				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.sphere.specularColor.array[j] < 0) {
-						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
-					}
-					if (sceneRef->primitives[primitivesLength]->data.sphere.specularColor.array[j] > 1) {
-						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
-					}
-				}
-
-				// Read the position
-				if (JSONObject_get_value("position", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.sphere.position) != 0) {
-					return 1;
-				}
-
-				// Read the radius
-				if (JSONObject_get_value("radius", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != NUMBER_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->data.dataNumber < 0) {
-					fprintf(stderr, "Error: Negative sphere radius is not allowed\n");
-					return 1;
-				}
-
-				sceneRef->primitives[primitivesLength]->data.sphere.radius = JSONValueTempRef->data.dataNumber;
-				primitivesLength++;
-			}
-			else if (strcmp(JSONValueTempRef->data.dataString, "plane") == 0) {
-				// We found a plane
-				sceneRef->primitives[primitivesLength] = malloc(sizeof(Primitive));
-				sceneRef->primitives[primitivesLength]->type = PLANE_T;
-
-				// Read the diffuse color
-				if (JSONObject_get_value("diffuse_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.diffuseColor) != 0) {
-					return 1;
-				}
-
-				// Check colors
-				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.plane.diffuseColor.array[j] < 0) {
-						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
-					}
-					if (sceneRef->primitives[primitivesLength]->data.plane.diffuseColor.array[j] > 1) {
-						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
-					}
-				}
-
-				// Read the specular color
-				if (JSONObject_get_value("specular_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.specularColor) != 0) {
-					return 1;
-				}
-
-				// Check colors
-				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.plane.specularColor.array[j] < 0) {
-						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
-					}
-					if (sceneRef->primitives[primitivesLength]->data.plane.specularColor.array[j] > 1) {
-						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
-					}
-				}
-
-				// Read the position
-				if (JSONObject_get_value("position", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.position) != 0) {
-					return 1;
-				}
-
-				// Read the normal
-				if (JSONObject_get_value("normal", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.normal) != 0) {
-					return 1;
-				}
-
-				// Normalize the direction
-				v3_normalize(&sceneRef->primitives[primitivesLength]->data.plane.normal, &sceneRef->primitives[primitivesLength]->data.plane.normal);
-
-				primitivesLength++;
-			}
-			else if (strcmp(JSONValueTempRef->data.dataString, "light") == 0) {
-				// We found a point light
-				sceneRef->lights[lightsLength] = malloc(sizeof(Light));
-				sceneRef->lights[lightsLength]->type = POINTLIGHT_T;
-
-				// Read the color
-				if (JSONObject_get_value("color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->lights[lightsLength]->data.pointLight.color) != 0) {
-					return 1;
-				}
-
-				// Check colors
-				for (int j = 0; j < 3; j++) {
-					if (sceneRef->lights[lightsLength]->data.pointLight.color.array[j] < 0) {
-						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
-					}
-				}
-
-				// Read the position
-				if (JSONObject_get_value("position", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-				if (JSONValueTempRef->type != ARRAY_T) {
-					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
-				}
-
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->lights[lightsLength]->data.pointLight.position) != 0) {
-					return 1;
-				}
-
-				// Read the radialA2
-				if (JSONObject_get_value("radial-a2", JSONObjectTempRef, &JSONValueTempRef) == 0) {
-					if (JSONValueTempRef->type != NUMBER_T) {
-						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
-					}
-
-					sceneRef->lights[lightsLength]->data.pointLight.radialA2 = JSONValueTempRef->data.dataNumber;
-				}
-				else {
-					sceneRef->lights[lightsLength]->data.pointLight.radialA2 = 1;
-				}
-
-				// Read the radialA1
-				if (JSONObject_get_value("radial-a1", JSONObjectTempRef, &JSONValueTempRef) == 0) {
-					if (JSONValueTempRef->type != NUMBER_T) {
-						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
-					}
-
-					sceneRef->lights[lightsLength]->data.pointLight.radialA1 = JSONValueTempRef->data.dataNumber;
-				}
-				else {
-					sceneRef->lights[lightsLength]->data.pointLight.radialA1 = 0;
-				}
-
-				// Read the radialA0
-				if (JSONObject_get_value("radial-a0", JSONObjectTempRef, &JSONValueTempRef) == 0) {
-					if (JSONValueTempRef->type != NUMBER_T) {
-						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
-					}
-
-					sceneRef->lights[lightsLength]->data.pointLight.radialA0 = JSONValueTempRef->data.dataNumber;
-				}
-				else {
-					sceneRef->lights[lightsLength]->data.pointLight.radialA0 = 0;
-				}
-
-				// Ensure that A0, A1, and A2 are not all 0
-				if (sceneRef->lights[lightsLength]->data.pointLight.radialA0 == 0 &&
-						sceneRef->lights[lightsLength]->data.pointLight.radialA1 == 0 &&
-						sceneRef->lights[lightsLength]->data.pointLight.radialA2 == 0) {
-					fprintf(stderr, "Error: Input scene light constants must have one constant not equal to 0\n");
-					return 1;
-				}
-
-				if (sceneRef->lights[lightsLength]->data.pointLight.radialA0 < 0 ||
-					sceneRef->lights[lightsLength]->data.pointLight.radialA1 < 0 ||
-					sceneRef->lights[lightsLength]->data.pointLight.radialA2 < 0) {
-					fprintf(stderr, "Error: Input scene light constants must not be negative\n");
-					return 1;
-				}
-
-				// Read the angularA0 if it exists
-				if (JSONObject_get_value("theta", JSONObjectTempRef, &JSONValueTempRef) == 0) {
-					if (JSONValueTempRef->type != NUMBER_T) {
-						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
-					}
-
-					if (JSONValueTempRef->data.dataNumber != 0) {
-						sceneRef->lights[lightsLength]->type = SPOTLIGHT_T;
-
-						// Translate Theta into radians
-						sceneRef->lights[lightsLength]->data.spotLight.theta = (float) (JSONValueTempRef->data.dataNumber * (M_PI/180));
-
-
-						if (JSONObject_get_value("angular-a0", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
-						}
-						if (JSONValueTempRef->type != NUMBER_T) {
-							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
-						}
-
-						sceneRef->lights[lightsLength]->data.spotLight.angularA0 = JSONValueTempRef->data.dataNumber;
-
-						if (sceneRef->lights[lightsLength]->data.spotLight.angularA0 < 0) {
-							fprintf(stderr, "Error: Input scene light constants must not be negative\n");
-							return 1;
-						}
-
-						// Read the direction
-						if (JSONObject_get_value("direction", JSONObjectTempRef, &JSONValueTempRef) != 0) {
-							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
-						}
-						if (JSONValueTempRef->type != ARRAY_T) {
-							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
-						}
-
-						if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->lights[lightsLength]->data.spotLight.direction) != 0) {
-							return 1;
-						}
-
-						// Normalize the direction
-						v3_normalize(&sceneRef->lights[lightsLength]->data.spotLight.direction, &sceneRef->lights[lightsLength]->data.spotLight.direction);
-					}
-				}
-
-				lightsLength++;
-			}
-			else {
-				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+/**
+ * Determine if a specular color adds anything to shading
+ */
+static int has_specular(V3 *colorRef) {
+	return !(colorRef->data.X == 0 && colorRef->data.Y == 0 && colorRef->data.Z == 0);
+}
+
+/**
+ * Determine the features of a scene that shading has to handle, used to pick a shading kernel
+ * @param sceneRef - The scene to check
+ * @return The SceneFeature_t flags of the scene
+ */
+int scene_features(Scene *sceneRef) {
+	int features = 0;
+
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		if (sceneRef->lights[i].type == SPOTLIGHT_T)
+			features |= SCENE_FEATURE_SPOT_LIGHTS;
+		else if (sceneRef->lights[i].type == AREALIGHT_T)
+			features |= SCENE_FEATURE_AREA_LIGHTS;
+	}
+
+	if (sceneRef->instancesLength > 0 || sceneRef->meshesLength > 0)
+		features |= SCENE_FEATURE_CHILDREN;
+
+	for (int i = 0; i < sceneRef->spheresLength; i++) {
+		if (has_specular(&sceneRef->spheres[i].specularColor))
+			features |= SCENE_FEATURE_SPECULAR;
+	}
+	for (int i = 0; i < sceneRef->planesLength; i++) {
+		if (has_specular(&sceneRef->planes[i].specularColor))
+			features |= SCENE_FEATURE_SPECULAR;
+	}
+	for (int i = 0; i < sceneRef->meshesLength; i++) {
+		if (has_specular(&sceneRef->meshes[i].specularColor))
+			features |= SCENE_FEATURE_SPECULAR;
+	}
+	// Only the groups placed by an instance are ever hit, but every group is checked
+	for (int i = 0; i < sceneRef->groupsLength; i++) {
+		Group *groupRef = &sceneRef->groups[i];
+		for (int j = 0; j < groupRef->primitivesLength; j++) {
+			Primitive *primitiveRef = &groupRef->primitives[j];
+			V3 *colorRef = primitiveRef->type == SPHERE_T ? &primitiveRef->data.sphere.specularColor :
+						   &primitiveRef->data.plane.specularColor;
+			if (has_specular(colorRef))
+				features |= SCENE_FEATURE_SPECULAR;
+		}
+	}
+
+	return features;
+}
+
+/**
+ * Checks a scene once every value has been added and trims its arrays to size
+ * @param sceneRef - The scene to finish
+ * @return 0 if success, otherwise a failure occurred
+ */
+int scene_finish(Scene *sceneRef) {
+	if (!sceneRef->hasCamera) {
+		fprintf(stderr, "Error: Input scene JSON file does not contain a camera\n");
+		return 1;
+	}
+
+	for (int i = 0; i < sceneRef->groupsLength; i++) {
+		if (!sceneRef->groups[i].isDefined) {
+			fprintf(stderr, "Error: Instance refers to unknown group '%s'\n", sceneRef->groups[i].name);
+			return 1;
+		}
+	}
+
+	scene_array_shrink((void **) &sceneRef->spheres, sceneRef->spheresLength, &sceneRef->spheresCapacity, sizeof(Sphere));
+	scene_array_shrink((void **) &sceneRef->planes, sceneRef->planesLength, &sceneRef->planesCapacity, sizeof(Plane));
+	scene_array_shrink((void **) &sceneRef->instances, sceneRef->instancesLength, &sceneRef->instancesCapacity, sizeof(Instance));
+	scene_array_shrink((void **) &sceneRef->meshes, sceneRef->meshesLength, &sceneRef->meshesCapacity, sizeof(TriangleMesh));
+	scene_array_shrink((void **) &sceneRef->lights, sceneRef->lightsLength, &sceneRef->lightsCapacity, sizeof(Light));
+	scene_array_shrink((void **) &sceneRef->groups, sceneRef->groupsLength, &sceneRef->groupsCapacity, sizeof(Group));
+
+	sceneRef->primitivesLength = sceneRef->spheresLength + sceneRef->planesLength +
+								 sceneRef->instancesLength + sceneRef->meshesLength;
+
+	return 0;
+}
+
+/**
+ * Releases everything held by a scene
+ * @param sceneRef - The scene to free
+ */
+void scene_free(Scene *sceneRef) {
+	for (int i = 0; i < sceneRef->meshesLength; i++)
+		mesh_free(&sceneRef->meshes[i].mesh);
+	for (int i = 0; i < sceneRef->groupsLength; i++) {
+		free(sceneRef->groups[i].name);
+		free(sceneRef->groups[i].primitives);
+	}
+
+	free(sceneRef->spheres);
+	free(sceneRef->planes);
+	free(sceneRef->instances);
+	free(sceneRef->meshes);
+	free(sceneRef->lights);
+	free(sceneRef->groups);
+	scene_init(sceneRef);
+}
+
+/**
+ * Calculate the number of bytes a scene holds in its arrays, meshes and groups
+ * @param sceneRef - The scene to measure
+ * @return The size of the scene in bytes
+ */
+size_t scene_size(Scene *sceneRef) {
+	size_t size = sizeof(Sphere) * sceneRef->spheresLength + sizeof(Plane) * sceneRef->planesLength +
+				  sizeof(Instance) * sceneRef->instancesLength + sizeof(TriangleMesh) * sceneRef->meshesLength +
+				  sizeof(Light) * sceneRef->lightsLength + sizeof(Group) * sceneRef->groupsLength;
+
+	for (int i = 0; i < sceneRef->meshesLength; i++) {
+		Mesh *meshRef = &sceneRef->meshes[i].mesh;
+		size += sizeof(float) * 3 * meshRef->verticesLength + sizeof(uint32_t) * 3 * meshRef->trianglesLength +
+				sizeof(MeshNode) * meshRef->nodesLength;
+	}
+	for (int i = 0; i < sceneRef->groupsLength; i++)
+		size += sizeof(Primitive) * sceneRef->groups[i].primitivesLength + strlen(sceneRef->groups[i].name) + 1;
+
+	return size;
+}
+
+/**
+ * Allocates a copy of an array, an empty array is copied as NULL
+ * @param source - The array to copy
+ * @param length - The number of elements in the array
+ * @param elementSize - The size of one element
+ * @param copyRef - The copy is written here
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int scene_array_copy(void *source, size_t length, size_t elementSize, void **copyRef) {
+	*copyRef = NULL;
+	if (length == 0)
+		return 0;
+
+	*copyRef = malloc(elementSize * length);
+	if (*copyRef == NULL)
+		return 1;
+
+	memcpy(*copyRef, source, elementSize * length);
+	return 0;
+}
+
+/**
+ * Makes a deep copy of a finished scene, the copy's memory is placed by the calling thread so a
+ * thread can keep a copy of the scene close to the cores it runs on
+ * @param sourceRef - The scene to copy
+ * @param sceneRef - The scene to copy into
+ * @return 0 if success, otherwise a failure occurred
+ */
+int scene_copy(Scene *sourceRef, Scene *sceneRef) {
+	int result = 0;
+
+	*sceneRef = *sourceRef;
+	sceneRef->spheresCapacity = sceneRef->spheresLength;
+	sceneRef->planesCapacity = sceneRef->planesLength;
+	sceneRef->instancesCapacity = sceneRef->instancesLength;
+	sceneRef->meshesCapacity = sceneRef->meshesLength;
+	sceneRef->lightsCapacity = sceneRef->lightsLength;
+	sceneRef->groupsCapacity = sceneRef->groupsLength;
+
+	result |= scene_array_copy(sourceRef->spheres, sourceRef->spheresLength, sizeof(Sphere), (void **) &sceneRef->spheres);
+	result |= scene_array_copy(sourceRef->planes, sourceRef->planesLength, sizeof(Plane), (void **) &sceneRef->planes);
+	result |= scene_array_copy(sourceRef->instances, sourceRef->instancesLength, sizeof(Instance), (void **) &sceneRef->instances);
+	result |= scene_array_copy(sourceRef->lights, sourceRef->lightsLength, sizeof(Light), (void **) &sceneRef->lights);
+
+	// The nested buffers are cleared first so a failed copy can be freed
+	sceneRef->meshesLength = 0;
+	sceneRef->groupsLength = 0;
+	result |= scene_array_copy(sourceRef->meshes, sourceRef->meshesLength, sizeof(TriangleMesh), (void **) &sceneRef->meshes);
+	result |= scene_array_copy(sourceRef->groups, sourceRef->groupsLength, sizeof(Group), (void **) &sceneRef->groups);
+	if (result != 0) {
+		scene_free(sceneRef);
+		fprintf(stderr, "Error: Could not allocate a copy of the scene\n");
+		return 1;
+	}
+
+	for (int i = 0; i < sourceRef->meshesLength; i++) {
+		Mesh *sourceMeshRef = &sourceRef->meshes[i].mesh;
+		Mesh *meshRef = &sceneRef->meshes[i].mesh;
+		sceneRef->meshesLength++;
+		result |= scene_array_copy(sourceMeshRef->vertices, sourceMeshRef->verticesLength, sizeof(float) * 3, (void **) &meshRef->vertices);
+		result |= scene_array_copy(sourceMeshRef->indices, sourceMeshRef->trianglesLength, sizeof(uint32_t) * 3, (void **) &meshRef->indices);
+		result |= scene_array_copy(sourceMeshRef->nodes, sourceMeshRef->nodesLength, sizeof(MeshNode), (void **) &meshRef->nodes);
+	}
+	for (int i = 0; i < sourceRef->groupsLength; i++) {
+		Group *sourceGroupRef = &sourceRef->groups[i];
+		Group *groupRef = &sceneRef->groups[i];
+		sceneRef->groupsLength++;
+		result |= scene_array_copy(sourceGroupRef->name, strlen(sourceGroupRef->name) + 1, sizeof(char), (void **) &groupRef->name);
+		result |= scene_array_copy(sourceGroupRef->primitives, sourceGroupRef->primitivesLength, sizeof(Primitive), (void **) &groupRef->primitives);
+	}
+	if (result != 0) {
+		scene_free(sceneRef);
+		fprintf(stderr, "Error: Could not allocate a copy of the scene\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Brings a copy made by scene_copy up to date with its source. When the source still has the same
+ * number of every object, mesh element and group primitive the contents are copied over the
+ * existing arrays so nothing is allocated, otherwise the copy is made again.
+ * @param sourceRef - The scene to copy
+ * @param sceneRef - The copy to update
+ * @return 0 if success, otherwise a failure occurred
+ */
+int scene_copy_update(Scene *sourceRef, Scene *sceneRef) {
+	int isSameLayout = sourceRef->spheresLength == sceneRef->spheresLength &&
+					   sourceRef->planesLength == sceneRef->planesLength &&
+					   sourceRef->instancesLength == sceneRef->instancesLength &&
+					   sourceRef->meshesLength == sceneRef->meshesLength &&
+					   sourceRef->lightsLength == sceneRef->lightsLength &&
+					   sourceRef->groupsLength == sceneRef->groupsLength;
+
+	for (int i = 0; isSameLayout && i < sourceRef->meshesLength; i++) {
+		Mesh *sourceMeshRef = &sourceRef->meshes[i].mesh;
+		Mesh *meshRef = &sceneRef->meshes[i].mesh;
+		isSameLayout = sourceMeshRef->verticesLength == meshRef->verticesLength &&
+					   sourceMeshRef->trianglesLength == meshRef->trianglesLength &&
+					   sourceMeshRef->nodesLength == meshRef->nodesLength;
+	}
+	for (int i = 0; isSameLayout && i < sourceRef->groupsLength; i++) {
+		isSameLayout = sourceRef->groups[i].primitivesLength == sceneRef->groups[i].primitivesLength &&
+					   strcmp(sourceRef->groups[i].name, sceneRef->groups[i].name) == 0;
+	}
+
+	if (!isSameLayout) {
+		scene_free(sceneRef);
+		return scene_copy(sourceRef, sceneRef);
+	}
+
+	sceneRef->camera = sourceRef->camera;
+	sceneRef->hasCamera = sourceRef->hasCamera;
+	sceneRef->primitivesLength = sourceRef->primitivesLength;
+	// Empty arrays are NULL in both scenes
+	if (sourceRef->spheresLength > 0)
+		memcpy(sceneRef->spheres, sourceRef->spheres, sizeof(Sphere) * sourceRef->spheresLength);
+	if (sourceRef->planesLength > 0)
+		memcpy(sceneRef->planes, sourceRef->planes, sizeof(Plane) * sourceRef->planesLength);
+	if (sourceRef->instancesLength > 0)
+		memcpy(sceneRef->instances, sourceRef->instances, sizeof(Instance) * sourceRef->instancesLength);
+	if (sourceRef->lightsLength > 0)
+		memcpy(sceneRef->lights, sourceRef->lights, sizeof(Light) * sourceRef->lightsLength);
+
+	for (int i = 0; i < sourceRef->meshesLength; i++) {
+		TriangleMesh *sourceMeshRef = &sourceRef->meshes[i];
+		TriangleMesh *meshRef = &sceneRef->meshes[i];
+		meshRef->diffuseColor = sourceMeshRef->diffuseColor;
+		meshRef->specularColor = sourceMeshRef->specularColor;
+		meshRef->reflectivity = sourceMeshRef->reflectivity;
+		memcpy(meshRef->mesh.vertices, sourceMeshRef->mesh.vertices, sizeof(float) * 3 * sourceMeshRef->mesh.verticesLength);
+		memcpy(meshRef->mesh.indices, sourceMeshRef->mesh.indices, sizeof(uint32_t) * 3 * sourceMeshRef->mesh.trianglesLength);
+		memcpy(meshRef->mesh.nodes, sourceMeshRef->mesh.nodes, sizeof(MeshNode) * sourceMeshRef->mesh.nodesLength);
+	}
+	for (int i = 0; i < sourceRef->groupsLength; i++) {
+		Group *sourceGroupRef = &sourceRef->groups[i];
+		Group *groupRef = &sceneRef->groups[i];
+		groupRef->isDefined = sourceGroupRef->isDefined;
+		groupRef->boundCenter = sourceGroupRef->boundCenter;
+		groupRef->boundRadius = sourceGroupRef->boundRadius;
+		if (sourceGroupRef->primitivesLength > 0)
+			memcpy(groupRef->primitives, sourceGroupRef->primitives, sizeof(Primitive) * sourceGroupRef->primitivesLength);
+	}
+
+	return 0;
+}
+
+/**
+ * Appends the contents of another scene to a scene, the arrays of the source are released as
+ * they are copied so little more than the combined scene is ever resident. Whatever has not yet
+ * moved to the scene stays in the source, which can always be freed with scene_free after a
+ * failure.
+ * @param sceneRef - The scene to append to
+ * @param sourceRef - The scene to append, it is left empty
+ * @return 0 if success, otherwise a failure occurred
+ */
+int scene_merge(Scene *sceneRef, Scene *sourceRef) {
+	int *groupIds = malloc(sizeof(int) * (sourceRef->groupsLength + 1));
+	if (groupIds == NULL) {
+		fprintf(stderr, "Error: Could not allocate space for %i group ids\n", sourceRef->groupsLength);
+		return 1;
+	}
+
+	// A group defined twice is found before either scene is changed
+	for (int i = 0; i < sourceRef->groupsLength; i++) {
+		if (!sourceRef->groups[i].isDefined)
+			continue;
+		for (int j = 0; j < sceneRef->groupsLength; j++) {
+			if (sceneRef->groups[j].isDefined && strcmp(sceneRef->groups[j].name, sourceRef->groups[i].name) == 0) {
+				fprintf(stderr, "Error: Group '%s' is defined more than once\n", sourceRef->groups[i].name);
+				free(groupIds);
 				return 1;
 			}
 		}
-		else {
-			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+	}
+
+	if (sourceRef->hasCamera) {
+		sceneRef->camera = sourceRef->camera;
+		sceneRef->hasCamera = 1;
+	}
+
+	// Groups are matched by name, instances are pointed at the merged groups
+	for (int i = 0; i < sourceRef->groupsLength; i++) {
+		Group *sourceGroupRef = &sourceRef->groups[i];
+		groupIds[i] = scene_find_group(sceneRef, sourceGroupRef->name);
+		if (groupIds[i] == -1) {
+			free(groupIds);
 			return 1;
 		}
 
-		sceneRef->primitivesLength = primitivesLength;
-		sceneRef->lightsLength = lightsLength;
+		Group *groupRef = &sceneRef->groups[groupIds[i]];
+		if (sourceGroupRef->isDefined) {
+			free(groupRef->name);
+			*groupRef = *sourceGroupRef;
+			sourceGroupRef->primitives = NULL;
+			sourceGroupRef->primitivesLength = 0;
+		}
+		else {
+			free(sourceGroupRef->name);
+		}
+		sourceGroupRef->name = NULL;
+	}
+	for (int i = 0; i < sourceRef->instancesLength; i++)
+		sourceRef->instances[i].groupId = groupIds[sourceRef->instances[i].groupId];
+	free(groupIds);
+	free(sourceRef->groups);
+	sourceRef->groups = NULL;
+	sourceRef->groupsLength = 0;
+	sourceRef->groupsCapacity = 0;
+
+	if (scene_array_concat((void **) &sceneRef->spheres, &sceneRef->spheresLength, &sceneRef->spheresCapacity,
+						   (void **) &sourceRef->spheres, &sourceRef->spheresLength, &sourceRef->spheresCapacity, sizeof(Sphere)) != 0 ||
+		scene_array_concat((void **) &sceneRef->planes, &sceneRef->planesLength, &sceneRef->planesCapacity,
+						   (void **) &sourceRef->planes, &sourceRef->planesLength, &sourceRef->planesCapacity, sizeof(Plane)) != 0 ||
+		scene_array_concat((void **) &sceneRef->instances, &sceneRef->instancesLength, &sceneRef->instancesCapacity,
+						   (void **) &sourceRef->instances, &sourceRef->instancesLength, &sourceRef->instancesCapacity, sizeof(Instance)) != 0 ||
+		scene_array_concat((void **) &sceneRef->meshes, &sceneRef->meshesLength, &sceneRef->meshesCapacity,
+						   (void **) &sourceRef->meshes, &sourceRef->meshesLength, &sourceRef->meshesCapacity, sizeof(TriangleMesh)) != 0 ||
+		scene_array_concat((void **) &sceneRef->lights, &sceneRef->lightsLength, &sceneRef->lightsCapacity,
+						   (void **) &sourceRef->lights, &sourceRef->lightsLength, &sourceRef->lightsCapacity, sizeof(Light)) != 0)
+		return 1;
+
+	scene_init(sourceRef);
+	return 0;
+}
+
+/**
+ * Appends one of a scene's arrays to another and frees the appended array, which is left empty.
+ * If the space can not be allocated the appended array is left as it was.
+ * @param arrayRef - The array to append to
+ * @param lengthRef - The number of elements in use, increased here
+ * @param capacityRef - The number of elements allocated
+ * @param sourceRef - The array to append, it is freed and set to NULL
+ * @param sourceLengthRef - The number of elements to append, set to 0
+ * @param sourceCapacityRef - The number of elements allocated for the array to append, set to 0
+ * @param elementSize - The size of one element
+ * @return 0 if success, otherwise a failure occurred
+ */
+int scene_array_concat(void **arrayRef, int *lengthRef, int *capacityRef, void **sourceRef, int *sourceLengthRef,
+					   int *sourceCapacityRef, size_t elementSize) {
+	int sourceLength = *sourceLengthRef;
+
+	if (sourceLength > 0 && *lengthRef + sourceLength > *capacityRef) {
+		void *array = realloc(*arrayRef, elementSize * (*lengthRef + sourceLength));
+		if (array == NULL) {
+			fprintf(stderr, "Error: Could not allocate space for %i scene objects\n", *lengthRef + sourceLength);
+			return 1;
+		}
+		*arrayRef = array;
+		*capacityRef = *lengthRef + sourceLength;
 	}
 
+	if (sourceLength > 0)
+		memcpy((char *) *arrayRef + elementSize * *lengthRef, *sourceRef, elementSize * sourceLength);
+	*lengthRef += sourceLength;
+	free(*sourceRef);
+	*sourceRef = NULL;
+	*sourceLengthRef = 0;
+	*sourceCapacityRef = 0;
 	return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * SceneLoader - Shared state of the threads loading the chunks of a scene file. Finished chunks
+ * are merged into the scene in file order by whichever thread finds the next one ready, so only
+ * the chunks waiting on an earlier one are held on the side.
+ */
+typedef struct SceneLoader {
+	JSONArrayChunks chunks;
+	Scene *sceneRef;
+	Scene *chunkScenes;
+	int *chunkResults;
+	char *chunkDone;
+	int nextChunk;
+	int nextMerge;
+	int isMerging;
+	int result;
+	pthread_mutex_t mutex;
+} SceneLoader;
+
+/**
+ * Thread body of create_scene_from_file, takes chunks in order until none are left, adds the
+ * values of each to the chunk's own scene and merges every chunk that is ready
+ * @param loaderRef - The SceneLoader shared by all threads
+ * @return NULL
+ */
+void *scene_loader_thread(void *loaderRef) {
+	SceneLoader *sceneLoaderRef = loaderRef;
+
+	while (1) {
+		pthread_mutex_lock(&sceneLoaderRef->mutex);
+		int chunk = sceneLoaderRef->nextChunk++;
+		int result = sceneLoaderRef->result;
+		pthread_mutex_unlock(&sceneLoaderRef->mutex);
+
+		if (chunk >= sceneLoaderRef->chunks.chunksLength)
+			break;
+
+		// Chunks after a failure are still marked done so they get freed
+		Scene *chunkSceneRef = &sceneLoaderRef->chunkScenes[chunk];
+		if (result == 0) {
+			sceneLoaderRef->chunkResults[chunk] = read_json_array_chunk(&sceneLoaderRef->chunks, chunk,
+																		add_JSONValue_to_scene, chunkSceneRef);
+
+			// Give back the unused capacity, the chunk may wait a while before being merged
+			scene_array_shrink((void **) &chunkSceneRef->spheres, chunkSceneRef->spheresLength, &chunkSceneRef->spheresCapacity, sizeof(Sphere));
+			scene_array_shrink((void **) &chunkSceneRef->planes, chunkSceneRef->planesLength, &chunkSceneRef->planesCapacity, sizeof(Plane));
+			scene_array_shrink((void **) &chunkSceneRef->instances, chunkSceneRef->instancesLength, &chunkSceneRef->instancesCapacity, sizeof(Instance));
+			scene_array_shrink((void **) &chunkSceneRef->meshes, chunkSceneRef->meshesLength, &chunkSceneRef->meshesCapacity, sizeof(TriangleMesh));
+			scene_array_shrink((void **) &chunkSceneRef->lights, chunkSceneRef->lightsLength, &chunkSceneRef->lightsCapacity, sizeof(Light));
+		}
+		else {
+			sceneLoaderRef->chunkResults[chunk] = 1;
+		}
+
+		pthread_mutex_lock(&sceneLoaderRef->mutex);
+		sceneLoaderRef->chunkDone[chunk] = 1;
+		if (sceneLoaderRef->isMerging) {
+			pthread_mutex_unlock(&sceneLoaderRef->mutex);
+			continue;
+		}
+
+		sceneLoaderRef->isMerging = 1;
+		while (sceneLoaderRef->nextMerge < sceneLoaderRef->chunks.chunksLength &&
+			   sceneLoaderRef->chunkDone[sceneLoaderRef->nextMerge]) {
+			int merge = sceneLoaderRef->nextMerge++;
+			int mergeResult = sceneLoaderRef->result;
+			pthread_mutex_unlock(&sceneLoaderRef->mutex);
+
+			// After a failure the remaining chunks are only freed
+			if (mergeResult == 0 && sceneLoaderRef->chunkResults[merge] == 0)
+				mergeResult = scene_merge(sceneLoaderRef->sceneRef, &sceneLoaderRef->chunkScenes[merge]);
+			else
+				mergeResult = 1;
+			if (mergeResult != 0)
+				scene_free(&sceneLoaderRef->chunkScenes[merge]);
+
+			pthread_mutex_lock(&sceneLoaderRef->mutex);
+			if (mergeResult != 0)
+				sceneLoaderRef->result = 1;
+		}
+		sceneLoaderRef->isMerging = 0;
+		pthread_mutex_unlock(&sceneLoaderRef->mutex);
+	}
+
+	return NULL;
+}
+
+/**
+ * Populates a scene straight from a scene file. With more than one thread the file is mapped
+ * into memory, the top level array is cut into chunks at its commas and the chunks are parsed
+ * on all threads into scenes of their own that are merged in file order. Otherwise (or when the
+ * file can not be mapped, like a pipe) the top level array is read one object at a time.
+ * Either way little more than the scene itself is ever resident.
+ * @param fname - The name of the scene JSON file
+ * @param directory - The directory relative mesh files are resolved against, NULL for the working directory
+ * @param sceneRef - A reference to the scene to populate
+ * @param threadsLength - The number of threads to parse with, 0 to use every online core
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int scene_load_file(char *fname, char *directory, Scene *sceneRef, int threadsLength) {
+	struct stat info;
+
+	scene_init(sceneRef);
+	sceneRef->directory = directory;
+
+	if (threadsLength <= 0)
+		threadsLength = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (threadsLength <= 1 || stat(fname, &info) != 0 || !S_ISREG(info.st_mode)) {
+		if (read_json_array_values(fname, add_JSONValue_to_scene, sceneRef) != 0) {
+			scene_free(sceneRef);
+			return 1;
+		}
+
+		return scene_finish(sceneRef);
+	}
+
+	SceneLoader loader;
+	if (map_json_array_chunks(fname, threadsLength * SCENE_CHUNKS_PER_THREAD, &loader.chunks) != 0)
+		return 1;
+
+	loader.sceneRef = sceneRef;
+	loader.chunkScenes = malloc(sizeof(Scene) * loader.chunks.chunksLength);
+	loader.chunkResults = malloc(sizeof(int) * loader.chunks.chunksLength);
+	loader.chunkDone = calloc(loader.chunks.chunksLength, sizeof(char));
+	if (threadsLength > loader.chunks.chunksLength)
+		threadsLength = loader.chunks.chunksLength;
+	pthread_t *threads = malloc(sizeof(pthread_t) * threadsLength);
+	if (loader.chunkScenes == NULL || loader.chunkResults == NULL || loader.chunkDone == NULL || threads == NULL) {
+		fprintf(stderr, "Error: Could not allocate the scene loader for %i chunks\n", loader.chunks.chunksLength);
+		free(threads);
+		free(loader.chunkScenes);
+		free(loader.chunkResults);
+		free(loader.chunkDone);
+		unmap_json_array_chunks(&loader.chunks);
+		return 1;
+	}
+	loader.nextChunk = 0;
+	loader.nextMerge = 0;
+	loader.isMerging = 0;
+	loader.result = 0;
+	pthread_mutex_init(&loader.mutex, NULL);
+	for (int i = 0; i < loader.chunks.chunksLength; i++) {
+		scene_init(&loader.chunkScenes[i]);
+		loader.chunkScenes[i].directory = directory;
+	}
+
+	int threadsStarted = 0;
+	for (; threadsStarted < threadsLength - 1; threadsStarted++) {
+		if (pthread_create(&threads[threadsStarted], NULL, scene_loader_thread, &loader) != 0)
+			break;
+	}
+	// The calling thread takes part too
+	scene_loader_thread(&loader);
+	for (int i = 0; i < threadsStarted; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	pthread_mutex_destroy(&loader.mutex);
+	unmap_json_array_chunks(&loader.chunks);
+	free(loader.chunkScenes);
+	free(loader.chunkResults);
+	free(loader.chunkDone);
+
+	// Every chunk has either moved into the scene or been freed
+	if (loader.result != 0) {
+		scene_free(sceneRef);
+		return 1;
+	}
+
+	return scene_finish(sceneRef);
+}
+
+/**
+ * Populates a scene straight from a scene file, see scene_load_file. Mesh files named by a
+ * relative path are looked for next to the scene file, so a scene can be moved with its meshes.
+ * @param fname - The name of the scene JSON file
+ * @param sceneRef - A reference to the scene to populate
+ * @param threadsLength - The number of threads to parse with, 0 to use every online core
+ * @return 0 if success, otherwise a failure occurred
+ */
+int create_scene_from_file(char *fname, Scene *sceneRef, int threadsLength) {
+	char *directory = NULL;
+	char *slash = strrchr(fname, '/');
+
+	if (slash != NULL) {
+		directory = strndup(fname, (size_t) (slash - fname));
+		if (directory == NULL) {
+			fprintf(stderr, "Error: Could not allocate the directory of scene file '%s'\n", fname);
+			return 1;
+		}
+	}
+
+	int result = scene_load_file(fname, directory, sceneRef, threadsLength);
+	sceneRef->directory = NULL;
+	free(directory);
+	return result;
+}
+
+/**
+ * Populates a scene based on the input JSONRootValue
+ * @param JSONValueSceneRef - The JSON value containing a JSONArray to be used to populate the scene
+ * @param sceneRef - A reference to the scene to populate
+ * @return 0 if success, otherwise a failure occurred
+ */
+int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
+	JSONArray *JSONSceneArrayRef;
+
+	scene_init(sceneRef);
+
+	// Make sure that we were passed a JSONArray
+	if (JSONValueSceneRef->type != ARRAY_T) {
+		fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+		return 1;
+	}
+	JSONSceneArrayRef = JSONValueSceneRef->data.dataArray;
+
+	for (int i = 0; i < JSONSceneArrayRef->length; i++) {
+		if (add_JSONValue_to_scene(JSONSceneArrayRef->values[i], sceneRef) != 0)
+			return 1;
+	}
+
+	return scene_finish(sceneRef);
+}
@@ -7,8 +7,45 @@
 
 typedef struct Scene Scene;
 typedef struct JSONArray JSONArray;
+typedef struct JSONObject JSONObject;
+typedef struct Primitive Primitive;
+typedef struct Group Group;
+typedef struct Sphere Sphere;
+typedef struct Plane Plane;
+typedef struct TriangleMesh TriangleMesh;
+typedef struct Instance Instance;
+typedef struct Light Light;
 
 int JSONArray_to_V3(JSONArray *JSONArrayRef, V3 *vectorRef);
+int JSONObject_to_sphere(JSONObject *JSONObjectRef, Sphere *sphereRef);
+int JSONObject_to_plane(JSONObject *JSONObjectRef, Plane *planeRef);
+int JSONObject_to_mesh(JSONObject *JSONObjectRef, char *directory, TriangleMesh *meshRef);
+int JSONObject_to_primitive(JSONObject *JSONObjectRef, char *type, Primitive *primitiveRef);
+int scene_find_group(Scene *sceneRef, char *name);
+int JSONObject_to_group(JSONObject *JSONObjectRef, Scene *sceneRef);
+void calculate_group_bounds(Group *groupRef);
+void sphere_bounds(Sphere *sphereRef, V3 *minRef, V3 *maxRef);
+int mesh_bounds(TriangleMesh *meshRef, V3 *minRef, V3 *maxRef);
+void instance_bound_sphere(Scene *sceneRef, Instance *instanceRef, V3 *centerRef, double *radiusRef);
+void instance_bounds(Scene *sceneRef, Instance *instanceRef, V3 *minRef, V3 *maxRef);
+int JSONObject_to_instance(JSONObject *JSONObjectRef, Scene *sceneRef, Instance *instanceRef);
+int JSONObject_to_light(JSONObject *JSONObjectRef, Light *lightRef);
+void light_bounds(Light *lightRef, V3 *minRef, V3 *maxRef);
+void scene_init(Scene *sceneRef);
+void *scene_array_append(void **arrayRef, int *lengthRef, int *capacityRef, size_t elementSize);
+void scene_array_shrink(void **arrayRef, int length, int *capacityRef, size_t elementSize);
+int add_JSONValue_to_scene(JSONValue *JSONValueRef, void *sceneRef);
+int scene_finish(Scene *sceneRef);
+int scene_features(Scene *sceneRef);
+void scene_free(Scene *sceneRef);
+int scene_merge(Scene *sceneRef, Scene *sourceRef);
+size_t scene_size(Scene *sceneRef);
+int scene_copy(Scene *sourceRef, Scene *sceneRef);
+int scene_copy_update(Scene *sourceRef, Scene *sceneRef);
+int scene_array_concat(void **arrayRef, int *lengthRef, int *capacityRef, void **sourceRef, int *sourceLengthRef,
+					   int *sourceCapacityRef, size_t elementSize);
+void *scene_loader_thread(void *loaderRef);
+int create_scene_from_file(char *fname, Scene *sceneRef, int threadsLength);
 int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef);
 
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_RAYCASTER_HELPERS_H
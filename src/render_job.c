@@ -0,0 +1,167 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdio.h>
+#include <time.h>
+#include "render_job.h"
+
+/**
+ * Read the monotonic clock
+ * @return The current time in nanoseconds
+ */
+int64_t render_job_now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Resets the counters of a job and starts its clock, a job used with a synchronous call to
+ * raycast only needs this
+ * @param jobRef - The job to initialize
+ * @param timeBudget - The seconds the render may take, 0 for no deadline
+ */
+void render_job_init(RenderJob *jobRef, double timeBudget) {
+	jobRef->threadsLength = 1;
+	jobRef->startNs = render_job_now_ns();
+	jobRef->deadlineNs = timeBudget > 0 ? jobRef->startNs + (int64_t) (timeBudget * 1e9) : 0;
+	atomic_init(&jobRef->tilesLength, 0);
+	atomic_init(&jobRef->tilesDone, 0);
+	atomic_init(&jobRef->tilesReduced, 0);
+	atomic_init(&jobRef->tilesCached, 0);
+	atomic_init(&jobRef->fullQualityNs, 0);
+	atomic_init(&jobRef->isCancelled, 0);
+	atomic_init(&jobRef->isFinished, 0);
+	jobRef->result = 0;
+}
+
+/**
+ * Thread body of a job, runs the render and marks the job finished
+ * @param jobRef - The RenderJob to run
+ * @return NULL
+ */
+static void *render_job_thread(void *jobRef) {
+	RenderJob *renderJobRef = jobRef;
+
+	renderJobRef->result = raycast(renderJobRef->sceneRef, renderJobRef->imageRef, &renderJobRef->options,
+								   renderJobRef->imageWidth, renderJobRef->imageHeight);
+	atomic_store(&renderJobRef->isFinished, 1);
+	return NULL;
+}
+
+/**
+ * Starts rendering a scene on a thread of its own and returns straight away
+ * @param jobRef - The job to start, it must stay in place until render_job_wait returns
+ * @param sceneRef - The input scene to render, it must not change while the job runs
+ * @param imageRef - The output image to write to
+ * @param optionsRef - The options to render with, they are copied into the job
+ * @param imageWidth - The width of the output image
+ * @param imageHeight - The height of the output image
+ * @param timeBudget - The seconds the render may take, 0 for no deadline
+ * @return 0 if success, otherwise a failure occurred
+ */
+int render_job_start(RenderJob *jobRef, Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef,
+					 int imageWidth, int imageHeight, double timeBudget) {
+	render_job_init(jobRef, timeBudget);
+	jobRef->sceneRef = sceneRef;
+	jobRef->imageRef = imageRef;
+	jobRef->options = *optionsRef;
+	jobRef->options.jobRef = jobRef;
+	jobRef->imageWidth = imageWidth;
+	jobRef->imageHeight = imageHeight;
+
+	if (pthread_create(&jobRef->thread, NULL, render_job_thread, jobRef) != 0) {
+		fprintf(stderr, "Error: Could not start the render job thread\n");
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Asks a job to stop, the tiles already being traced are finished first
+ * @param jobRef - The job to cancel
+ */
+void render_job_cancel(RenderJob *jobRef) {
+	atomic_store(&jobRef->isCancelled, 1);
+}
+
+/**
+ * Determine how much of a job is done
+ * @param jobRef - The job to check
+ * @return The fraction of the tiles finished, from 0 to 1
+ */
+double render_job_progress(RenderJob *jobRef) {
+	int tilesLength = atomic_load(&jobRef->tilesLength);
+	return tilesLength > 0 ? (double) atomic_load(&jobRef->tilesDone) / tilesLength : 0;
+}
+
+/**
+ * Determine if a job has returned, render_job_wait will not block once it has
+ * @param jobRef - The job to check
+ * @return 1 if the job has finished, otherwise 0
+ */
+int render_job_is_finished(RenderJob *jobRef) {
+	return atomic_load(&jobRef->isFinished);
+}
+
+/**
+ * Waits for a job to finish
+ * @param jobRef - The job to wait for
+ * @return 0 if success, RENDER_CANCELLED if the job was cancelled, otherwise a failure occurred
+ */
+int render_job_wait(RenderJob *jobRef) {
+	pthread_join(jobRef->thread, NULL);
+	return jobRef->result;
+}
+
+/**
+ * Chooses the block size for the next tile of a job. The time a tile takes at full quality is
+ * estimated from the tiles traced so far, and the smallest block size that lets every remaining tile
+ * finish before the deadline is picked, a block of n x n pixels costing about 1/n^2 of a full tile.
+ * @param jobRef - The running job
+ * @return The width of the square blocks to trace one pixel of, 1 for full quality
+ */
+int render_job_block_size(RenderJob *jobRef) {
+	if (jobRef->deadlineNs == 0)
+		return 1;
+
+	int64_t timeLeft = jobRef->deadlineNs - render_job_now_ns();
+	if (timeLeft <= 0)
+		return RENDER_MAX_BLOCK_SIZE;
+
+	int tilesDone = atomic_load(&jobRef->tilesDone);
+	int tilesTraced = tilesDone - atomic_load(&jobRef->tilesCached);
+	if (tilesTraced <= 0)
+		return 1;
+
+	double tileNs = (double) atomic_load(&jobRef->fullQualityNs) / tilesTraced;
+	double neededNs = tileNs * (atomic_load(&jobRef->tilesLength) - tilesDone) / jobRef->threadsLength;
+	for (int blockSize = 1; blockSize < RENDER_MAX_BLOCK_SIZE; blockSize *= 2) {
+		if (neededNs / (blockSize * blockSize) <= timeLeft)
+			return blockSize;
+	}
+	return RENDER_MAX_BLOCK_SIZE;
+}
+
+/**
+ * Counts a finished tile of a job
+ * @param jobRef - The running job
+ * @param tileNs - The time the tile took
+ * @param blockSize - The block size the tile was traced with
+ */
+void render_job_tile_done(RenderJob *jobRef, int64_t tileNs, int blockSize) {
+	atomic_fetch_add(&jobRef->fullQualityNs, tileNs * blockSize * blockSize);
+	if (blockSize > 1)
+		atomic_fetch_add(&jobRef->tilesReduced, 1);
+	atomic_fetch_add(&jobRef->tilesDone, 1);
+}
+
+/**
+ * Counts a tile of a job copied from the tile cache, it is left out of the time a tile takes
+ * @param jobRef - The running job
+ */
+void render_job_tile_cached(RenderJob *jobRef) {
+	atomic_fetch_add(&jobRef->tilesCached, 1);
+	atomic_fetch_add(&jobRef->tilesDone, 1);
+}
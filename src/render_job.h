@@ -0,0 +1,54 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_RENDER_JOB_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_RENDER_JOB_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "raycaster.h"
+
+#define RENDER_CANCELLED 2
+#define RENDER_MAX_BLOCK_SIZE 8
+
+/**
+ * RenderJob - A render running on its own thread. The counters may be read from any thread while
+ * it runs, cancelling is checked before every tile. With a deadline, tiles are traced one pixel per
+ * block of 2x2, 4x4 or 8x8 pixels and copied across the block once the tiles left would not
+ * otherwise finish in time. Tiles copied from the tile cache count as done but are left out of
+ * the estimate of how long a tile takes.
+ */
+typedef struct RenderJob {
+	Scene *sceneRef;
+	Image *imageRef;
+	RenderOptions options;
+	int imageWidth, imageHeight;
+	int threadsLength;
+	int64_t startNs;
+	int64_t deadlineNs;
+	atomic_int tilesLength;
+	atomic_int tilesDone;
+	atomic_int tilesReduced;
+	atomic_int tilesCached;
+	atomic_llong fullQualityNs;
+	atomic_int isCancelled;
+	atomic_int isFinished;
+	int result;
+	pthread_t thread;
+} RenderJob;
+
+int64_t render_job_now_ns();
+void render_job_init(RenderJob *jobRef, double timeBudget);
+int render_job_start(RenderJob *jobRef, Scene *sceneRef, Image *imageRef, RenderOptions *optionsRef,
+					 int imageWidth, int imageHeight, double timeBudget);
+void render_job_cancel(RenderJob *jobRef);
+double render_job_progress(RenderJob *jobRef);
+int render_job_is_finished(RenderJob *jobRef);
+int render_job_wait(RenderJob *jobRef);
+int render_job_block_size(RenderJob *jobRef);
+void render_job_tile_done(RenderJob *jobRef, int64_t tileNs, int blockSize);
+void render_job_tile_cached(RenderJob *jobRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_RENDER_JOB_H
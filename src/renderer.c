@@ -0,0 +1,112 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "json.h"
+#include "renderer.h"
+#include "raycaster_helpers.h"
+
+/**
+ * Creates a renderer, reading the memory topology and starting its threads
+ * @param rendererRef - The renderer to create
+ * @param threadsLength - The number of threads to render with, 0 for every core
+ * @return 0 if success, otherwise a failure occurred
+ */
+int renderer_create(Renderer *rendererRef, int threadsLength) {
+	memset(rendererRef, 0, sizeof(Renderer));
+	if (numa_topology_load(&rendererRef->topology) != 0)
+		return 1;
+
+	if (threadsLength <= 0)
+		threadsLength = rendererRef->topology.cpusLength;
+	if (thread_pool_create(&rendererRef->pool, threadsLength) != 0) {
+		numa_topology_free(&rendererRef->topology);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Stops the threads of a renderer and releases everything it holds, including its framebuffer
+ * @param rendererRef - The renderer to destroy
+ */
+void renderer_destroy(Renderer *rendererRef) {
+	thread_pool_destroy(&rendererRef->pool);
+	render_scratch_free(&rendererRef->scratch);
+	numa_topology_free(&rendererRef->topology);
+	free(rendererRef->image.pixmapRef);
+	memset(rendererRef, 0, sizeof(Renderer));
+}
+
+/**
+ * Reads a scene file into a newly allocated scene, parsing on as many threads as the renderer has
+ * @param rendererRef - The renderer the scene will be rendered with
+ * @param fname - The name of the scene JSON file
+ * @param sceneRefRef - The new scene is written here, release it with renderer_scene_destroy
+ * @return 0 if success, otherwise a failure occurred
+ */
+int renderer_scene_create(Renderer *rendererRef, char *fname, Scene **sceneRefRef) {
+	Scene *sceneRef = malloc(sizeof(Scene));
+	if (sceneRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate a scene\n");
+		return 1;
+	}
+
+	if (create_scene_from_file(fname, sceneRef, rendererRef->pool.threadsLength) != 0) {
+		scene_free(sceneRef);
+		free(sceneRef);
+		return 1;
+	}
+
+	*sceneRefRef = sceneRef;
+	return 0;
+}
+
+/**
+ * Releases a scene made by renderer_scene_create
+ * @param sceneRef - The scene to destroy
+ */
+void renderer_scene_destroy(Scene *sceneRef) {
+	if (sceneRef == NULL)
+		return;
+
+	scene_free(sceneRef);
+	free(sceneRef);
+}
+
+/**
+ * Renders a scene into the renderer's framebuffer, which is only reallocated when it grows. With a
+ * dirty region the framebuffer must already hold the previous render at this size. When the options
+ * name a frame buffer the frame is written there instead and the renderer's framebuffer is untouched.
+ * @param rendererRef - The renderer to render with
+ * @param sceneRef - The input scene to render
+ * @param optionsRef - The options to render with, threadsLength 0 uses every thread of the renderer
+ * @param imageWidth - The width of the output image
+ * @param imageHeight - The height of the output image
+ * @return 0 if success, otherwise a failure occurred, the frame is in rendererRef->image until the next call
+ */
+int renderer_render(Renderer *rendererRef, Scene *sceneRef, RenderOptions *optionsRef, int imageWidth, int imageHeight) {
+	RenderOptions options = *optionsRef;
+	size_t pixelsLength = (size_t) imageWidth * imageHeight;
+
+	if (options.regionRef == NULL && options.frameBufferRef == NULL) {
+		if (pixelsLength > rendererRef->pixelsCapacity) {
+			// The previous frame is not kept, so the framebuffer is not copied as it grows
+			free(rendererRef->image.pixmapRef);
+			rendererRef->image.pixmapRef = malloc(sizeof(RGBApixel) * pixelsLength);
+			rendererRef->pixelsCapacity = rendererRef->image.pixmapRef != NULL ? pixelsLength : 0;
+			if (rendererRef->image.pixmapRef == NULL) {
+				fprintf(stderr, "Error: Could not allocate a framebuffer of size %ix%i\n", imageWidth, imageHeight);
+				return 1;
+			}
+		}
+		rendererRef->image.width = (uint32_t) imageWidth;
+		rendererRef->image.height = (uint32_t) imageHeight;
+	}
+
+	options.rendererRef = rendererRef;
+	return raycast(sceneRef, &rendererRef->image, &options, imageWidth, imageHeight);
+}
@@ -0,0 +1,33 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_RENDERER_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_RENDERER_H
+
+#include <stddef.h>
+#include "raycaster.h"
+#include "numa.h"
+#include "thread_pool.h"
+
+/**
+ * Renderer - A persistent render context for embedding the raycaster. It owns a pool of threads,
+ * the memory topology, the scratch of the last render and a framebuffer, all kept between calls so
+ * rendering frame after frame at one size allocates nothing once the first frame is done. Nothing
+ * is written to stdout, failures are reported on stderr.
+ */
+typedef struct Renderer {
+	NumaTopology topology;
+	ThreadPool pool;
+	RenderScratch scratch;
+	Image image;
+	size_t pixelsCapacity;
+} Renderer;
+
+int renderer_create(Renderer *rendererRef, int threadsLength);
+void renderer_destroy(Renderer *rendererRef);
+int renderer_scene_create(Renderer *rendererRef, char *fname, Scene **sceneRefRef);
+void renderer_scene_destroy(Scene *sceneRef);
+int renderer_render(Renderer *rendererRef, Scene *sceneRef, RenderOptions *optionsRef, int imageWidth, int imageHeight);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_RENDERER_H
@@ -0,0 +1,234 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "shadow_packet.h"
+#include "json.h"
+#include "raycaster_helpers.h"
+
+/**
+ * Calculates a world space sphere around every primitive of a scene, indexed by primitive id
+ * @param sceneRef - The scene to bound
+ * @param boundsRef - Room for a bound per primitive, written here
+ */
+void primitive_bounds_calculate(Scene *sceneRef, PrimitiveBound *boundsRef) {
+	int id = 0;
+	V3 min, max;
+
+	for (int i = 0; i < sceneRef->spheresLength; i++, id++) {
+		boundsRef[id].center = sceneRef->spheres[i].position;
+		boundsRef[id].radius = sceneRef->spheres[i].radius;
+	}
+
+	for (int i = 0; i < sceneRef->planesLength; i++, id++) {
+		boundsRef[id].center = sceneRef->planes[i].position;
+		boundsRef[id].radius = INFINITY;
+	}
+
+	for (int i = 0; i < sceneRef->instancesLength; i++, id++)
+		instance_bound_sphere(sceneRef, &sceneRef->instances[i], &boundsRef[id].center, &boundsRef[id].radius);
+
+	for (int i = 0; i < sceneRef->meshesLength; i++, id++) {
+		if (mesh_bounds(&sceneRef->meshes[i], &min, &max) != 0) {
+			boundsRef[id].radius = -1;
+			continue;
+		}
+		v3_add(&min, &max, &boundsRef[id].center);
+		v3_scale(&boundsRef[id].center, 0.5, &boundsRef[id].center);
+		v3_distance(&min, &max, &boundsRef[id].radius);
+		boundsRef[id].radius *= 0.5;
+	}
+}
+
+/**
+ * Makes sure a shadow packet has room for a tile of hits and the occluder lists of a scene, it only grows
+ * @param packetRef - The packet to grow, zeroed before its first use
+ * @param sceneRef - The scene about to be rendered
+ * @return 0 if success, otherwise a failure occurred
+ */
+int shadow_packet_reserve(ShadowPacket *packetRef, Scene *sceneRef) {
+	if (packetRef->samples == NULL) {
+		packetRef->samples = malloc(sizeof(GBufferSample) * RENDER_TILE_SIZE * RENDER_TILE_SIZE);
+		packetRef->primaryTests = malloc(sizeof(uint32_t) * RENDER_TILE_SIZE * RENDER_TILE_SIZE);
+		packetRef->hits = malloc(sizeof(uint64_t) * RENDER_TILE_SIZE * RENDER_TILE_SIZE);
+		packetRef->shading = malloc(sizeof(V3) * RENDER_TILE_SIZE * RENDER_TILE_SIZE);
+		packetRef->shadowRays = malloc(sizeof(uint32_t) * RENDER_TILE_SIZE * RENDER_TILE_SIZE);
+		packetRef->lightsShaded = malloc(sizeof(uint32_t) * RENDER_TILE_SIZE * RENDER_TILE_SIZE);
+		if (packetRef->samples == NULL || packetRef->primaryTests == NULL || packetRef->hits == NULL ||
+			packetRef->shading == NULL || packetRef->shadowRays == NULL || packetRef->lightsShaded == NULL) {
+			shadow_packet_free(packetRef);
+			return 1;
+		}
+	}
+
+	if (sceneRef->primitivesLength > packetRef->primitivesCapacity || sceneRef->lightsLength > packetRef->lightsCapacity) {
+		int primitivesCapacity = sceneRef->primitivesLength > packetRef->primitivesCapacity ?
+								 sceneRef->primitivesLength : packetRef->primitivesCapacity;
+		int lightsCapacity = sceneRef->lightsLength > packetRef->lightsCapacity ?
+							 sceneRef->lightsLength : packetRef->lightsCapacity;
+		free(packetRef->occluders);
+		free(packetRef->occludersLength);
+		packetRef->occluders = malloc(sizeof(int) * primitivesCapacity * lightsCapacity);
+		packetRef->occludersLength = malloc(sizeof(int) * lightsCapacity);
+		packetRef->primitivesCapacity = primitivesCapacity;
+		packetRef->lightsCapacity = lightsCapacity;
+		if (packetRef->occluders == NULL || packetRef->occludersLength == NULL) {
+			shadow_packet_free(packetRef);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Releases the buffers held by a shadow packet
+ * @param packetRef - The packet to free
+ */
+void shadow_packet_free(ShadowPacket *packetRef) {
+	free(packetRef->samples);
+	free(packetRef->primaryTests);
+	free(packetRef->hits);
+	free(packetRef->shading);
+	free(packetRef->shadowRays);
+	free(packetRef->lightsShaded);
+	free(packetRef->occluders);
+	free(packetRef->occludersLength);
+	packetRef->samples = NULL;
+	packetRef->primaryTests = NULL;
+	packetRef->hits = NULL;
+	packetRef->shading = NULL;
+	packetRef->shadowRays = NULL;
+	packetRef->lightsShaded = NULL;
+	packetRef->occluders = NULL;
+	packetRef->occludersLength = NULL;
+	packetRef->primitivesCapacity = 0;
+	packetRef->lightsCapacity = 0;
+}
+
+/**
+ * Determine if a plane could cross a shadow ray from a box of hits to a light, it can not when the
+ * light and the whole box are strictly on the same side of it
+ * @param planeRef - The plane to check
+ * @param centerRef - The center of the box of hits
+ * @param extentRef - Half the size of the box along each axis
+ * @param lightRef - The position of the light
+ * @return 1 if the plane may block a shadow ray, otherwise 0
+ */
+static int shadow_cull_plane(Plane *planeRef, V3 *centerRef, V3 *extentRef, V3 *lightRef) {
+	V3 offset;
+	double centerSide, lightSide;
+	double spread = 0;
+
+	v3_subtract(centerRef, &planeRef->position, &offset);
+	v3_dot(&planeRef->normal, &offset, &centerSide);
+	v3_subtract(lightRef, &planeRef->position, &offset);
+	v3_dot(&planeRef->normal, &offset, &lightSide);
+	for (int i = 0; i < 3; i++)
+		spread += fabs(planeRef->normal.array[i]) * extentRef->array[i];
+
+	double low = fmin(centerSide - spread, lightSide);
+	double high = fmax(centerSide + spread, lightSide);
+	double epsilon = SHADOW_CULL_EPSILON * fmax(fabs(low), fabs(high));
+	return !(low > epsilon || high < -epsilon);
+}
+
+/**
+ * Lists for every light the primitives that could block a shadow ray from a point in a box of hits
+ * to the light. The segments from the light to the box all lie in a cone with its apex on the light,
+ * around the direction to the center of the box and reaching as far as the farthest corner. A
+ * primitive is left out when its bounding sphere misses that cone, or a plane when the light and the
+ * box are on the same side of it. A light inside the box, or one so close that the cone opens past
+ * SHADOW_CULL_MIN_COS, lists every primitive. Area lights are left empty, their lists are never read.
+ * @param packetRef - The packet to write the lists to, reserved for the scene
+ * @param sceneRef - The scene being rendered
+ * @param minRef - The lowest corner of the box around the tile's hits
+ * @param maxRef - The highest corner of the box around the tile's hits
+ */
+void shadow_packet_cull(ShadowPacket *packetRef, Scene *sceneRef, V3 *minRef, V3 *maxRef) {
+	PrimitiveBound *boundsRef = packetRef->boundsRef;
+	V3 center, extent;
+
+	v3_add(minRef, maxRef, &center);
+	v3_scale(&center, 0.5, &center);
+	v3_subtract(maxRef, &center, &extent);
+
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		V3 *lightRef = &sceneRef->lights[i].data.pointLight.position;
+		int *occluders = &packetRef->occluders[(size_t) i * packetRef->primitivesCapacity];
+		int occludersLength = 0;
+		V3 axis, corner;
+		double axisLength;
+		double minCos = 1, maxDistance = 0;
+
+		// Area lights trace their own shadow rays against every primitive
+		if (sceneRef->lights[i].type == AREALIGHT_T) {
+			packetRef->occludersLength[i] = 0;
+			continue;
+		}
+
+		v3_subtract(&center, lightRef, &axis);
+		v3_magnitude(&axis, &axisLength);
+		if (axisLength > 0) {
+			v3_scale(&axis, 1 / axisLength, &axis);
+			for (int c = 0; c < 8; c++) {
+				double distance, cosine;
+				for (int j = 0; j < 3; j++)
+					corner.array[j] = ((c >> j) & 1 ? maxRef->array[j] : minRef->array[j]) - lightRef->array[j];
+				v3_magnitude(&corner, &distance);
+				v3_dot(&corner, &axis, &cosine);
+				cosine = distance > 0 ? cosine / distance : -1;
+				minCos = fmin(minCos, cosine);
+				maxDistance = fmax(maxDistance, distance);
+			}
+		}
+
+		// The light sees the box from too wide an angle for the cone to exclude anything
+		if (axisLength == 0 || minCos < SHADOW_CULL_MIN_COS) {
+			for (int id = 0; id < sceneRef->primitivesLength; id++)
+				occluders[occludersLength++] = id;
+			packetRef->occludersLength[i] = occludersLength;
+			continue;
+		}
+
+		double coneAngle = acos(fmin(minCos, 1)) + SHADOW_CULL_EPSILON;
+		maxDistance *= 1 + SHADOW_CULL_EPSILON;
+		for (int id = 0; id < sceneRef->primitivesLength; id++) {
+			PrimitiveBound *boundRef = &boundsRef[id];
+			int index;
+
+			if (scene_primitive_type(sceneRef, id, &index) == PLANE_T) {
+				if (shadow_cull_plane(&sceneRef->planes[index], &center, &extent, lightRef))
+					occluders[occludersLength++] = id;
+				continue;
+			}
+			if (boundRef->radius < 0)
+				continue;
+			if (!isfinite(boundRef->radius)) {
+				occluders[occludersLength++] = id;
+				continue;
+			}
+
+			V3 toBound;
+			double distance, cosine;
+			v3_subtract(&boundRef->center, lightRef, &toBound);
+			v3_magnitude(&toBound, &distance);
+			double radius = boundRef->radius + SHADOW_CULL_EPSILON * (distance + boundRef->radius);
+
+			// A sphere around the light, or one the cone reaches and opens wide enough to touch
+			if (distance <= radius) {
+				occluders[occludersLength++] = id;
+				continue;
+			}
+			if (distance - radius > maxDistance)
+				continue;
+			v3_dot(&toBound, &axis, &cosine);
+			cosine = fmax(-1, fmin(1, cosine / distance));
+			if (acos(cosine) <= coneAngle + asin(radius / distance))
+				occluders[occludersLength++] = id;
+		}
+		packetRef->occludersLength[i] = occludersLength;
+	}
+}
@@ -0,0 +1,53 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_SHADOW_PACKET_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_SHADOW_PACKET_H
+
+#include <stdint.h>
+#include "raycaster.h"
+
+// Past this cone half-angle (as a cosine) the cone around a tile's hits stops being a tight bound
+#define SHADOW_CULL_MIN_COS 0.05
+// Relative padding on every culling test so rounding never drops a primitive that blocks a ray
+#define SHADOW_CULL_EPSILON 1e-7
+
+/**
+ * PrimitiveBound - A world space sphere around a primitive, planes and unbounded instances have an
+ * infinite radius and meshes without triangles a negative one
+ */
+typedef struct PrimitiveBound {
+	V3 center;
+	double radius;
+} PrimitiveBound;
+
+/**
+ * ShadowPacket - The primary hits of one tile and, for each light, the primitives that could block a
+ * shadow ray from any of those hits to the light. The lists hold primitive ids in increasing order,
+ * primitivesCapacity entries per light. Each rendering thread owns one and reuses it for every tile.
+ * A wavefront render also queues the hits in hits, each the primitive id above the tile position
+ * of the hit, and keeps the direct light and shadow rays and lights shaded of each hit by tile
+ * position, adding its shadow tests to primaryTests.
+ */
+typedef struct ShadowPacket {
+	GBufferSample *samples;
+	uint32_t *primaryTests;
+	uint64_t *hits;
+	int hitsLength;
+	V3 *shading;
+	uint32_t *shadowRays;
+	uint32_t *lightsShaded;
+	int *occluders;
+	int *occludersLength;
+	int primitivesCapacity;
+	int lightsCapacity;
+	PrimitiveBound *boundsRef;
+} ShadowPacket;
+
+void primitive_bounds_calculate(Scene *sceneRef, PrimitiveBound *boundsRef);
+int shadow_packet_reserve(ShadowPacket *packetRef, Scene *sceneRef);
+void shadow_packet_free(ShadowPacket *packetRef);
+void shadow_packet_cull(ShadowPacket *packetRef, Scene *sceneRef, V3 *minRef, V3 *maxRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_SHADOW_PACKET_H
@@ -0,0 +1,117 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "thread_pool.h"
+
+/**
+ * Thread body of a pool, runs tasks of the current batch until the pool is stopped
+ * @param poolRef - The ThreadPool the thread belongs to
+ * @return NULL
+ */
+static void *thread_pool_thread(void *poolRef) {
+	ThreadPool *threadPoolRef = poolRef;
+
+	pthread_mutex_lock(&threadPoolRef->mutex);
+	while (!threadPoolRef->isStopping) {
+		if (threadPoolRef->nextTask >= threadPoolRef->tasksLength) {
+			pthread_cond_wait(&threadPoolRef->workCond, &threadPoolRef->mutex);
+			continue;
+		}
+
+		void *argumentRef = threadPoolRef->arguments + threadPoolRef->argumentSize * threadPoolRef->nextTask++;
+		threadPoolRef->tasksRunning++;
+		pthread_mutex_unlock(&threadPoolRef->mutex);
+		threadPoolRef->task(argumentRef);
+		pthread_mutex_lock(&threadPoolRef->mutex);
+
+		if (--threadPoolRef->tasksRunning == 0 && threadPoolRef->nextTask >= threadPoolRef->tasksLength)
+			pthread_cond_broadcast(&threadPoolRef->doneCond);
+	}
+	pthread_mutex_unlock(&threadPoolRef->mutex);
+
+	return NULL;
+}
+
+/**
+ * Starts the threads of a pool, they wait for work until the pool is destroyed
+ * @param poolRef - The pool to create
+ * @param threadsLength - The number of threads to start
+ * @return 0 if success, otherwise a failure occurred
+ */
+int thread_pool_create(ThreadPool *poolRef, int threadsLength) {
+	poolRef->threads = malloc(sizeof(pthread_t) * threadsLength);
+	poolRef->threadsLength = 0;
+	poolRef->tasksLength = 0;
+	poolRef->nextTask = 0;
+	poolRef->tasksRunning = 0;
+	poolRef->isStopping = 0;
+	if (poolRef->threads == NULL) {
+		fprintf(stderr, "Error: Could not allocate the thread pool\n");
+		return 1;
+	}
+
+	pthread_mutex_init(&poolRef->mutex, NULL);
+	pthread_cond_init(&poolRef->workCond, NULL);
+	pthread_cond_init(&poolRef->doneCond, NULL);
+	for (; poolRef->threadsLength < threadsLength; poolRef->threadsLength++) {
+		if (pthread_create(&poolRef->threads[poolRef->threadsLength], NULL, thread_pool_thread, poolRef) != 0)
+			break;
+	}
+
+	if (poolRef->threadsLength == 0) {
+		thread_pool_destroy(poolRef);
+		fprintf(stderr, "Error: Could not start the threads of the thread pool\n");
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Stops and joins the threads of a pool, it must not be running a batch
+ * @param poolRef - The pool to destroy
+ */
+void thread_pool_destroy(ThreadPool *poolRef) {
+	pthread_mutex_lock(&poolRef->mutex);
+	poolRef->isStopping = 1;
+	pthread_cond_broadcast(&poolRef->workCond);
+	pthread_mutex_unlock(&poolRef->mutex);
+
+	for (int i = 0; i < poolRef->threadsLength; i++)
+		pthread_join(poolRef->threads[i], NULL);
+
+	pthread_cond_destroy(&poolRef->doneCond);
+	pthread_cond_destroy(&poolRef->workCond);
+	pthread_mutex_destroy(&poolRef->mutex);
+	free(poolRef->threads);
+	poolRef->threads = NULL;
+	poolRef->threadsLength = 0;
+}
+
+/**
+ * Runs a batch of tasks on the threads of a pool and waits for all of them to finish. There may be
+ * more tasks than threads, the calling thread only waits.
+ * @param poolRef - The pool to run on
+ * @param task - The function each task calls
+ * @param arguments - An array holding the argument of each task
+ * @param argumentSize - The size of one argument, task i is passed arguments + argumentSize * i
+ * @param tasksLength - The number of tasks
+ */
+void thread_pool_run(ThreadPool *poolRef, ThreadPoolTask task, void *arguments, size_t argumentSize, int tasksLength) {
+	pthread_mutex_lock(&poolRef->mutex);
+	poolRef->task = task;
+	poolRef->arguments = arguments;
+	poolRef->argumentSize = argumentSize;
+	poolRef->tasksLength = tasksLength;
+	poolRef->nextTask = 0;
+	pthread_cond_broadcast(&poolRef->workCond);
+
+	while (poolRef->nextTask < poolRef->tasksLength || poolRef->tasksRunning > 0)
+		pthread_cond_wait(&poolRef->doneCond, &poolRef->mutex);
+
+	poolRef->tasksLength = 0;
+	poolRef->nextTask = 0;
+	pthread_mutex_unlock(&poolRef->mutex);
+}
@@ -0,0 +1,36 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_THREAD_POOL_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_THREAD_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+typedef void *(*ThreadPoolTask)(void *argumentRef);
+
+/**
+ * ThreadPool - Threads started once and kept waiting for work, each call to thread_pool_run hands
+ * them a batch of tasks and returns once every task has finished
+ */
+typedef struct ThreadPool {
+	pthread_t *threads;
+	int threadsLength;
+	pthread_mutex_t mutex;
+	pthread_cond_t workCond;
+	pthread_cond_t doneCond;
+	ThreadPoolTask task;
+	char *arguments;
+	size_t argumentSize;
+	int tasksLength;
+	int nextTask;
+	int tasksRunning;
+	int isStopping;
+} ThreadPool;
+
+int thread_pool_create(ThreadPool *poolRef, int threadsLength);
+void thread_pool_destroy(ThreadPool *poolRef);
+void thread_pool_run(ThreadPool *poolRef, ThreadPoolTask task, void *arguments, size_t argumentSize, int tasksLength);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_THREAD_POOL_H
@@ -0,0 +1,476 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "tile_cache.h"
+
+#define TILE_CACHE_HEADER_SIZE 24
+#define TILE_CACHE_NAME_LENGTH (16 + sizeof(TILE_CACHE_SUFFIX) - 1)
+
+/**
+ * TileCacheEntry - A tile found in the cache directory while looking for tiles to evict
+ */
+typedef struct TileCacheEntry {
+	int64_t usedNs;
+	off_t size;
+	char name[32];
+} TileCacheEntry;
+
+/**
+ * Mixes a word into a hash, both steps are invertible so two inputs differing in one word never
+ * collide
+ * @param hashRef - The hash to update
+ * @param word - The word to mix in
+ */
+static inline void tile_cache_mix(uint64_t *hashRef, uint64_t word) {
+	uint64_t hash = (*hashRef ^ word) * 0x9e3779b97f4a7c15ull;
+	*hashRef = hash ^ (hash >> 29);
+}
+
+/**
+ * Mixes a buffer into a hash eight bytes at a time, followed by its length
+ * @param hashRef - The hash to update
+ * @param data - The bytes to mix in
+ * @param length - The number of bytes
+ */
+static void tile_cache_mix_bytes(uint64_t *hashRef, const void *data, size_t length) {
+	const uint8_t *bytes = data;
+	uint64_t word;
+	size_t i = 0;
+
+	for (; i + sizeof(word) <= length; i += sizeof(word)) {
+		memcpy(&word, bytes + i, sizeof(word));
+		tile_cache_mix(hashRef, word);
+	}
+	if (i < length) {
+		word = 0;
+		memcpy(&word, bytes + i, length - i);
+		tile_cache_mix(hashRef, word);
+	}
+	tile_cache_mix(hashRef, length);
+}
+
+/**
+ * Mixes the bits of a double into a hash
+ * @param hashRef - The hash to update
+ * @param value - The value to mix in
+ */
+static inline void tile_cache_mix_double(uint64_t *hashRef, double value) {
+	uint64_t word;
+	memcpy(&word, &value, sizeof(word));
+	tile_cache_mix(hashRef, word);
+}
+
+/**
+ * Mixes the bits of a float into a hash
+ * @param hashRef - The hash to update
+ * @param value - The value to mix in
+ */
+static inline void tile_cache_mix_float(uint64_t *hashRef, float value) {
+	uint32_t word;
+	memcpy(&word, &value, sizeof(word));
+	tile_cache_mix(hashRef, word);
+}
+
+/**
+ * Mixes a vector into a hash
+ * @param hashRef - The hash to update
+ * @param vectorRef - The vector to mix in
+ */
+static inline void tile_cache_mix_v3(uint64_t *hashRef, V3 *vectorRef) {
+	for (int i = 0; i < 3; i++)
+		tile_cache_mix_double(hashRef, vectorRef->array[i]);
+}
+
+/**
+ * Mixes a sphere into a hash
+ * @param hashRef - The hash to update
+ * @param sphereRef - The sphere to mix in
+ */
+static void tile_cache_mix_sphere(uint64_t *hashRef, Sphere *sphereRef) {
+	tile_cache_mix_v3(hashRef, &sphereRef->diffuseColor);
+	tile_cache_mix_v3(hashRef, &sphereRef->specularColor);
+	tile_cache_mix_v3(hashRef, &sphereRef->position);
+	tile_cache_mix_double(hashRef, sphereRef->radius);
+	tile_cache_mix_double(hashRef, sphereRef->reflectivity);
+}
+
+/**
+ * Mixes a plane into a hash
+ * @param hashRef - The hash to update
+ * @param planeRef - The plane to mix in
+ */
+static void tile_cache_mix_plane(uint64_t *hashRef, Plane *planeRef) {
+	tile_cache_mix_v3(hashRef, &planeRef->diffuseColor);
+	tile_cache_mix_v3(hashRef, &planeRef->specularColor);
+	tile_cache_mix_v3(hashRef, &planeRef->position);
+	tile_cache_mix_v3(hashRef, &planeRef->normal);
+	tile_cache_mix_double(hashRef, planeRef->reflectivity);
+}
+
+/**
+ * Mixes a light into a hash, only the fields of its type are read
+ * @param hashRef - The hash to update
+ * @param lightRef - The light to mix in
+ */
+static void tile_cache_mix_light(uint64_t *hashRef, Light *lightRef) {
+	PointLight *pointLightRef = &lightRef->data.pointLight;
+
+	tile_cache_mix(hashRef, (uint64_t) lightRef->type);
+	tile_cache_mix_v3(hashRef, &pointLightRef->color);
+	tile_cache_mix_v3(hashRef, &pointLightRef->position);
+	tile_cache_mix_float(hashRef, pointLightRef->radialA2);
+	tile_cache_mix_float(hashRef, pointLightRef->radialA1);
+	tile_cache_mix_float(hashRef, pointLightRef->radialA0);
+	if (lightRef->type == SPOTLIGHT_T) {
+		tile_cache_mix_float(hashRef, lightRef->data.spotLight.angularA0);
+		tile_cache_mix_float(hashRef, lightRef->data.spotLight.theta);
+		tile_cache_mix_v3(hashRef, &lightRef->data.spotLight.direction);
+	}
+	else if (lightRef->type == AREALIGHT_T) {
+		tile_cache_mix(hashRef, (uint64_t) lightRef->data.areaLight.shape);
+		tile_cache_mix_v3(hashRef, &lightRef->data.areaLight.edgeU);
+		tile_cache_mix_v3(hashRef, &lightRef->data.areaLight.edgeV);
+		tile_cache_mix_double(hashRef, lightRef->data.areaLight.radius);
+	}
+}
+
+/**
+ * Hashes the contents of a scene field by field, never its pointers or padding, so the same scene
+ * loaded by another process hashes the same. Meshes are hashed by their loaded triangles, so an
+ * edited OBJ file changes the hash even when the scene file does not.
+ * @param sceneRef - The scene to hash
+ * @return The hash of the scene
+ */
+uint64_t tile_cache_scene_hash(Scene *sceneRef) {
+	uint64_t hash = 0;
+
+	tile_cache_mix_double(&hash, sceneRef->camera.width);
+	tile_cache_mix_double(&hash, sceneRef->camera.height);
+
+	tile_cache_mix(&hash, (uint64_t) sceneRef->spheresLength);
+	for (int i = 0; i < sceneRef->spheresLength; i++)
+		tile_cache_mix_sphere(&hash, &sceneRef->spheres[i]);
+
+	tile_cache_mix(&hash, (uint64_t) sceneRef->planesLength);
+	for (int i = 0; i < sceneRef->planesLength; i++)
+		tile_cache_mix_plane(&hash, &sceneRef->planes[i]);
+
+	tile_cache_mix(&hash, (uint64_t) sceneRef->instancesLength);
+	for (int i = 0; i < sceneRef->instancesLength; i++) {
+		tile_cache_mix(&hash, (uint64_t) sceneRef->instances[i].groupId);
+		tile_cache_mix_bytes(&hash, sceneRef->instances[i].worldToObject.m, sizeof(sceneRef->instances[i].worldToObject.m));
+	}
+
+	tile_cache_mix(&hash, (uint64_t) sceneRef->meshesLength);
+	for (int i = 0; i < sceneRef->meshesLength; i++) {
+		TriangleMesh *meshRef = &sceneRef->meshes[i];
+		tile_cache_mix_v3(&hash, &meshRef->diffuseColor);
+		tile_cache_mix_v3(&hash, &meshRef->specularColor);
+		tile_cache_mix_double(&hash, meshRef->reflectivity);
+		tile_cache_mix_bytes(&hash, meshRef->mesh.vertices, sizeof(float) * 3 * meshRef->mesh.verticesLength);
+		tile_cache_mix_bytes(&hash, meshRef->mesh.indices, sizeof(uint32_t) * 3 * meshRef->mesh.trianglesLength);
+		tile_cache_mix_bytes(&hash, meshRef->mesh.nodes, sizeof(MeshNode) * meshRef->mesh.nodesLength);
+	}
+
+	tile_cache_mix(&hash, (uint64_t) sceneRef->lightsLength);
+	for (int i = 0; i < sceneRef->lightsLength; i++)
+		tile_cache_mix_light(&hash, &sceneRef->lights[i]);
+
+	tile_cache_mix(&hash, (uint64_t) sceneRef->groupsLength);
+	for (int i = 0; i < sceneRef->groupsLength; i++) {
+		Group *groupRef = &sceneRef->groups[i];
+		tile_cache_mix_bytes(&hash, groupRef->name, strlen(groupRef->name));
+		tile_cache_mix(&hash, (uint64_t) groupRef->primitivesLength);
+		for (int j = 0; j < groupRef->primitivesLength; j++) {
+			Primitive *primitiveRef = &groupRef->primitives[j];
+			tile_cache_mix(&hash, (uint64_t) primitiveRef->type);
+			if (primitiveRef->type == SPHERE_T)
+				tile_cache_mix_sphere(&hash, &primitiveRef->data.sphere);
+			else
+				tile_cache_mix_plane(&hash, &primitiveRef->data.plane);
+		}
+	}
+
+	return hash;
+}
+
+/**
+ * Calculates the key every tile of a render is looked up under, from the contents of the scene,
+ * the image size and band and the options that change the pixels traced
+ * @param sceneRef - The scene being rendered
+ * @param optionsRef - The options it is rendered with
+ * @param imageWidth - The width of the image
+ * @param imageHeight - The height of the image
+ * @return The key of the render
+ */
+uint64_t tile_cache_render_key(Scene *sceneRef, RenderOptions *optionsRef, int imageWidth, int imageHeight) {
+	uint64_t key = 0;
+	int64_t fields[] = {TILE_CACHE_VERSION, RENDER_TILE_SIZE, imageWidth, imageHeight, optionsRef->firstRow,
+						optionsRef->fullHeight, optionsRef->maxDepth, optionsRef->rayBudget, optionsRef->lightSamples,
+						optionsRef->areaLightSamples};
+
+	tile_cache_mix(&key, tile_cache_scene_hash(sceneRef));
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+		tile_cache_mix(&key, (uint64_t) fields[i]);
+	return key;
+}
+
+/**
+ * Calculates the key of one tile of a render
+ * @param renderKey - The key of the render
+ * @param x0 - The left column of the tile
+ * @param y0 - The top row of the tile
+ * @return The key of the tile
+ */
+static inline uint64_t tile_cache_tile_key(uint64_t renderKey, int x0, int y0) {
+	uint64_t key = renderKey;
+	tile_cache_mix(&key, (uint64_t) x0);
+	tile_cache_mix(&key, (uint64_t) y0);
+	return key;
+}
+
+/**
+ * Opens a tile cache, creating its directory if it does not exist
+ * @param cacheRef - The cache to open
+ * @param directory - The directory the tiles are kept in
+ * @param maxBytes - The bytes of tiles kept once the cache is closed
+ * @return 0 if success, otherwise a failure occurred
+ */
+int tile_cache_open(TileCache *cacheRef, char *directory, size_t maxBytes) {
+	cacheRef->directory = directory;
+	cacheRef->maxBytes = maxBytes;
+	atomic_init(&cacheRef->hits, 0);
+	atomic_init(&cacheRef->misses, 0);
+	atomic_init(&cacheRef->stores, 0);
+	atomic_init(&cacheRef->temporaryId, 0);
+	cacheRef->evictions = 0;
+
+	if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Error: Tile cache directory '%s' could not be created\n", directory);
+		return 1;
+	}
+	cacheRef->directoryFd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (cacheRef->directoryFd < 0 || faccessat(cacheRef->directoryFd, ".", W_OK, 0) != 0) {
+		fprintf(stderr, "Error: Tile cache directory '%s' could not be opened for writing\n", directory);
+		if (cacheRef->directoryFd >= 0)
+			close(cacheRef->directoryFd);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Copies a tile from the cache into an image. A tile that is missing, of another size or key, or cut
+ * short by a crash counts as a miss.
+ * @param cacheRef - The cache to read from
+ * @param renderKey - The key of the render, see tile_cache_render_key
+ * @param imageRef - The image the tile is copied into
+ * @param x0 - The left column of the tile
+ * @param y0 - The top row of the tile
+ * @param x1 - The column after the right of the tile
+ * @param y1 - The row after the bottom of the tile
+ * @return 0 if the tile was found, otherwise it must be rendered
+ */
+int tile_cache_load(TileCache *cacheRef, uint64_t renderKey, Image *imageRef, int x0, int y0, int x1, int y1) {
+	uint8_t buffer[TILE_CACHE_HEADER_SIZE + sizeof(RGBApixel) * RENDER_TILE_SIZE * RENDER_TILE_SIZE];
+	uint32_t header[5];
+	size_t rowSize = sizeof(RGBApixel) * (size_t) (x1 - x0);
+	size_t length = TILE_CACHE_HEADER_SIZE + rowSize * (size_t) (y1 - y0);
+	uint64_t key = tile_cache_tile_key(renderKey, x0, y0);
+	char name[32];
+	struct stat fileStat;
+	size_t read = 0;
+
+	snprintf(name, sizeof(name), "%016llx%s", (unsigned long long) key, TILE_CACHE_SUFFIX);
+	int fd = x1 - x0 <= RENDER_TILE_SIZE && y1 - y0 <= RENDER_TILE_SIZE ?
+			 openat(cacheRef->directoryFd, name, O_RDONLY | O_CLOEXEC) : -1;
+	if (fd >= 0 && fstat(fd, &fileStat) == 0 && fileStat.st_size == (off_t) length) {
+		while (read < length) {
+			ssize_t result = pread(fd, buffer + read, length - read, (off_t) read);
+			if (result < 0 && errno == EINTR)
+				continue;
+			if (result <= 0)
+				break;
+			read += (size_t) result;
+		}
+	}
+	int isFound = read == length;
+	if (isFound) {
+		memcpy(header, buffer + 4, sizeof(header));
+		isFound = memcmp(buffer, TILE_CACHE_MAGIC, 4) == 0 && header[0] == TILE_CACHE_VERSION &&
+				  header[1] == (uint32_t) key && header[2] == (uint32_t) (key >> 32) &&
+				  header[3] == (uint32_t) (x1 - x0) && header[4] == (uint32_t) (y1 - y0);
+	}
+	if (!isFound) {
+		if (fd >= 0)
+			close(fd);
+		atomic_fetch_add(&cacheRef->misses, 1);
+		return 1;
+	}
+
+	// Reading a tile makes it the most recently used
+	futimens(fd, NULL);
+	close(fd);
+	for (int y = y0; y < y1; y++)
+		memcpy(&imageRef->pixmapRef[(size_t) y * imageRef->width + x0],
+			   buffer + TILE_CACHE_HEADER_SIZE + rowSize * (size_t) (y - y0), rowSize);
+	atomic_fetch_add(&cacheRef->hits, 1);
+	return 0;
+}
+
+/**
+ * Adds a rendered tile of an image to the cache, the tile is simply not cached if it can not be
+ * written
+ * @param cacheRef - The cache to write to
+ * @param renderKey - The key of the render, see tile_cache_render_key
+ * @param imageRef - The image holding the tile
+ * @param x0 - The left column of the tile
+ * @param y0 - The top row of the tile
+ * @param x1 - The column after the right of the tile
+ * @param y1 - The row after the bottom of the tile
+ */
+void tile_cache_store(TileCache *cacheRef, uint64_t renderKey, Image *imageRef, int x0, int y0, int x1, int y1) {
+	uint8_t buffer[TILE_CACHE_HEADER_SIZE + sizeof(RGBApixel) * RENDER_TILE_SIZE * RENDER_TILE_SIZE];
+	size_t rowSize = sizeof(RGBApixel) * (size_t) (x1 - x0);
+	size_t length = TILE_CACHE_HEADER_SIZE + rowSize * (size_t) (y1 - y0);
+	uint64_t key = tile_cache_tile_key(renderKey, x0, y0);
+	uint32_t header[5] = {TILE_CACHE_VERSION, (uint32_t) key, (uint32_t) (key >> 32), (uint32_t) (x1 - x0), (uint32_t) (y1 - y0)};
+	char name[32];
+	char temporaryName[64];
+	size_t written = 0;
+
+	if (x1 - x0 > RENDER_TILE_SIZE || y1 - y0 > RENDER_TILE_SIZE)
+		return;
+	memcpy(buffer, TILE_CACHE_MAGIC, 4);
+	memcpy(buffer + 4, header, sizeof(header));
+	for (int y = y0; y < y1; y++)
+		memcpy(buffer + TILE_CACHE_HEADER_SIZE + rowSize * (size_t) (y - y0),
+			   &imageRef->pixmapRef[(size_t) y * imageRef->width + x0], rowSize);
+
+	// Written under a name of its own and renamed into place, so a tile is either whole or absent
+	snprintf(name, sizeof(name), "%016llx%s", (unsigned long long) key, TILE_CACHE_SUFFIX);
+	snprintf(temporaryName, sizeof(temporaryName), "%016llx.%ld.%u.tmp", (unsigned long long) key, (long) getpid(),
+			 atomic_fetch_add(&cacheRef->temporaryId, 1));
+	int fd = openat(cacheRef->directoryFd, temporaryName, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+	while (written < length) {
+		ssize_t result = write(fd, buffer + written, length - written);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			break;
+		written += (size_t) result;
+	}
+	if (close(fd) != 0 || written < length ||
+		renameat(cacheRef->directoryFd, temporaryName, cacheRef->directoryFd, name) != 0) {
+		unlinkat(cacheRef->directoryFd, temporaryName, 0);
+		return;
+	}
+	atomic_fetch_add(&cacheRef->stores, 1);
+}
+
+/**
+ * Orders cache entries from the least to the most recently used
+ * @param a - The first TileCacheEntry
+ * @param b - The second TileCacheEntry
+ * @return The order of the entries
+ */
+static int tile_cache_entry_compare(const void *a, const void *b) {
+	const TileCacheEntry *entryA = a;
+	const TileCacheEntry *entryB = b;
+	return (entryA->usedNs > entryB->usedNs) - (entryA->usedNs < entryB->usedNs);
+}
+
+/**
+ * Removes the least recently used tiles until the directory holds no more than the cache's limit,
+ * along with temporary files left behind by renders that stopped part way
+ * @param cacheRef - The cache to evict from
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int tile_cache_evict(TileCache *cacheRef) {
+	TileCacheEntry *entries = NULL;
+	size_t entriesLength = 0, entriesCapacity = 0;
+	size_t totalBytes = 0;
+	struct dirent *direntRef;
+	struct stat fileStat;
+	time_t staleTime = time(NULL) - TILE_CACHE_STALE_SECONDS;
+
+	int fd = dup(cacheRef->directoryFd);
+	DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+	if (dir == NULL) {
+		fprintf(stderr, "Error: Tile cache directory '%s' could not be read\n", cacheRef->directory);
+		if (fd >= 0)
+			close(fd);
+		return 1;
+	}
+	rewinddir(dir);
+
+	while ((direntRef = readdir(dir)) != NULL) {
+		size_t nameLength = strlen(direntRef->d_name);
+		if (direntRef->d_name[0] == '.' || fstatat(cacheRef->directoryFd, direntRef->d_name, &fileStat, AT_SYMLINK_NOFOLLOW) != 0 ||
+			!S_ISREG(fileStat.st_mode))
+			continue;
+		if (nameLength > 4 && strcmp(direntRef->d_name + nameLength - 4, ".tmp") == 0) {
+			if (fileStat.st_mtime < staleTime)
+				unlinkat(cacheRef->directoryFd, direntRef->d_name, 0);
+			continue;
+		}
+		if (nameLength != TILE_CACHE_NAME_LENGTH || strcmp(direntRef->d_name + 16, TILE_CACHE_SUFFIX) != 0)
+			continue;
+
+		if (entriesLength == entriesCapacity) {
+			size_t capacity = entriesCapacity > 0 ? entriesCapacity * 2 : 1024;
+			TileCacheEntry *grown = realloc(entries, sizeof(TileCacheEntry) * capacity);
+			if (grown == NULL) {
+				fprintf(stderr, "Error: Could not allocate the tile cache entries\n");
+				free(entries);
+				closedir(dir);
+				return 1;
+			}
+			entries = grown;
+			entriesCapacity = capacity;
+		}
+		entries[entriesLength].usedNs = (int64_t) fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+		entries[entriesLength].size = fileStat.st_size;
+		memcpy(entries[entriesLength].name, direntRef->d_name, nameLength + 1);
+		totalBytes += (size_t) fileStat.st_size;
+		entriesLength++;
+	}
+	closedir(dir);
+
+	if (totalBytes > cacheRef->maxBytes) {
+		qsort(entries, entriesLength, sizeof(TileCacheEntry), tile_cache_entry_compare);
+		for (size_t i = 0; i < entriesLength && totalBytes > cacheRef->maxBytes; i++) {
+			if (unlinkat(cacheRef->directoryFd, entries[i].name, 0) == 0 || errno == ENOENT) {
+				totalBytes -= (size_t) entries[i].size;
+				cacheRef->evictions++;
+			}
+		}
+	}
+	free(entries);
+	return 0;
+}
+
+/**
+ * Closes a tile cache, evicting the least recently used tiles beyond its size. The directory may
+ * grow past the limit by the tiles of the renders made while it was open.
+ * @param cacheRef - The cache to close
+ * @return 0 if success, otherwise a failure occurred
+ */
+int tile_cache_close(TileCache *cacheRef) {
+	int result = tile_cache_evict(cacheRef);
+	close(cacheRef->directoryFd);
+	cacheRef->directoryFd = -1;
+	return result;
+}
@@ -0,0 +1,47 @@
+//
+// Created on 10/18/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_TILE_CACHE_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_TILE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "raycaster.h"
+
+#define TILE_CACHE_MAGIC "RCTC"
+#define TILE_CACHE_VERSION 1
+#define TILE_CACHE_SUFFIX ".tile"
+#define TILE_CACHE_DEFAULT_MEGABYTES 1024
+#define TILE_CACHE_STALE_SECONDS 3600
+
+/**
+ * TileCache - A directory of rendered tiles named by a 64 bit hash of everything that decides their
+ * pixels: the contents of the scene, the image size, the band of rows, the options that change
+ * shading and the tile's corner. A tile found in the cache is copied into the image instead of
+ * traced, so rendering an unchanged scene again only costs hashing it and reading its tiles. Each
+ * tile is written to a temporary file and renamed into place, readers never see half a tile and
+ * renders sharing the directory need no locking. A tile's modification time is refreshed whenever it
+ * is read, when the cache is closed the least recently used tiles are removed until the directory
+ * holds no more than maxBytes.
+ */
+typedef struct TileCache {
+	char *directory;
+	int directoryFd;
+	size_t maxBytes;
+	atomic_int hits;
+	atomic_int misses;
+	atomic_int stores;
+	atomic_uint temporaryId;
+	int evictions;
+} TileCache;
+
+int tile_cache_open(TileCache *cacheRef, char *directory, size_t maxBytes);
+uint64_t tile_cache_scene_hash(Scene *sceneRef);
+uint64_t tile_cache_render_key(Scene *sceneRef, RenderOptions *optionsRef, int imageWidth, int imageHeight);
+int tile_cache_load(TileCache *cacheRef, uint64_t renderKey, Image *imageRef, int x0, int y0, int x1, int y1);
+void tile_cache_store(TileCache *cacheRef, uint64_t renderKey, Image *imageRef, int x0, int y0, int x1, int y1);
+int tile_cache_close(TileCache *cacheRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_TILE_CACHE_H
@@ -0,0 +1,69 @@
+//
+// Created on 10/18/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/json.h"
+#include "../src/raycaster.h"
+#include "../src/raycaster_helpers.h"
+#include "../src/cost.h"
+
+#define TEST_IMAGE_SIZE 64
+
+/**
+ * Renders a scene of area lights with a ray budget and checks that no pixel traced more rays than
+ * the budget allows. A hit always traces one shadow ray to each light, every other shadow ray must
+ * fit in the budget. The scene must not be reflective, the cost buffer does not count reflections.
+ * @param sceneRef - The scene to render
+ * @param rayBudget - The ray budget to render with
+ * @param wavefront - Whether to shade a stage at a time
+ * @return 0 if every pixel kept to the budget, otherwise a failure occurred
+ */
+static int check_ray_budget(Scene *sceneRef, int rayBudget, int wavefront) {
+	RenderOptions options;
+	CostBuffer cost;
+	Image image;
+	int limit = rayBudget > 1 + sceneRef->lightsLength ? rayBudget : 1 + sceneRef->lightsLength;
+	uint32_t mostRays = 0;
+
+	render_options_init(&options);
+	options.rayBudget = rayBudget;
+	options.wavefront = wavefront;
+	options.threadsLength = 1;
+	options.costRef = &cost;
+	if (raycast(sceneRef, &image, &options, TEST_IMAGE_SIZE, TEST_IMAGE_SIZE) != 0)
+		return 1;
+
+	for (size_t i = 0; i < (size_t) TEST_IMAGE_SIZE * TEST_IMAGE_SIZE; i++) {
+		uint32_t rays = 1 + cost.countersRef[i * COST_CHANNELS + COST_SHADOW_RAYS];
+		if (rays > mostRays)
+			mostRays = rays;
+	}
+	free(image.pixmapRef);
+	cost_buffer_free(&cost);
+
+	printf("Ray budget %d%s: at most %u rays per pixel, limit %d\n", rayBudget, wavefront ? " (wavefront)" : "",
+		   mostRays, limit);
+	return mostRays > (uint32_t) limit;
+}
+
+int main(int argc, char *argv[]) {
+	int budgets[] = {1, 4, 8, 16, DEFAULT_RAY_BUDGET};
+	int result = 0;
+	Scene scene;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: raycast-test-ray-budget <area_light_scene>\n");
+		return 1;
+	}
+	if (create_scene_from_file(argv[1], &scene, 1) != 0)
+		return 1;
+
+	for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+		for (int wavefront = 0; wavefront <= 1; wavefront++)
+			result |= check_ray_budget(&scene, budgets[i], wavefront);
+	}
+	scene_free(&scene);
+	return result;
+}